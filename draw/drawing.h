@@ -1,8 +1,11 @@
 /* Copyright (C) 2025 Taichi Murakami. */
 #include <gtk/gtk.h>
 #define DRAWING_RESOURCE_PATH_CCH 64
+#define DRAWING_SHAPE_FLAG_USED   0x01
+#define DRAWING_SHAPE_ROOT        0
 #define DRAWING_TYPE_APPLICATION        (drawing_application_get_type        ())
 #define DRAWING_TYPE_APPLICATION_WINDOW (drawing_application_window_get_type ())
+#define DRAWING_TYPE_CANVAS             (drawing_canvas_get_type             ())
 #define DRAWING_TYPE_CIRCLE             (drawing_circle_get_type             ())
 #define DRAWING_TYPE_CLUSTER            (drawing_cluster_get_type            ())
 #define DRAWING_TYPE_DOCUMENT           (drawing_document_get_type           ())
@@ -11,8 +14,13 @@
 #define DRAWING_TYPE_SHAPE              (drawing_shape_get_type              ())
 
 typedef struct _DrawingClusterClass DrawingClusterClass;
+typedef struct _DrawingIndex        DrawingIndex;
+typedef struct _DrawingIndexArray   DrawingIndexArray;
+typedef struct _DrawingShapeArray   DrawingShapeArray;
 typedef struct _DrawingShapeClass   DrawingShapeClass;
+typedef struct _DrawingTiles        DrawingTiles;
 typedef enum   _DrawingShapeType    DrawingShapeType;
+typedef void (*DrawingIndexFunc) (DrawingShapeType type, guint index, gpointer data);
 
 enum _DrawingShapeType
 {
@@ -24,6 +32,34 @@ enum _DrawingShapeType
 	DRAWING_SHAPE_TYPE_LINE,
 	DRAWING_SHAPE_TYPE_PATH,
 	DRAWING_SHAPE_TYPE_RECTANGLE,
+	DRAWING_SHAPE_N_TYPES,
+};
+
+/* ファイルへ書き出す空間索引の節と葉の配列 */
+struct _DrawingIndexArray
+{
+	gconstpointer nodes;
+	const guint  *leaves [DRAWING_SHAPE_N_TYPES];
+	guint         n_leaves [DRAWING_SHAPE_N_TYPES];
+	gsize         node_size;
+	guint         length;
+	guint         root;
+	guint         free_node;
+};
+
+/* 図形の種類ごとに列を分けて連続して格納する図形の配列 */
+struct _DrawingShapeArray
+{
+	double  *x;
+	double  *y;
+	double  *width;
+	double  *height;
+	guint32 *colors;
+	guint32 *clusters;
+	guint32 *orders;
+	guint8  *flags;
+	guint    length;
+	guint    capacity;
 };
 
 struct _DrawingShapeClass
@@ -40,6 +76,7 @@ G_DECLARE_DERIVABLE_TYPE (DrawingShape,             drawing_shape,
 G_DECLARE_DERIVABLE_TYPE (DrawingCluster,           drawing_cluster,            DRAWING, CLUSTER,            DrawingShape);
 G_DECLARE_FINAL_TYPE     (DrawingApplication,       drawing_application,        DRAWING, APPLICATION,        GtkApplication);
 G_DECLARE_FINAL_TYPE     (DrawingApplicationWindow, drawing_application_window, DRAWING, APPLICATION_WINDOW, GtkApplicationWindow);
+G_DECLARE_FINAL_TYPE     (DrawingCanvas,            drawing_canvas,             DRAWING, CANVAS,             GtkWidget);
 G_DECLARE_FINAL_TYPE     (DrawingCircle,            drawing_circle,             DRAWING, CIRCLE,             DrawingShape);
 G_DECLARE_FINAL_TYPE     (DrawingDocument,          drawing_document,           DRAWING, DOCUMENT,           DrawingCluster);
 G_DECLARE_FINAL_TYPE     (DrawingEllipse,           drawing_ellipse,            DRAWING, ELLIPSE,            DrawingShape);
@@ -54,4 +91,80 @@ GSettings *drawing_get_settings      (void);
 GApplication *drawing_application_new (const char *application_id, GApplicationFlags flags);
 
 /* Drawing Application Window */
-GtkWidget *drawing_application_window_new (GApplication *application);
+DrawingDocument *drawing_application_window_get_document (DrawingApplicationWindow *self);
+GtkWidget       *drawing_application_window_new          (GApplication *application);
+void             drawing_application_window_set_file     (DrawingApplicationWindow *self, GFile *file);
+
+/* Drawing Canvas */
+GtkWidget *drawing_canvas_new          (void);
+void       drawing_canvas_set_document (DrawingCanvas *self, DrawingDocument *document);
+void       drawing_canvas_set_position (DrawingCanvas *self, double zoom, double x, double y);
+
+/* Drawing Circle */
+void drawing_circle_get_geometry (DrawingCircle *self, double *x, double *y, double *radius);
+void drawing_circle_set_geometry (DrawingCircle *self, double x, double y, double radius);
+
+/* Drawing Document */
+guint                    drawing_document_add_circle    (DrawingDocument *self, guint cluster, double x, double y, double radius, guint32 color);
+guint                    drawing_document_add_cluster   (DrawingDocument *self, guint cluster);
+guint                    drawing_document_add_ellipse   (DrawingDocument *self, guint cluster, double x, double y, double radius_x, double radius_y, guint32 color);
+guint                    drawing_document_add_rectangle (DrawingDocument *self, guint cluster, double x, double y, double width, double height, guint32 color);
+void                     drawing_document_forget        (DrawingDocument *self, DrawingShapeType type, guint index);
+const DrawingShapeArray *drawing_document_get_array     (DrawingDocument *self, DrawingShapeType type);
+gboolean                 drawing_document_get_bounds    (DrawingDocument *self, DrawingShapeType type, guint index, graphene_rect_t *bounds);
+DrawingIndex            *drawing_document_get_index     (DrawingDocument *self);
+guint32                  drawing_document_get_order     (DrawingDocument *self);
+DrawingShape            *drawing_document_get_shape     (DrawingDocument *self, DrawingShapeType type, guint index);
+void                     drawing_document_move          (DrawingDocument *self, DrawingShapeType type, guint index, double dx, double dy);
+DrawingDocument         *drawing_document_new           (void);
+DrawingDocument         *drawing_document_new_mapped    (GMappedFile *file, const DrawingShapeArray *arrays, const DrawingIndexArray *index, guint32 order);
+gboolean                 drawing_document_pick          (DrawingDocument *self, double x, double y, double tolerance, DrawingShapeType *type, guint *index);
+void                     drawing_document_query         (DrawingDocument *self, double x, double y, double width, double height, DrawingIndexFunc func, gpointer data);
+void                     drawing_document_remove        (DrawingDocument *self, DrawingShapeType type, guint index);
+void                     drawing_document_set_color     (DrawingDocument *self, DrawingShapeType type, guint index, guint32 color);
+void                     drawing_document_set_rectangle (DrawingDocument *self, DrawingShapeType type, guint index, double x, double y, double width, double height);
+
+/* Drawing Ellipse */
+void drawing_ellipse_get_geometry (DrawingEllipse *self, double *x, double *y, double *radius_x, double *radius_y);
+void drawing_ellipse_set_geometry (DrawingEllipse *self, double x, double y, double radius_x, double radius_y);
+
+/* Drawing File */
+DrawingDocument *drawing_file_load (GFile *file, GError **error);
+gboolean         drawing_file_save (DrawingDocument *document, GFile *file, GError **error);
+
+/* Drawing Index */
+void          drawing_index_free       (DrawingIndex *self);
+void          drawing_index_get_array  (DrawingIndex *self, DrawingIndexArray *array);
+void          drawing_index_insert     (DrawingIndex *self, DrawingShapeType type, guint index, double x, double y, double width, double height);
+DrawingIndex *drawing_index_new        (void);
+DrawingIndex *drawing_index_new_mapped (const DrawingIndexArray *array, const DrawingShapeArray *shapes);
+void          drawing_index_query      (DrawingIndex *self, double x, double y, double width, double height, DrawingIndexFunc func, gpointer data);
+void          drawing_index_remove     (DrawingIndex *self, DrawingShapeType type, guint index);
+
+/* Drawing Rectangle */
+void drawing_rectangle_get_geometry (DrawingRectangle *self, double *x, double *y, double *width, double *height);
+void drawing_rectangle_set_geometry (DrawingRectangle *self, double x, double y, double width, double height);
+
+/* Drawing Render */
+void drawing_render_area (DrawingDocument *document, cairo_t *cr, double x, double y, double width, double height);
+
+/* Drawing Shape */
+void             drawing_shape_attach         (DrawingShape *self, DrawingDocument *document, DrawingShapeType type, guint index);
+void             drawing_shape_detach         (DrawingShape *self);
+gboolean         drawing_shape_get_bounds     (DrawingShape *self, graphene_rect_t *bounds);
+guint32          drawing_shape_get_color      (DrawingShape *self);
+DrawingDocument *drawing_shape_get_document   (DrawingShape *self);
+guint            drawing_shape_get_index      (DrawingShape *self);
+gboolean         drawing_shape_get_rectangle  (DrawingShape *self, double *x, double *y, double *width, double *height);
+DrawingShapeType drawing_shape_get_shape_type (DrawingShape *self);
+void             drawing_shape_move           (DrawingShape *self, double dx, double dy);
+void             drawing_shape_remove         (DrawingShape *self);
+void             drawing_shape_set_color      (DrawingShape *self, guint32 color);
+void             drawing_shape_set_rectangle  (DrawingShape *self, double x, double y, double width, double height);
+
+/* Drawing Tiles */
+void          drawing_tiles_clear    (DrawingTiles *self);
+void          drawing_tiles_damage   (DrawingTiles *self, double x, double y, double width, double height);
+void          drawing_tiles_free     (DrawingTiles *self);
+DrawingTiles *drawing_tiles_new      (void);
+void          drawing_tiles_snapshot (DrawingTiles *self, DrawingDocument *document, GtkSnapshot *snapshot, double zoom, double x, double y, int width, int height, int scale);
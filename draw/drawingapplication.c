@@ -33,6 +33,7 @@ static const char *ACCELS_CLOSE        [] = { "<Ctrl>q", NULL };
 static const char *ACCELS_HELP_OVERLAY [] = { "<Ctrl>question", "<Ctrl>slash", NULL };
 static const char *ACCELS_NEW          [] = { "<Ctrl>n", NULL };
 static const char *ACCELS_OPEN         [] = { "<Ctrl>o", NULL };
+static const char *ACCELS_SAVE         [] = { "<Ctrl>s", NULL };
 
 /* メニュー アクセラレーター */
 static const DrawingApplicationAccelEntry
@@ -42,6 +43,7 @@ ACCEL_ENTRIES [] =
 	{ "win.show-help-overlay", ACCELS_HELP_OVERLAY },
 	{ "app.new",               ACCELS_NEW          },
 	{ "win.open",              ACCELS_OPEN         },
+	{ "win.save",              ACCELS_SAVE         },
 };
 
 /* メニュー アクション */
@@ -143,6 +145,7 @@ drawing_application_open (GApplication *self, GFile **files, gint n_files, const
 	for (n = 0; n < n_files; n++)
 	{
 		window = drawing_application_window_new (self);
+		drawing_application_window_set_file (DRAWING_APPLICATION_WINDOW (window), files [n]);
 		gtk_window_present (GTK_WINDOW (window));
 	}
 }
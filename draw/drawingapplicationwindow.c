@@ -1,21 +1,38 @@
 /* Copyright (C) 2025 Taichi Murakami. */
 #include <gtk/gtk.h>
+#include <glib/gi18n.h>
 #include "drawing.h"
+#define ACTION_ABOUT          "show-about"
+#define ACTION_OPEN           "open"
+#define ACTION_SAVE           "save"
+#define MESSAGE_OPEN          _("The file could not be opened.")
+#define MESSAGE_SAVE          _("The file could not be saved.")
 #define PROPERTY_APPLICATION  "application"
 #define PROPERTY_SHOW_MENUBAR "show-menubar"
 #define RESOURCE_ABOUT        "gtk/about.ui"
 #define RESOURCE_ABOUT_DIALOG "dialog"
 #define SIGNAL_DESTROY        "destroy"
+#define TITLE_OPEN            _("Open File")
+#define TITLE_SAVE            _("Save File")
 
 /* Drawing Application Window クラスのインスタンス */
 struct _DrawingApplicationWindow
 {
 	GtkApplicationWindow parent_instance;
+	DrawingDocument     *document;
+	GtkWidget           *canvas;
+	GFile               *file;
 };
 
 static void drawing_application_window_activate_about (GSimpleAction *action, GVariant *parameter, gpointer user_data);
+static void drawing_application_window_activate_open  (GSimpleAction *action, GVariant *parameter, gpointer user_data);
+static void drawing_application_window_activate_save  (GSimpleAction *action, GVariant *parameter, gpointer user_data);
+static void drawing_application_window_alert          (DrawingApplicationWindow *self, const char *message, const GError *error);
 static void drawing_application_window_class_init     (DrawingApplicationWindowClass *this_class);
+static void drawing_application_window_dispose        (GObject *self);
 static void drawing_application_window_init           (DrawingApplicationWindow *self);
+static void drawing_application_window_respond_open   (GObject *dialog, GAsyncResult *result, gpointer user_data);
+static void drawing_application_window_respond_save   (GObject *dialog, GAsyncResult *result, gpointer user_data);
 
 /* Drawing Application Window クラス */
 G_DEFINE_TYPE (DrawingApplicationWindow, drawing_application_window, GTK_TYPE_APPLICATION_WINDOW);
@@ -23,7 +40,9 @@ G_DEFINE_TYPE (DrawingApplicationWindow, drawing_application_window, GTK_TYPE_AP
 /* メニュー項目アクション */
 static const GActionEntry ACTION_ENTRIES [] =
 {
-	{ "show-about", drawing_application_window_activate_about, NULL, NULL, NULL },
+	{ ACTION_ABOUT, drawing_application_window_activate_about, NULL, NULL, NULL },
+	{ ACTION_OPEN,  drawing_application_window_activate_open,  NULL, NULL, NULL },
+	{ ACTION_SAVE,  drawing_application_window_activate_save,  NULL, NULL, NULL },
 };
 
 /*******************************************************************************
@@ -46,12 +65,90 @@ drawing_application_window_activate_about (GSimpleAction *action, GVariant *para
 	g_object_unref (builder);
 }
 
+/*******************************************************************************
+ファイルを開きます。
+*/
+static void
+drawing_application_window_activate_open (GSimpleAction *action, GVariant *parameter, gpointer user_data)
+{
+	GtkFileDialog *dialog;
+	dialog = gtk_file_dialog_new ();
+	gtk_file_dialog_set_modal    (dialog, TRUE);
+	gtk_file_dialog_set_title    (dialog, TITLE_OPEN);
+	gtk_file_dialog_open         (dialog, GTK_WINDOW (user_data), NULL, drawing_application_window_respond_open, user_data);
+	g_object_unref               (dialog);
+}
+
+/*******************************************************************************
+文書をファイルに保存します。まだファイルを開いていない場合は保存先を選択します。
+*/
+static void
+drawing_application_window_activate_save (GSimpleAction *action, GVariant *parameter, gpointer user_data)
+{
+	DrawingApplicationWindow *self;
+	GtkFileDialog *dialog;
+	GError *error;
+	self = DRAWING_APPLICATION_WINDOW (user_data);
+	error = NULL;
+
+	if (!self->file)
+	{
+		dialog = gtk_file_dialog_new ();
+		gtk_file_dialog_set_modal    (dialog, TRUE);
+		gtk_file_dialog_set_title    (dialog, TITLE_SAVE);
+		gtk_file_dialog_save         (dialog, GTK_WINDOW (self), NULL, drawing_application_window_respond_save, self);
+		g_object_unref               (dialog);
+	}
+	else if (!drawing_file_save (self->document, self->file, &error))
+	{
+		drawing_application_window_alert (self, MESSAGE_SAVE, error);
+		g_error_free (error);
+	}
+}
+
+/*******************************************************************************
+ファイルを開けなかったことや保存できなかったことを、理由とともにダイアログで知らせます。
+*/
+static void
+drawing_application_window_alert (DrawingApplicationWindow *self, const char *message, const GError *error)
+{
+	GtkAlertDialog *dialog;
+	dialog = gtk_alert_dialog_new ("%s", message);
+	gtk_alert_dialog_set_detail (dialog, error->message);
+	gtk_alert_dialog_set_modal  (dialog, TRUE);
+	gtk_alert_dialog_show       (dialog, GTK_WINDOW (self));
+	g_object_unref              (dialog);
+}
+
 /*******************************************************************************
 クラスを初期化します。
 */
 static void
 drawing_application_window_class_init (DrawingApplicationWindowClass *this_class)
 {
+	G_OBJECT_CLASS (this_class)->dispose = drawing_application_window_dispose;
+}
+
+/*******************************************************************************
+クラスのインスタンスを破棄します。
+*/
+static void
+drawing_application_window_dispose (GObject *self)
+{
+	DrawingApplicationWindow *properties;
+	properties = DRAWING_APPLICATION_WINDOW (self);
+	g_clear_object (&properties->document);
+	g_clear_object (&properties->file);
+	G_OBJECT_CLASS (drawing_application_window_parent_class)->dispose (self);
+}
+
+/*******************************************************************************
+ウィンドウが表示している文書を取得します。
+*/
+DrawingDocument *
+drawing_application_window_get_document (DrawingApplicationWindow *self)
+{
+	return self->document;
 }
 
 /*******************************************************************************
@@ -60,6 +157,10 @@ drawing_application_window_class_init (DrawingApplicationWindowClass *this_class
 static void
 drawing_application_window_init (DrawingApplicationWindow *self)
 {
+	self->document = drawing_document_new ();
+	self->canvas = drawing_canvas_new ();
+	drawing_canvas_set_document (DRAWING_CANVAS (self->canvas), self->document);
+	gtk_window_set_child (GTK_WINDOW (self), self->canvas);
 	g_action_map_add_action_entries (G_ACTION_MAP (self), ACTION_ENTRIES, G_N_ELEMENTS (ACTION_ENTRIES), self);
 }
 
@@ -74,3 +175,73 @@ drawing_application_window_new (GApplication *application)
 		PROPERTY_SHOW_MENUBAR, TRUE,
 		NULL);
 }
+
+/*******************************************************************************
+ファイルを開きます。
+*/
+static void
+drawing_application_window_respond_open (GObject *dialog, GAsyncResult *result, gpointer user_data)
+{
+	GFile *file;
+	file = gtk_file_dialog_open_finish (GTK_FILE_DIALOG (dialog), result, NULL);
+
+	if (file)
+	{
+		drawing_application_window_set_file (DRAWING_APPLICATION_WINDOW (user_data), file);
+		g_object_unref (file);
+	}
+}
+
+/*******************************************************************************
+選択した保存先に文書を保存し、以後はそのファイルに保存します。
+*/
+static void
+drawing_application_window_respond_save (GObject *dialog, GAsyncResult *result, gpointer user_data)
+{
+	DrawingApplicationWindow *self;
+	GFile *file;
+	GError *error;
+	self = DRAWING_APPLICATION_WINDOW (user_data);
+	file = gtk_file_dialog_save_finish (GTK_FILE_DIALOG (dialog), result, NULL);
+	error = NULL;
+
+	if (file)
+	{
+		if (drawing_file_save (self->document, file, &error))
+		{
+			g_set_object (&self->file, file);
+		}
+		else
+		{
+			drawing_application_window_alert (self, MESSAGE_SAVE, error);
+			g_error_free (error);
+		}
+
+		g_object_unref (file);
+	}
+}
+
+/*******************************************************************************
+ファイルから文書を読み込んで表示します。読み込めない場合は理由を知らせ、今の文書を表示したままにします。
+*/
+void
+drawing_application_window_set_file (DrawingApplicationWindow *self, GFile *file)
+{
+	DrawingDocument *document;
+	GError *error;
+	error = NULL;
+	document = drawing_file_load (file, &error);
+
+	if (document)
+	{
+		g_set_object (&self->file, file);
+		g_object_unref (self->document);
+		self->document = document;
+		drawing_canvas_set_document (DRAWING_CANVAS (self->canvas), document);
+	}
+	else
+	{
+		drawing_application_window_alert (self, MESSAGE_OPEN, error);
+		g_error_free (error);
+	}
+}
@@ -0,0 +1,218 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include "drawing.h"
+#define CANVAS_TOLERANCE   4.0
+#define SIGNAL_DAMAGE      "damage"
+#define SIGNAL_DRAG_BEGIN  "drag-begin"
+#define SIGNAL_DRAG_END    "drag-end"
+#define SIGNAL_DRAG_UPDATE "drag-update"
+
+/* Drawing Canvas クラスのインスタンス */
+struct _DrawingCanvas
+{
+	GtkWidget        parent_instance;
+	DrawingDocument *document;
+	DrawingTiles    *tiles;
+	GdkRGBA          background;
+	DrawingShapeType drag_type;
+	guint            drag_index;
+	gboolean         dragging_shape;
+	double           drag_x;
+	double           drag_y;
+	double           zoom;
+	double           x;
+	double           y;
+};
+
+static void drawing_canvas_begin_drag (GtkGestureDrag *gesture, gdouble x, gdouble y, gpointer user_data);
+static void drawing_canvas_class_init (DrawingCanvasClass *this_class);
+static void drawing_canvas_damage     (DrawingDocument *document, double x, double y, double width, double height, gpointer user_data);
+static void drawing_canvas_dispose    (GObject *self);
+static void drawing_canvas_drag       (GtkGestureDrag *gesture, gdouble x, gdouble y, gpointer user_data);
+static void drawing_canvas_end_drag   (GtkGestureDrag *gesture, gdouble x, gdouble y, gpointer user_data);
+static void drawing_canvas_init       (DrawingCanvas *self);
+static void drawing_canvas_snapshot   (GtkWidget *self, GtkSnapshot *snapshot);
+
+/* Drawing Canvas クラス */
+G_DEFINE_TYPE (DrawingCanvas, drawing_canvas, GTK_TYPE_WIDGET);
+
+/*******************************************************************************
+ドラッグを開始します。押した位置に図形がある場合はその図形を、ない場合は表示位置を動かします。
+*/
+static void
+drawing_canvas_begin_drag (GtkGestureDrag *gesture, gdouble x, gdouble y, gpointer user_data)
+{
+	DrawingCanvas *self;
+	self = DRAWING_CANVAS (user_data);
+	self->drag_x = 0;
+	self->drag_y = 0;
+	self->dragging_shape = self->document && drawing_document_pick (self->document, self->x + x / self->zoom, self->y + y / self->zoom, CANVAS_TOLERANCE / self->zoom, &self->drag_type, &self->drag_index);
+}
+
+/*******************************************************************************
+クラスを初期化します。
+*/
+static void
+drawing_canvas_class_init (DrawingCanvasClass *this_class)
+{
+	G_OBJECT_CLASS (this_class)->dispose = drawing_canvas_dispose;
+	GTK_WIDGET_CLASS (this_class)->snapshot = drawing_canvas_snapshot;
+}
+
+/*******************************************************************************
+文書の変更された範囲に重なる区画を、次に表示するときに描き直すようにします。
+*/
+static void
+drawing_canvas_damage (DrawingDocument *document, double x, double y, double width, double height, gpointer user_data)
+{
+	DrawingCanvas *self;
+	self = DRAWING_CANVAS (user_data);
+	drawing_tiles_damage (self->tiles, x, y, width, height);
+	gtk_widget_queue_draw (GTK_WIDGET (self));
+}
+
+/*******************************************************************************
+クラスのインスタンスを破棄します。
+*/
+static void
+drawing_canvas_dispose (GObject *self)
+{
+	DrawingCanvas *properties;
+	properties = DRAWING_CANVAS (self);
+
+	if (properties->document)
+	{
+		g_signal_handlers_disconnect_by_func (properties->document, drawing_canvas_damage, properties);
+		g_clear_object (&properties->document);
+	}
+
+	g_clear_pointer (&properties->tiles, drawing_tiles_free);
+	G_OBJECT_CLASS (drawing_canvas_parent_class)->dispose (self);
+}
+
+/*******************************************************************************
+図形か表示位置を、前回からドラッグした分だけ動かします。
+*/
+static void
+drawing_canvas_drag (GtkGestureDrag *gesture, gdouble x, gdouble y, gpointer user_data)
+{
+	DrawingCanvas *self;
+	double dx, dy;
+	self = DRAWING_CANVAS (user_data);
+	dx = (x - self->drag_x) / self->zoom;
+	dy = (y - self->drag_y) / self->zoom;
+	self->drag_x = x;
+	self->drag_y = y;
+
+	if (self->dragging_shape)
+	{
+		drawing_document_move (self->document, self->drag_type, self->drag_index, dx, dy);
+	}
+	else
+	{
+		drawing_canvas_set_position (self, self->zoom, self->x - dx, self->y - dy);
+	}
+}
+
+/*******************************************************************************
+ドラッグを終了します。
+*/
+static void
+drawing_canvas_end_drag (GtkGestureDrag *gesture, gdouble x, gdouble y, gpointer user_data)
+{
+	DrawingCanvas *self;
+	self = DRAWING_CANVAS (user_data);
+	self->dragging_shape = FALSE;
+}
+
+/*******************************************************************************
+クラスのインスタンスを初期化します。
+*/
+static void
+drawing_canvas_init (DrawingCanvas *self)
+{
+	GtkGesture *gesture;
+	self->zoom = 1.0;
+	self->background.red = 1.0F;
+	self->background.green = 1.0F;
+	self->background.blue = 1.0F;
+	self->background.alpha = 1.0F;
+	self->tiles = drawing_tiles_new ();
+	gesture = gtk_gesture_drag_new ();
+	g_signal_connect (gesture, SIGNAL_DRAG_BEGIN,  G_CALLBACK (drawing_canvas_begin_drag), self);
+	g_signal_connect (gesture, SIGNAL_DRAG_END,    G_CALLBACK (drawing_canvas_end_drag),   self);
+	g_signal_connect (gesture, SIGNAL_DRAG_UPDATE, G_CALLBACK (drawing_canvas_drag),       self);
+	gtk_widget_add_controller (GTK_WIDGET (self), GTK_EVENT_CONTROLLER (gesture));
+}
+
+/*******************************************************************************
+クラスのインスタンスを作成します。
+*/
+GtkWidget *
+drawing_canvas_new (void)
+{
+	return g_object_new (DRAWING_TYPE_CANVAS, NULL);
+}
+
+/*******************************************************************************
+表示する文書を設定します。文書の damage シグナルを受け取り、変更された範囲の区画だけを描き直します。
+*/
+void
+drawing_canvas_set_document (DrawingCanvas *self, DrawingDocument *document)
+{
+	if (self->document != document)
+	{
+		if (self->document)
+		{
+			g_signal_handlers_disconnect_by_func (self->document, drawing_canvas_damage, self);
+			g_clear_object (&self->document);
+		}
+		if (document)
+		{
+			self->document = g_object_ref (document);
+			g_signal_connect (document, SIGNAL_DAMAGE, G_CALLBACK (drawing_canvas_damage), self);
+		}
+
+		self->dragging_shape = FALSE;
+		drawing_tiles_clear (self->tiles);
+		gtk_widget_queue_draw (GTK_WIDGET (self));
+	}
+}
+
+/*******************************************************************************
+拡大率と表示位置を設定します。(x, y) は表示領域の左上に表示する文書の座標です。
+拡大率が同じ間は、描画済みの区画をずらして表示するだけです。
+*/
+void
+drawing_canvas_set_position (DrawingCanvas *self, double zoom, double x, double y)
+{
+	if ((self->zoom != zoom) || (self->x != x) || (self->y != y))
+	{
+		self->zoom = zoom;
+		self->x = x;
+		self->y = y;
+		gtk_widget_queue_draw (GTK_WIDGET (self));
+	}
+}
+
+/*******************************************************************************
+文書を区画ごとに並列に描画して表示します。文書がない場合は背景だけを描画します。
+*/
+static void
+drawing_canvas_snapshot (GtkWidget *self, GtkSnapshot *snapshot)
+{
+	DrawingCanvas *properties;
+	int width, height;
+	properties = DRAWING_CANVAS (self);
+	width = gtk_widget_get_width (self);
+	height = gtk_widget_get_height (self);
+
+	if (properties->document && (width > 0) && (height > 0))
+	{
+		drawing_tiles_snapshot (properties->tiles, properties->document, snapshot, properties->zoom, properties->x, properties->y, width, height, gtk_widget_get_scale_factor (self));
+	}
+	else
+	{
+		gtk_snapshot_append_color (snapshot, &properties->background, &GRAPHENE_RECT_INIT (0, 0, width, height));
+	}
+}
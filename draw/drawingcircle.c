@@ -0,0 +1,53 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include "drawing.h"
+
+/* Drawing Circle クラスのインスタンス */
+struct _DrawingCircle
+{
+	DrawingShape parent_instance;
+};
+
+static void drawing_circle_class_init (DrawingCircleClass *this_class);
+static void drawing_circle_init       (DrawingCircle *self);
+
+/* Drawing Circle クラス */
+G_DEFINE_TYPE (DrawingCircle, drawing_circle, DRAWING_TYPE_SHAPE);
+
+/*******************************************************************************
+クラスを初期化します。
+*/
+static void
+drawing_circle_class_init (DrawingCircleClass *this_class)
+{
+}
+
+/*******************************************************************************
+円の中心と半径を取得します。
+*/
+void
+drawing_circle_get_geometry (DrawingCircle *self, double *x, double *y, double *radius)
+{
+	double left, top, width, height;
+	drawing_shape_get_rectangle (DRAWING_SHAPE (self), &left, &top, &width, &height);
+	*radius = width / 2;
+	*x = left + *radius;
+	*y = top + *radius;
+}
+
+/*******************************************************************************
+クラスのインスタンスを初期化します。
+*/
+static void
+drawing_circle_init (DrawingCircle *self)
+{
+}
+
+/*******************************************************************************
+円の中心と半径を設定します。
+*/
+void
+drawing_circle_set_geometry (DrawingCircle *self, double x, double y, double radius)
+{
+	drawing_shape_set_rectangle (DRAWING_SHAPE (self), x - radius, y - radius, radius * 2, radius * 2);
+}
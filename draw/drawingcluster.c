@@ -0,0 +1,25 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include "drawing.h"
+
+static void drawing_cluster_class_init (DrawingClusterClass *this_class);
+static void drawing_cluster_init       (DrawingCluster *self);
+
+/* Drawing Cluster クラス */
+G_DEFINE_TYPE (DrawingCluster, drawing_cluster, DRAWING_TYPE_SHAPE);
+
+/*******************************************************************************
+クラスを初期化します。
+*/
+static void
+drawing_cluster_class_init (DrawingClusterClass *this_class)
+{
+}
+
+/*******************************************************************************
+クラスのインスタンスを初期化します。
+*/
+static void
+drawing_cluster_init (DrawingCluster *self)
+{
+}
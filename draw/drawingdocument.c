@@ -0,0 +1,928 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include "drawing.h"
+#define DOCUMENT_CAPACITY   256
+#define DOCUMENT_CHECKED    2
+#define DOCUMENT_INDEX(L)   ((L) >> 3)
+#define DOCUMENT_KEY(T, I)  GUINT_TO_POINTER (((I) << 3) | (T))
+#define DOCUMENT_LINK(T, I) ((guint32) (((I) << 3) | (T)))
+#define DOCUMENT_NONE       G_MAXUINT32
+#define DOCUMENT_STORAGE(T) (((T) == DRAWING_SHAPE_TYPE_DOCUMENT) ? DRAWING_SHAPE_TYPE_CLUSTER : (T))
+#define DOCUMENT_TYPE(L)    ((DrawingShapeType) ((L) & 7))
+#define DOCUMENT_VISITING   1
+#define SIGNAL_DAMAGE       "damage"
+
+typedef void (*DrawingDocumentMemberFunc) (DrawingDocument *self, DrawingShapeType type, guint index, gpointer data);
+typedef struct _DrawingDocumentLinks DrawingDocumentLinks;
+typedef struct _DrawingDocumentMove  DrawingDocumentMove;
+typedef struct _DrawingDocumentPick  DrawingDocumentPick;
+
+/* 同じ集団に属する図形をつなぐ列。要素は DOCUMENT_LINK で種類と番号をまとめた値で、末尾は DOCUMENT_NONE です。 */
+struct _DrawingDocumentLinks
+{
+	guint32 *next;
+	guint32 *previous;
+};
+
+/* 集団を移動する距離 */
+struct _DrawingDocumentMove
+{
+	double dx;
+	double dy;
+};
+
+/* 指定した点にある図形の検索 */
+struct _DrawingDocumentPick
+{
+	DrawingDocument *document;
+	DrawingShapeType type;
+	guint            index;
+	guint32          order;
+	gboolean         found;
+	double           x;
+	double           y;
+	double           tolerance;
+};
+
+/* Drawing Document クラスのインスタンス */
+struct _DrawingDocument
+{
+	DrawingCluster    parent_instance;
+	DrawingShapeArray    arrays [DRAWING_SHAPE_N_TYPES];
+	DrawingDocumentLinks links [DRAWING_SHAPE_N_TYPES];
+	GArray              *free_lists [DRAWING_SHAPE_N_TYPES];
+	GHashTable          *handles;
+	DrawingIndex        *index;
+	GMappedFile         *mapped;
+	guint32             *members;
+	gboolean             borrowed [DRAWING_SHAPE_N_TYPES];
+	guint32              order;
+};
+
+static guint    drawing_document_add            (DrawingDocument *self, DrawingShapeType type, guint cluster, double x, double y, double width, double height, guint32 color);
+static gboolean drawing_document_check          (const DrawingShapeArray *arrays);
+static void     drawing_document_class_init     (DrawingDocumentClass *this_class);
+static gboolean drawing_document_contains       (DrawingDocument *self, DrawingShapeType type, guint index);
+static void     drawing_document_damage         (DrawingDocument *self, DrawingShapeType type, guint index);
+static void     drawing_document_finalize       (GObject *self);
+static void     drawing_document_foreach_member (DrawingDocument *self, guint cluster, DrawingDocumentMemberFunc func, gpointer data);
+static void     drawing_document_free_array     (DrawingShapeArray *array);
+static GType    drawing_document_get_gtype      (DrawingShapeType type);
+static void     drawing_document_grow           (DrawingDocument *self, DrawingShapeType type);
+static void     drawing_document_init           (DrawingDocument *self);
+static void     drawing_document_link           (DrawingDocument *self, DrawingShapeType type, guint index);
+static void     drawing_document_link_all       (DrawingDocument *self);
+static void     drawing_document_move_member    (DrawingDocument *self, DrawingShapeType type, guint index, gpointer data);
+static void     drawing_document_pick_member    (DrawingShapeType type, guint index, gpointer data);
+static void     drawing_document_release        (DrawingDocument *self, DrawingShapeType type, guint index);
+static void     drawing_document_remove_member  (DrawingDocument *self, DrawingShapeType type, guint index, gpointer data);
+static void     drawing_document_set_member     (DrawingDocument *self, DrawingShapeType type, guint index, gpointer data);
+static void     drawing_document_union_member   (DrawingDocument *self, DrawingShapeType type, guint index, gpointer data);
+static void     drawing_document_unlink         (DrawingDocument *self, DrawingShapeType type, guint index);
+
+/* Drawing Document クラス */
+G_DEFINE_TYPE (DrawingDocument, drawing_document, DRAWING_TYPE_CLUSTER);
+
+/*******************************************************************************
+図形を配列の空いている要素へ追加し、その番号を返します。
+削除した要素の番号を再利用するので、他の図形の番号は変わりません。追加した図形は属する集団の一覧の先頭につなぎます。
+*/
+static guint
+drawing_document_add (DrawingDocument *self, DrawingShapeType type, guint cluster, double x, double y, double width, double height, guint32 color)
+{
+	DrawingShapeArray *array;
+	GArray *free_list;
+	guint index;
+	array = &self->arrays [type];
+	free_list = self->free_lists [type];
+
+	if (free_list->len)
+	{
+		index = g_array_index (free_list, guint, free_list->len - 1);
+		g_array_set_size (free_list, free_list->len - 1);
+	}
+	else
+	{
+		if (array->length == array->capacity)
+		{
+			drawing_document_grow (self, type);
+		}
+
+		index = array->length++;
+	}
+
+	array->x [index] = x;
+	array->y [index] = y;
+	array->width [index] = width;
+	array->height [index] = height;
+	array->colors [index] = color;
+	array->clusters [index] = cluster;
+	array->orders [index] = self->order++;
+	array->flags [index] = DRAWING_SHAPE_FLAG_USED;
+
+	if (type == DRAWING_SHAPE_TYPE_CLUSTER)
+	{
+		self->members [index] = DOCUMENT_NONE;
+	}
+
+	drawing_document_link (self, type, index);
+
+	if (type != DRAWING_SHAPE_TYPE_CLUSTER)
+	{
+		drawing_index_insert (self->index, type, index, x, y, width, height);
+		drawing_document_damage (self, type, index);
+	}
+
+	return index;
+}
+
+/*******************************************************************************
+中心と半径を指定して円を追加し、その番号を返します。
+*/
+guint
+drawing_document_add_circle (DrawingDocument *self, guint cluster, double x, double y, double radius, guint32 color)
+{
+	guint index;
+
+	if (drawing_document_contains (self, DRAWING_SHAPE_TYPE_CLUSTER, cluster))
+	{
+		index = drawing_document_add (self, DRAWING_SHAPE_TYPE_CIRCLE, cluster, x - radius, y - radius, radius * 2, radius * 2, color);
+	}
+	else
+	{
+		index = G_MAXUINT;
+	}
+
+	return index;
+}
+
+/*******************************************************************************
+集団の中に新しい集団を追加し、その番号を返します。
+*/
+guint
+drawing_document_add_cluster (DrawingDocument *self, guint cluster)
+{
+	guint index;
+
+	if (drawing_document_contains (self, DRAWING_SHAPE_TYPE_CLUSTER, cluster))
+	{
+		index = drawing_document_add (self, DRAWING_SHAPE_TYPE_CLUSTER, cluster, 0, 0, 0, 0, 0);
+	}
+	else
+	{
+		index = G_MAXUINT;
+	}
+
+	return index;
+}
+
+/*******************************************************************************
+中心と半径を指定して楕円を追加し、その番号を返します。
+*/
+guint
+drawing_document_add_ellipse (DrawingDocument *self, guint cluster, double x, double y, double radius_x, double radius_y, guint32 color)
+{
+	guint index;
+
+	if (drawing_document_contains (self, DRAWING_SHAPE_TYPE_CLUSTER, cluster))
+	{
+		index = drawing_document_add (self, DRAWING_SHAPE_TYPE_ELLIPSE, cluster, x - radius_x, y - radius_y, radius_x * 2, radius_y * 2, color);
+	}
+	else
+	{
+		index = G_MAXUINT;
+	}
+
+	return index;
+}
+
+/*******************************************************************************
+左上の座標と大きさを指定して長方形を追加し、その番号を返します。
+*/
+guint
+drawing_document_add_rectangle (DrawingDocument *self, guint cluster, double x, double y, double width, double height, guint32 color)
+{
+	guint index;
+
+	if (drawing_document_contains (self, DRAWING_SHAPE_TYPE_CLUSTER, cluster))
+	{
+		index = drawing_document_add (self, DRAWING_SHAPE_TYPE_RECTANGLE, cluster, x, y, width, height, color);
+	}
+	else
+	{
+		index = G_MAXUINT;
+	}
+
+	return index;
+}
+
+/*******************************************************************************
+ファイルから読み込んだ配列が文書として正しいかを確かめます。最上位の集団があってその親が自身であり、
+使用中の図形が全て使用中の集団に属し、集団の親をたどると必ず最上位の集団に着くことを確かめます。
+*/
+static gboolean
+drawing_document_check (const DrawingShapeArray *arrays)
+{
+	const DrawingShapeArray *array, *clusters;
+	guint8 *states;
+	guint index, cluster;
+	int type;
+	gboolean result;
+	clusters = &arrays [DRAWING_SHAPE_TYPE_CLUSTER];
+	result = clusters->length && (clusters->flags [DRAWING_SHAPE_ROOT] & DRAWING_SHAPE_FLAG_USED) && (clusters->clusters [DRAWING_SHAPE_ROOT] == DRAWING_SHAPE_ROOT);
+
+	for (type = 0; result && (type < DRAWING_SHAPE_N_TYPES); type++)
+	{
+		array = &arrays [type];
+
+		for (index = 0; result && (index < array->length); index++)
+		{
+			cluster = array->clusters [index];
+			result = !(array->flags [index] & DRAWING_SHAPE_FLAG_USED) || ((cluster < clusters->length) && (clusters->flags [cluster] & DRAWING_SHAPE_FLAG_USED));
+		}
+	}
+	if (result)
+	{
+		states = g_new0 (guint8, clusters->length);
+		states [DRAWING_SHAPE_ROOT] = DOCUMENT_CHECKED;
+
+		for (index = 0; result && (index < clusters->length); index++)
+		{
+			if (clusters->flags [index] & DRAWING_SHAPE_FLAG_USED)
+			{
+				for (cluster = index; !states [cluster]; cluster = clusters->clusters [cluster])
+				{
+					states [cluster] = DOCUMENT_VISITING;
+				}
+
+				result = states [cluster] == DOCUMENT_CHECKED;
+
+				for (cluster = index; states [cluster] == DOCUMENT_VISITING; cluster = clusters->clusters [cluster])
+				{
+					states [cluster] = DOCUMENT_CHECKED;
+				}
+			}
+		}
+
+		g_free (states);
+	}
+
+	return result;
+}
+
+/*******************************************************************************
+クラスを初期化します。
+図形を追加、変更、削除したときは、描き直す必要がある文書の範囲を damage シグナルで通知します。
+移動と大きさの変更では、変更前と変更後の範囲をそれぞれ通知します。
+*/
+static void
+drawing_document_class_init (DrawingDocumentClass *this_class)
+{
+	G_OBJECT_CLASS (this_class)->finalize = drawing_document_finalize;
+	g_signal_new (SIGNAL_DAMAGE, G_TYPE_FROM_CLASS (this_class), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 4, G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_DOUBLE, G_TYPE_DOUBLE);
+}
+
+/*******************************************************************************
+指定した番号の図形が存在するかどうかを判断します。
+*/
+static gboolean
+drawing_document_contains (DrawingDocument *self, DrawingShapeType type, guint index)
+{
+	DrawingShapeArray *array;
+	array = &self->arrays [type];
+	return (index < array->length) && (array->flags [index] & DRAWING_SHAPE_FLAG_USED);
+}
+
+/*******************************************************************************
+図形を囲む長方形を damage シグナルで通知します。
+*/
+static void
+drawing_document_damage (DrawingDocument *self, DrawingShapeType type, guint index)
+{
+	DrawingShapeArray *array;
+	array = &self->arrays [type];
+	g_signal_emit_by_name (self, SIGNAL_DAMAGE, array->x [index], array->y [index], array->width [index], array->height [index]);
+}
+
+/*******************************************************************************
+クラスのインスタンスを破棄します。
+図形の操作オブジェクトは文書を参照しているので、この時点で残っているものはありません。
+*/
+static void
+drawing_document_finalize (GObject *self)
+{
+	DrawingDocument *properties;
+	int type;
+	properties = DRAWING_DOCUMENT (self);
+
+	for (type = 0; type < DRAWING_SHAPE_N_TYPES; type++)
+	{
+		if (!properties->borrowed [type])
+		{
+			drawing_document_free_array (&properties->arrays [type]);
+		}
+
+		g_free (properties->links [type].next);
+		g_free (properties->links [type].previous);
+		g_array_unref (properties->free_lists [type]);
+	}
+
+	g_free (properties->members);
+
+	g_hash_table_unref (properties->handles);
+	drawing_index_free (properties->index);
+	g_clear_pointer (&properties->mapped, g_mapped_file_unref);
+	G_OBJECT_CLASS (drawing_document_parent_class)->finalize (self);
+}
+
+/*******************************************************************************
+集団に直接属する全ての図形に対して関数を呼び出します。
+集団ごとの一覧をたどるので、文書全体の図形の数ではなく集団に属する図形の数だけ時間がかかります。
+関数は呼び出された図形を削除してもかまいません。
+*/
+static void
+drawing_document_foreach_member (DrawingDocument *self, guint cluster, DrawingDocumentMemberFunc func, gpointer data)
+{
+	DrawingShapeType type;
+	guint32 link, next;
+	guint index;
+
+	for (link = self->members [cluster]; link != DOCUMENT_NONE; link = next)
+	{
+		type = DOCUMENT_TYPE (link);
+		index = DOCUMENT_INDEX (link);
+		next = self->links [type].next [index];
+		func (self, type, index, data);
+	}
+}
+
+/*******************************************************************************
+図形の操作オブジェクトを一覧から削除します。操作オブジェクトを破棄するときに呼び出します。
+*/
+void
+drawing_document_forget (DrawingDocument *self, DrawingShapeType type, guint index)
+{
+	g_hash_table_remove (self->handles, DOCUMENT_KEY (type, index));
+}
+
+/*******************************************************************************
+配列の列を全て破棄します。
+*/
+static void
+drawing_document_free_array (DrawingShapeArray *array)
+{
+	g_free (array->x);
+	g_free (array->y);
+	g_free (array->width);
+	g_free (array->height);
+	g_free (array->colors);
+	g_free (array->clusters);
+	g_free (array->orders);
+	g_free (array->flags);
+}
+
+/*******************************************************************************
+図形の種類の配列を取得します。削除した要素は flags に DRAWING_SHAPE_FLAG_USED を持ちません。
+*/
+const DrawingShapeArray *
+drawing_document_get_array (DrawingDocument *self, DrawingShapeType type)
+{
+	return &self->arrays [DOCUMENT_STORAGE (type)];
+}
+
+/*******************************************************************************
+図形を囲む長方形を取得します。集団の場合は属する全ての図形を囲む長方形です。
+空の集団や存在しない図形の場合は FALSE を返します。
+*/
+gboolean
+drawing_document_get_bounds (DrawingDocument *self, DrawingShapeType type, guint index, graphene_rect_t *bounds)
+{
+	DrawingShapeArray *array;
+	gboolean result;
+	type = DOCUMENT_STORAGE (type);
+	result = drawing_document_contains (self, type, index);
+
+	if (result && (type == DRAWING_SHAPE_TYPE_CLUSTER))
+	{
+		*bounds = GRAPHENE_RECT_INIT (0, 0, -1, -1);
+		drawing_document_foreach_member (self, index, drawing_document_union_member, bounds);
+		result = bounds->size.width >= 0;
+	}
+	else if (result)
+	{
+		array = &self->arrays [type];
+		*bounds = GRAPHENE_RECT_INIT (array->x [index], array->y [index], array->width [index], array->height [index]);
+	}
+
+	return result;
+}
+
+/*******************************************************************************
+図形の種類に対応する操作オブジェクトの型を取得します。
+*/
+static GType
+drawing_document_get_gtype (DrawingShapeType type)
+{
+	GType result;
+
+	switch (type)
+	{
+	case DRAWING_SHAPE_TYPE_CIRCLE:
+		result = DRAWING_TYPE_CIRCLE;
+		break;
+	case DRAWING_SHAPE_TYPE_CLUSTER:
+		result = DRAWING_TYPE_CLUSTER;
+		break;
+	case DRAWING_SHAPE_TYPE_ELLIPSE:
+		result = DRAWING_TYPE_ELLIPSE;
+		break;
+	case DRAWING_SHAPE_TYPE_RECTANGLE:
+		result = DRAWING_TYPE_RECTANGLE;
+		break;
+	default:
+		result = G_TYPE_INVALID;
+		break;
+	}
+
+	return result;
+}
+
+/*******************************************************************************
+図形の空間索引を取得します。
+*/
+DrawingIndex *
+drawing_document_get_index (DrawingDocument *self)
+{
+	return self->index;
+}
+
+/*******************************************************************************
+次に追加する図形の重なり順を取得します。
+*/
+guint32
+drawing_document_get_order (DrawingDocument *self)
+{
+	return self->order;
+}
+
+/*******************************************************************************
+図形の操作オブジェクトを取得します。操作オブジェクトは必要になったときに作成し、
+生存している間は同じ図形に対して同じオブジェクトを返します。最上位の集団は文書自身です。
+*/
+DrawingShape *
+drawing_document_get_shape (DrawingDocument *self, DrawingShapeType type, guint index)
+{
+	DrawingShape *shape;
+	GType gtype;
+	type = DOCUMENT_STORAGE (type);
+	gtype = drawing_document_get_gtype (type);
+
+	if ((type == DRAWING_SHAPE_TYPE_CLUSTER) && (index == DRAWING_SHAPE_ROOT))
+	{
+		shape = g_object_ref (DRAWING_SHAPE (self));
+	}
+	else if (!gtype || !drawing_document_contains (self, type, index))
+	{
+		shape = NULL;
+	}
+	else if ((shape = g_hash_table_lookup (self->handles, DOCUMENT_KEY (type, index))))
+	{
+		g_object_ref (shape);
+	}
+	else
+	{
+		shape = g_object_new (gtype, NULL);
+		drawing_shape_attach (shape, self, type, index);
+		g_hash_table_insert (self->handles, DOCUMENT_KEY (type, index), shape);
+	}
+
+	return shape;
+}
+
+/*******************************************************************************
+配列の容量を倍に増やします。ファイルの配列を借りている場合は、このときに初めて複製します。
+*/
+static void
+drawing_document_grow (DrawingDocument *self, DrawingShapeType type)
+{
+	DrawingShapeArray *array;
+	array = &self->arrays [type];
+
+	if (self->borrowed [type])
+	{
+		array->x = g_memdup2 (array->x, array->length * sizeof (double));
+		array->y = g_memdup2 (array->y, array->length * sizeof (double));
+		array->width = g_memdup2 (array->width, array->length * sizeof (double));
+		array->height = g_memdup2 (array->height, array->length * sizeof (double));
+		array->colors = g_memdup2 (array->colors, array->length * sizeof (guint32));
+		array->clusters = g_memdup2 (array->clusters, array->length * sizeof (guint32));
+		array->orders = g_memdup2 (array->orders, array->length * sizeof (guint32));
+		array->flags = g_memdup2 (array->flags, array->length * sizeof (guint8));
+		self->borrowed [type] = FALSE;
+	}
+
+	array->capacity = array->capacity ? array->capacity * 2 : DOCUMENT_CAPACITY;
+	array->x = g_renew (double, array->x, array->capacity);
+	array->y = g_renew (double, array->y, array->capacity);
+	array->width = g_renew (double, array->width, array->capacity);
+	array->height = g_renew (double, array->height, array->capacity);
+	array->colors = g_renew (guint32, array->colors, array->capacity);
+	array->clusters = g_renew (guint32, array->clusters, array->capacity);
+	array->orders = g_renew (guint32, array->orders, array->capacity);
+	array->flags = g_renew (guint8, array->flags, array->capacity);
+	self->links [type].next = g_renew (guint32, self->links [type].next, array->capacity);
+	self->links [type].previous = g_renew (guint32, self->links [type].previous, array->capacity);
+
+	if (type == DRAWING_SHAPE_TYPE_CLUSTER)
+	{
+		self->members = g_renew (guint32, self->members, array->capacity);
+	}
+}
+
+/*******************************************************************************
+クラスのインスタンスを初期化します。最上位の集団を 0 番に作成します。
+*/
+static void
+drawing_document_init (DrawingDocument *self)
+{
+	int type;
+
+	for (type = 0; type < DRAWING_SHAPE_N_TYPES; type++)
+	{
+		self->free_lists [type] = g_array_new (FALSE, FALSE, sizeof (guint));
+	}
+
+	self->handles = g_hash_table_new (g_direct_hash, g_direct_equal);
+	self->index = drawing_index_new ();
+	drawing_document_add (self, DRAWING_SHAPE_TYPE_CLUSTER, DRAWING_SHAPE_ROOT, 0, 0, 0, 0, 0);
+	drawing_shape_attach (DRAWING_SHAPE (self), self, DRAWING_SHAPE_TYPE_DOCUMENT, DRAWING_SHAPE_ROOT);
+}
+
+/*******************************************************************************
+図形を属する集団の一覧の先頭につなぎます。最上位の集団は自身に属するので、どの一覧にもつなぎません。
+*/
+static void
+drawing_document_link (DrawingDocument *self, DrawingShapeType type, guint index)
+{
+	DrawingDocumentLinks *links;
+	guint32 cluster, first;
+	links = &self->links [type];
+	cluster = self->arrays [type].clusters [index];
+	links->next [index] = DOCUMENT_NONE;
+	links->previous [index] = DOCUMENT_NONE;
+
+	if ((type != DRAWING_SHAPE_TYPE_CLUSTER) || (index != cluster))
+	{
+		first = self->members [cluster];
+		links->next [index] = first;
+
+		if (first != DOCUMENT_NONE)
+		{
+			self->links [DOCUMENT_TYPE (first)].previous [DOCUMENT_INDEX (first)] = DOCUMENT_LINK (type, index);
+		}
+
+		self->members [cluster] = DOCUMENT_LINK (type, index);
+	}
+}
+
+/*******************************************************************************
+ファイルから読み込んだ配列に合わせて一覧の列を割り当て、使用中の全ての図形を集団の一覧につなぎます。
+*/
+static void
+drawing_document_link_all (DrawingDocument *self)
+{
+	DrawingShapeArray *array;
+	guint index;
+	int type;
+	array = &self->arrays [DRAWING_SHAPE_TYPE_CLUSTER];
+	self->members = g_renew (guint32, self->members, array->capacity);
+
+	for (index = 0; index < array->length; index++)
+	{
+		self->members [index] = DOCUMENT_NONE;
+	}
+	for (type = 0; type < DRAWING_SHAPE_N_TYPES; type++)
+	{
+		array = &self->arrays [type];
+		self->links [type].next = g_renew (guint32, self->links [type].next, array->capacity);
+		self->links [type].previous = g_renew (guint32, self->links [type].previous, array->capacity);
+	}
+	for (type = 0; type < DRAWING_SHAPE_N_TYPES; type++)
+	{
+		array = &self->arrays [type];
+
+		for (index = 0; index < array->length; index++)
+		{
+			if (array->flags [index] & DRAWING_SHAPE_FLAG_USED)
+			{
+				drawing_document_link (self, type, index);
+			}
+		}
+	}
+}
+
+/*******************************************************************************
+図形を移動します。集団の場合は属する全ての図形を移動します。
+*/
+void
+drawing_document_move (DrawingDocument *self, DrawingShapeType type, guint index, double dx, double dy)
+{
+	DrawingDocumentMove move;
+	DrawingShapeArray *array;
+	type = DOCUMENT_STORAGE (type);
+
+	if (drawing_document_contains (self, type, index) && (type == DRAWING_SHAPE_TYPE_CLUSTER))
+	{
+		move.dx = dx;
+		move.dy = dy;
+		drawing_document_foreach_member (self, index, drawing_document_move_member, &move);
+	}
+	else if (drawing_document_contains (self, type, index))
+	{
+		array = &self->arrays [type];
+		drawing_document_set_rectangle (self, type, index, array->x [index] + dx, array->y [index] + dy, array->width [index], array->height [index]);
+	}
+}
+
+/*******************************************************************************
+集団に属する図形を移動します。
+*/
+static void
+drawing_document_move_member (DrawingDocument *self, DrawingShapeType type, guint index, gpointer data)
+{
+	DrawingDocumentMove *move;
+	move = data;
+	drawing_document_move (self, type, index, move->dx, move->dy);
+}
+
+/*******************************************************************************
+クラスのインスタンスを作成します。
+*/
+DrawingDocument *
+drawing_document_new (void)
+{
+	return g_object_new (DRAWING_TYPE_DOCUMENT, NULL);
+}
+
+/*******************************************************************************
+メモリへ割り当てたファイルの配列をそのまま使う文書を作成します。配列と空間索引の節は複製せず、
+図形を追加して容量が足りなくなったときに初めて複製します。file は書き込み可能な私用の割り当てにしておくので、
+文書を変更してもファイルには書き戻しません。配列や空間索引が矛盾している場合は NULL を返します。
+*/
+DrawingDocument *
+drawing_document_new_mapped (GMappedFile *file, const DrawingShapeArray *arrays, const DrawingIndexArray *index, guint32 order)
+{
+	DrawingDocument *self;
+	DrawingIndex *tree;
+	guint n;
+	int type;
+	tree = drawing_document_check (arrays) ? drawing_index_new_mapped (index, arrays) : NULL;
+	self = NULL;
+
+	if (tree)
+	{
+		self = drawing_document_new ();
+		drawing_index_free (self->index);
+		self->index = tree;
+		self->mapped = g_mapped_file_ref (file);
+		self->order = order;
+
+		for (type = 0; type < DRAWING_SHAPE_N_TYPES; type++)
+		{
+			if (arrays [type].length)
+			{
+				drawing_document_free_array (&self->arrays [type]);
+				self->arrays [type] = arrays [type];
+				self->borrowed [type] = TRUE;
+
+				for (n = 0; n < arrays [type].length; n++)
+				{
+					if (!(arrays [type].flags [n] & DRAWING_SHAPE_FLAG_USED))
+					{
+						g_array_append_val (self->free_lists [type], n);
+					}
+				}
+			}
+		}
+
+		drawing_document_link_all (self);
+	}
+
+	return self;
+}
+
+/*******************************************************************************
+点 (x, y) から tolerance 以内にある図形のうち、最も手前にある図形を検索します。
+空間索引で候補を絞り込んでから、図形の形に沿って判定します。見つからない場合は FALSE を返します。
+*/
+gboolean
+drawing_document_pick (DrawingDocument *self, double x, double y, double tolerance, DrawingShapeType *type, guint *index)
+{
+	DrawingDocumentPick pick = { 0 };
+	pick.document = self;
+	pick.x = x;
+	pick.y = y;
+	pick.tolerance = tolerance;
+	drawing_index_query (self->index, x - tolerance, y - tolerance, tolerance * 2, tolerance * 2, drawing_document_pick_member, &pick);
+	*type = pick.type;
+	*index = pick.index;
+	return pick.found;
+}
+
+/*******************************************************************************
+候補の図形が点から許容範囲内にあれば、それまでの候補より手前の場合に限り結果とします。
+円と楕円は許容範囲だけ半径を広げた楕円の内側にあるかどうかで判定します。
+*/
+static void
+drawing_document_pick_member (DrawingShapeType type, guint index, gpointer data)
+{
+	DrawingDocumentPick *pick;
+	const DrawingShapeArray *array;
+	double dx, dy, rx, ry;
+	gboolean hit;
+	pick = data;
+	array = &pick->document->arrays [type];
+	rx = array->width [index] / 2 + pick->tolerance;
+	ry = array->height [index] / 2 + pick->tolerance;
+	dx = pick->x - (array->x [index] + array->width [index] / 2);
+	dy = pick->y - (array->y [index] + array->height [index] / 2);
+
+	if (type == DRAWING_SHAPE_TYPE_RECTANGLE)
+	{
+		hit = (ABS (dx) <= rx) && (ABS (dy) <= ry);
+	}
+	else
+	{
+		hit = (rx > 0) && (ry > 0) && ((dx * dx) / (rx * rx) + (dy * dy) / (ry * ry) <= 1);
+	}
+	if (hit && (!pick->found || (array->orders [index] > pick->order)))
+	{
+		pick->type = type;
+		pick->index = index;
+		pick->order = array->orders [index];
+		pick->found = TRUE;
+	}
+}
+
+/*******************************************************************************
+長方形と交わる全ての図形に対して関数を呼び出します。呼び出す順序は不定なので、
+重なり順が必要な場合は配列の orders で並べ替えます。
+*/
+void
+drawing_document_query (DrawingDocument *self, double x, double y, double width, double height, DrawingIndexFunc func, gpointer data)
+{
+	drawing_index_query (self->index, x, y, width, height, func, data);
+}
+
+/*******************************************************************************
+配列の要素を空きにし、集団の一覧から外します。操作オブジェクトが生存している場合は、図形から切り離します。
+*/
+static void
+drawing_document_release (DrawingDocument *self, DrawingShapeType type, guint index)
+{
+	DrawingShape *shape;
+
+	if (type != DRAWING_SHAPE_TYPE_CLUSTER)
+	{
+		drawing_document_damage (self, type, index);
+	}
+
+	drawing_document_unlink (self, type, index);
+	self->arrays [type].flags [index] = 0;
+	g_array_append_val (self->free_lists [type], index);
+	drawing_index_remove (self->index, type, index);
+	shape = g_hash_table_lookup (self->handles, DOCUMENT_KEY (type, index));
+
+	if (shape)
+	{
+		g_hash_table_remove (self->handles, DOCUMENT_KEY (type, index));
+		drawing_shape_detach (shape);
+	}
+}
+
+/*******************************************************************************
+図形を削除します。集団の場合は属する全ての図形も削除します。最上位の集団は削除できません。
+*/
+void
+drawing_document_remove (DrawingDocument *self, DrawingShapeType type, guint index)
+{
+	type = DOCUMENT_STORAGE (type);
+
+	if (drawing_document_contains (self, type, index) && !((type == DRAWING_SHAPE_TYPE_CLUSTER) && (index == DRAWING_SHAPE_ROOT)))
+	{
+		g_object_ref (self);
+
+		if (type == DRAWING_SHAPE_TYPE_CLUSTER)
+		{
+			drawing_document_foreach_member (self, index, drawing_document_remove_member, NULL);
+		}
+
+		drawing_document_release (self, type, index);
+		g_object_unref (self);
+	}
+}
+
+/*******************************************************************************
+集団に属する図形を削除します。
+*/
+static void
+drawing_document_remove_member (DrawingDocument *self, DrawingShapeType type, guint index, gpointer data)
+{
+	drawing_document_remove (self, type, index);
+}
+
+/*******************************************************************************
+図形の色を 0xAARRGGBB の形式で設定します。集団の場合は属する全ての図形の色を設定します。
+*/
+void
+drawing_document_set_color (DrawingDocument *self, DrawingShapeType type, guint index, guint32 color)
+{
+	type = DOCUMENT_STORAGE (type);
+
+	if (drawing_document_contains (self, type, index) && (type == DRAWING_SHAPE_TYPE_CLUSTER))
+	{
+		drawing_document_foreach_member (self, index, drawing_document_set_member, &color);
+	}
+	else if (drawing_document_contains (self, type, index))
+	{
+		self->arrays [type].colors [index] = color;
+		drawing_document_damage (self, type, index);
+	}
+}
+
+/*******************************************************************************
+集団に属する図形の色を設定します。
+*/
+static void
+drawing_document_set_member (DrawingDocument *self, DrawingShapeType type, guint index, gpointer data)
+{
+	drawing_document_set_color (self, type, index, *(guint32 *) data);
+}
+
+/*******************************************************************************
+図形を囲む長方形を設定します。集団の大きさは属する図形から決まるので設定できません。
+*/
+void
+drawing_document_set_rectangle (DrawingDocument *self, DrawingShapeType type, guint index, double x, double y, double width, double height)
+{
+	DrawingShapeArray *array;
+
+	if ((type != DRAWING_SHAPE_TYPE_CLUSTER) && drawing_document_contains (self, type, index))
+	{
+		drawing_document_damage (self, type, index);
+		array = &self->arrays [type];
+		array->x [index] = x;
+		array->y [index] = y;
+		array->width [index] = width;
+		array->height [index] = height;
+		drawing_index_insert (self->index, type, index, x, y, width, height);
+		drawing_document_damage (self, type, index);
+	}
+}
+
+/*******************************************************************************
+集団に属する図形を囲む長方形を、集団を囲む長方形に加えます。
+*/
+static void
+drawing_document_union_member (DrawingDocument *self, DrawingShapeType type, guint index, gpointer data)
+{
+	graphene_rect_t *bounds, member;
+	bounds = data;
+
+	if (!drawing_document_get_bounds (self, type, index, &member))
+	{
+		member = *bounds;
+	}
+	if (bounds->size.width < 0)
+	{
+		*bounds = member;
+	}
+	else
+	{
+		graphene_rect_union (bounds, &member, bounds);
+	}
+}
+
+/*******************************************************************************
+図形を属する集団の一覧から外します。前後の図形を直接つなぎ直すので、一覧の長さによらず一定の時間で済みます。
+*/
+static void
+drawing_document_unlink (DrawingDocument *self, DrawingShapeType type, guint index)
+{
+	guint32 next, previous;
+	next = self->links [type].next [index];
+	previous = self->links [type].previous [index];
+
+	if (previous != DOCUMENT_NONE)
+	{
+		self->links [DOCUMENT_TYPE (previous)].next [DOCUMENT_INDEX (previous)] = next;
+	}
+	else
+	{
+		self->members [self->arrays [type].clusters [index]] = next;
+	}
+	if (next != DOCUMENT_NONE)
+	{
+		self->links [DOCUMENT_TYPE (next)].previous [DOCUMENT_INDEX (next)] = previous;
+	}
+}
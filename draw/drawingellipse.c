@@ -0,0 +1,54 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include "drawing.h"
+
+/* Drawing Ellipse クラスのインスタンス */
+struct _DrawingEllipse
+{
+	DrawingShape parent_instance;
+};
+
+static void drawing_ellipse_class_init (DrawingEllipseClass *this_class);
+static void drawing_ellipse_init       (DrawingEllipse *self);
+
+/* Drawing Ellipse クラス */
+G_DEFINE_TYPE (DrawingEllipse, drawing_ellipse, DRAWING_TYPE_SHAPE);
+
+/*******************************************************************************
+クラスを初期化します。
+*/
+static void
+drawing_ellipse_class_init (DrawingEllipseClass *this_class)
+{
+}
+
+/*******************************************************************************
+楕円の中心と半径を取得します。
+*/
+void
+drawing_ellipse_get_geometry (DrawingEllipse *self, double *x, double *y, double *radius_x, double *radius_y)
+{
+	double left, top, width, height;
+	drawing_shape_get_rectangle (DRAWING_SHAPE (self), &left, &top, &width, &height);
+	*radius_x = width / 2;
+	*radius_y = height / 2;
+	*x = left + *radius_x;
+	*y = top + *radius_y;
+}
+
+/*******************************************************************************
+クラスのインスタンスを初期化します。
+*/
+static void
+drawing_ellipse_init (DrawingEllipse *self)
+{
+}
+
+/*******************************************************************************
+楕円の中心と半径を設定します。
+*/
+void
+drawing_ellipse_set_geometry (DrawingEllipse *self, double x, double y, double radius_x, double radius_y)
+{
+	drawing_shape_set_rectangle (DRAWING_SHAPE (self), x - radius_x, y - radius_y, radius_x * 2, radius_y * 2);
+}
@@ -0,0 +1,421 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include <glib/gi18n.h>
+#include <glib/gstdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include "drawing.h"
+#define FILE_ALIGN(N)    (((N) + FILE_ALIGNMENT - 1) & ~(guint64) (FILE_ALIGNMENT - 1))
+#define FILE_ALIGNMENT   64
+#define FILE_BYTE_ORDER  0x01020304
+#define FILE_GENERATOR   "com.github.mi19a009.Draw"
+#define FILE_MAGIC       "\x89" "DRAW\r\n\032"
+#define FILE_MAGIC_SIZE  8
+#define FILE_N_COLUMNS   8
+#define FILE_VERSION     1
+#define MESSAGE_INVALID  _("The file is not a valid drawing.")
+#define MESSAGE_LOCAL    _("Only local files can be opened.")
+
+typedef enum   _DrawingFileKind    DrawingFileKind;
+typedef struct _DrawingFileHeader  DrawingFileHeader;
+typedef struct _DrawingFileSection DrawingFileSection;
+
+/* 節の内容の種類 */
+enum _DrawingFileKind
+{
+	DRAWING_FILE_X,
+	DRAWING_FILE_Y,
+	DRAWING_FILE_WIDTH,
+	DRAWING_FILE_HEIGHT,
+	DRAWING_FILE_COLORS,
+	DRAWING_FILE_CLUSTERS,
+	DRAWING_FILE_ORDERS,
+	DRAWING_FILE_FLAGS,
+	DRAWING_FILE_LEAVES,
+	DRAWING_FILE_NODES,
+	DRAWING_FILE_STRINGS,
+};
+
+/* ファイルの先頭 */
+struct _DrawingFileHeader
+{
+	char    magic [FILE_MAGIC_SIZE];
+	guint32 version;
+	guint32 byte_order;
+	guint32 n_sections;
+	guint32 order;
+	guint32 root;
+	guint32 free_node;
+	guint32 node_size;
+	guint32 generator;
+};
+
+/* 節の一覧の要素 */
+struct _DrawingFileSection
+{
+	guint32 kind;
+	guint32 type;
+	guint64 offset;
+	guint64 length;
+};
+
+static gpointer *drawing_file_get_column (DrawingShapeArray *array, guint kind, gsize *size);
+static gboolean  drawing_file_is_stored  (guint type);
+static gboolean  drawing_file_parse      (const guchar *data, gsize size, DrawingShapeArray *arrays, DrawingIndexArray *index, guint32 *order);
+static gboolean  drawing_file_write      (GOutputStream *stream, gconstpointer data, gsize size, guint64 *position, GError **error);
+
+/* ファイルに書き出す図形の種類 */
+static const DrawingShapeType FILE_TYPES [] =
+{
+	DRAWING_SHAPE_TYPE_CIRCLE,
+	DRAWING_SHAPE_TYPE_CLUSTER,
+	DRAWING_SHAPE_TYPE_ELLIPSE,
+	DRAWING_SHAPE_TYPE_RECTANGLE,
+};
+
+/*******************************************************************************
+図形の配列の列と、その要素の大きさを取得します。kind が列でない場合は NULL を返します。
+*/
+static gpointer *
+drawing_file_get_column (DrawingShapeArray *array, guint kind, gsize *size)
+{
+	gpointer *column;
+
+	switch (kind)
+	{
+	case DRAWING_FILE_X:
+		column = (gpointer *) &array->x;
+		*size = sizeof (double);
+		break;
+	case DRAWING_FILE_Y:
+		column = (gpointer *) &array->y;
+		*size = sizeof (double);
+		break;
+	case DRAWING_FILE_WIDTH:
+		column = (gpointer *) &array->width;
+		*size = sizeof (double);
+		break;
+	case DRAWING_FILE_HEIGHT:
+		column = (gpointer *) &array->height;
+		*size = sizeof (double);
+		break;
+	case DRAWING_FILE_COLORS:
+		column = (gpointer *) &array->colors;
+		*size = sizeof (guint32);
+		break;
+	case DRAWING_FILE_CLUSTERS:
+		column = (gpointer *) &array->clusters;
+		*size = sizeof (guint32);
+		break;
+	case DRAWING_FILE_ORDERS:
+		column = (gpointer *) &array->orders;
+		*size = sizeof (guint32);
+		break;
+	case DRAWING_FILE_FLAGS:
+		column = (gpointer *) &array->flags;
+		*size = sizeof (guint8);
+		break;
+	default:
+		column = NULL;
+		*size = 0;
+		break;
+	}
+
+	return column;
+}
+
+/*******************************************************************************
+ファイルに書き出す図形の種類かどうかを判断します。
+*/
+static gboolean
+drawing_file_is_stored (guint type)
+{
+	gboolean result;
+	guint n;
+	result = FALSE;
+
+	for (n = 0; !result && (n < G_N_ELEMENTS (FILE_TYPES)); n++)
+	{
+		result = type == FILE_TYPES [n];
+	}
+
+	return result;
+}
+
+/*******************************************************************************
+文書のファイルを開きます。ファイルは読み取り専用で開き、書き込み可能な私用の割り当てでメモリへ割り当てるので、
+書き込みを禁止されたファイルも開けます。図形の列と空間索引はファイルの中を直接指すので、要素ごとに読み込んで変換することはありません。
+開けない場合やファイルの形式が正しくない場合は、error を設定して NULL を返します。
+*/
+DrawingDocument *
+drawing_file_load (GFile *file, GError **error)
+{
+	DrawingDocument *document;
+	DrawingShapeArray arrays [DRAWING_SHAPE_N_TYPES] = { 0 };
+	DrawingIndexArray index = { 0 };
+	GMappedFile *mapped;
+	char *path;
+	guint32 order;
+	int fd, code;
+	path = g_file_get_path (file);
+	fd = path ? g_open (path, O_RDONLY, 0) : -1;
+	code = errno;
+	mapped = (fd >= 0) ? g_mapped_file_new_from_fd (fd, TRUE, error) : NULL;
+	document = NULL;
+
+	if (!path)
+	{
+		g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED, MESSAGE_LOCAL);
+	}
+	else if (fd < 0)
+	{
+		g_set_error_literal (error, G_FILE_ERROR, g_file_error_from_errno (code), g_strerror (code));
+	}
+	else if (mapped)
+	{
+		if (drawing_file_parse ((const guchar *) g_mapped_file_get_contents (mapped), g_mapped_file_get_length (mapped), arrays, &index, &order))
+		{
+			document = drawing_document_new_mapped (mapped, arrays, &index, order);
+		}
+		if (!document)
+		{
+			g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, MESSAGE_INVALID);
+		}
+
+		g_mapped_file_unref (mapped);
+	}
+	if (fd >= 0)
+	{
+		g_close (fd, NULL);
+	}
+
+	g_free (path);
+	return document;
+}
+
+/*******************************************************************************
+ファイルの先頭と節の一覧を解析し、図形の列と空間索引の配列がファイルの中を指すようにします。
+節が全てファイルに収まり、要素の大きさに揃っていて、図形の種類ごとに全ての列が同じ長さで
+そろっていることを確かめます。配列の中身は文書と空間索引を作成するときに確かめます。
+*/
+static gboolean
+drawing_file_parse (const guchar *data, gsize size, DrawingShapeArray *arrays, DrawingIndexArray *index, guint32 *order)
+{
+	const DrawingFileHeader *header;
+	const DrawingFileSection *section;
+	DrawingShapeArray *array;
+	gpointer *column;
+	guint columns [DRAWING_SHAPE_N_TYPES] = { 0 };
+	gsize element;
+	guint n;
+	gboolean result, strings;
+	header = (const DrawingFileHeader *) data;
+	strings = FALSE;
+	result = (size >= sizeof (DrawingFileHeader)) && !memcmp (header->magic, FILE_MAGIC, FILE_MAGIC_SIZE) && (header->version == FILE_VERSION) && (header->byte_order == FILE_BYTE_ORDER)
+		&& (header->n_sections <= (size - sizeof (DrawingFileHeader)) / sizeof (DrawingFileSection));
+
+	for (n = 0; result && (n < header->n_sections); n++)
+	{
+		section = (const DrawingFileSection *) (data + sizeof (DrawingFileHeader)) + n;
+		column = NULL;
+		element = sizeof (char);
+		result = (section->type < DRAWING_SHAPE_N_TYPES) && (section->length <= G_MAXUINT) && (section->offset % FILE_ALIGNMENT == 0) && (section->offset <= size);
+
+		if (result && (section->kind == DRAWING_FILE_LEAVES))
+		{
+			column = (gpointer *) &index->leaves [section->type];
+			element = sizeof (guint);
+			result = !index->n_leaves [section->type];
+			index->n_leaves [section->type] = (guint) section->length;
+		}
+		else if (result && (section->kind == DRAWING_FILE_NODES))
+		{
+			column = (gpointer *) &index->nodes;
+			element = header->node_size;
+			result = element && !index->nodes;
+			index->length = (guint) section->length;
+		}
+		else if (result && (section->kind == DRAWING_FILE_STRINGS))
+		{
+			result = !strings && section->length && (section->length <= size - section->offset) && !data [section->offset + section->length - 1] && (header->generator < section->length);
+			strings = TRUE;
+		}
+		else if (result)
+		{
+			array = &arrays [section->type];
+			column = drawing_file_get_column (array, section->kind, &element);
+			result = column && drawing_file_is_stored (section->type) && !(columns [section->type] & (1 << section->kind)) && (!columns [section->type] || (array->length == section->length));
+
+			if (result)
+			{
+				columns [section->type] |= 1 << section->kind;
+				array->length = (guint) section->length;
+				array->capacity = (guint) section->length;
+			}
+		}
+
+		result = result && (section->length <= (size - section->offset) / element);
+
+		if (result && column)
+		{
+			*column = (gpointer) (data + section->offset);
+		}
+	}
+	for (n = 0; result && (n < DRAWING_SHAPE_N_TYPES); n++)
+	{
+		result = !columns [n] || (columns [n] == (1 << FILE_N_COLUMNS) - 1);
+	}
+
+	result = result && strings;
+
+	if (result)
+	{
+		index->node_size = header->node_size;
+		index->root = header->root;
+		index->free_node = header->free_node;
+		*order = header->order;
+	}
+
+	return result;
+}
+
+/*******************************************************************************
+文書をファイルに保存します。先頭、節の一覧、各節の順に書き出し、図形の列と空間索引は
+文書の配列から直接書き出すので、ファイル全体の複製は作成しません。各節は 64 バイト境界に揃え、
+開くときにそのままメモリへ割り当てられるようにします。書き込み中に失敗した場合は元のファイルを残し、
+error を設定して FALSE を返します。
+*/
+gboolean
+drawing_file_save (DrawingDocument *document, GFile *file, GError **error)
+{
+	static const guchar PADDING [FILE_ALIGNMENT] = { 0 };
+	DrawingFileHeader header = { 0 };
+	DrawingFileSection *sections, *section;
+	DrawingShapeArray arrays [DRAWING_SHAPE_N_TYPES] = { 0 };
+	DrawingIndexArray index;
+	GFileOutputStream *stream;
+	GCancellable *cancellable;
+	gconstpointer data;
+	guint64 offset, position;
+	gsize element;
+	guint n, kind, type;
+	gboolean result;
+	drawing_index_get_array (drawing_document_get_index (document), &index);
+	header.n_sections = 2;
+
+	for (type = 0; type < DRAWING_SHAPE_N_TYPES; type++)
+	{
+		if (drawing_file_is_stored (type))
+		{
+			arrays [type] = *drawing_document_get_array (document, type);
+			header.n_sections += arrays [type].length ? FILE_N_COLUMNS : 0;
+		}
+
+		header.n_sections += index.n_leaves [type] ? 1 : 0;
+	}
+
+	sections = g_new0 (DrawingFileSection, header.n_sections);
+	offset = FILE_ALIGN (sizeof (DrawingFileHeader) + header.n_sections * sizeof (DrawingFileSection));
+	section = sections;
+
+	for (type = 0; type < DRAWING_SHAPE_N_TYPES; type++)
+	{
+		for (kind = 0; arrays [type].length && (kind < FILE_N_COLUMNS); kind++, section++)
+		{
+			drawing_file_get_column (&arrays [type], kind, &element);
+			section->kind = kind;
+			section->type = type;
+			section->offset = offset;
+			section->length = arrays [type].length;
+			offset = FILE_ALIGN (offset + section->length * element);
+		}
+		if (index.n_leaves [type])
+		{
+			section->kind = DRAWING_FILE_LEAVES;
+			section->type = type;
+			section->offset = offset;
+			section->length = index.n_leaves [type];
+			offset = FILE_ALIGN (offset + section->length * sizeof (guint));
+			section++;
+		}
+	}
+
+	section->kind = DRAWING_FILE_NODES;
+	section->offset = offset;
+	section->length = index.length;
+	offset = FILE_ALIGN (offset + section->length * index.node_size);
+	section++;
+	section->kind = DRAWING_FILE_STRINGS;
+	section->offset = offset;
+	section->length = sizeof (FILE_GENERATOR);
+	memcpy (header.magic, FILE_MAGIC, FILE_MAGIC_SIZE);
+	header.version = FILE_VERSION;
+	header.byte_order = FILE_BYTE_ORDER;
+	header.order = drawing_document_get_order (document);
+	header.root = index.root;
+	header.free_node = index.free_node;
+	header.node_size = (guint32) index.node_size;
+	stream = g_file_replace (file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, error);
+	position = 0;
+	result = stream
+		&& drawing_file_write (G_OUTPUT_STREAM (stream), &header, sizeof (DrawingFileHeader), &position, error)
+		&& drawing_file_write (G_OUTPUT_STREAM (stream), sections, header.n_sections * sizeof (DrawingFileSection), &position, error);
+
+	for (n = 0; result && (n < header.n_sections); n++)
+	{
+		section = &sections [n];
+
+		switch (section->kind)
+		{
+		case DRAWING_FILE_LEAVES:
+			data = index.leaves [section->type];
+			element = sizeof (guint);
+			break;
+		case DRAWING_FILE_NODES:
+			data = index.nodes;
+			element = index.node_size;
+			break;
+		case DRAWING_FILE_STRINGS:
+			data = FILE_GENERATOR;
+			element = sizeof (char);
+			break;
+		default:
+			data = *drawing_file_get_column (&arrays [section->type], section->kind, &element);
+			break;
+		}
+
+		result = drawing_file_write (G_OUTPUT_STREAM (stream), PADDING, section->offset - position, &position, error)
+			&& drawing_file_write (G_OUTPUT_STREAM (stream), data, section->length * element, &position, error);
+	}
+	if (stream && result)
+	{
+		result = g_output_stream_close (G_OUTPUT_STREAM (stream), NULL, error);
+	}
+	else if (stream)
+	{
+		cancellable = g_cancellable_new ();
+		g_cancellable_cancel (cancellable);
+		g_output_stream_close (G_OUTPUT_STREAM (stream), cancellable, NULL);
+		g_object_unref (cancellable);
+	}
+	if (stream)
+	{
+		g_object_unref (stream);
+	}
+
+	g_free (sections);
+	return result;
+}
+
+/*******************************************************************************
+ストリームに書き出し、書き出した位置を進めます。
+*/
+static gboolean
+drawing_file_write (GOutputStream *stream, gconstpointer data, gsize size, guint64 *position, GError **error)
+{
+	gboolean result;
+	result = !size || g_output_stream_write_all (stream, data, size, NULL, NULL, error);
+	*position += size;
+	return result;
+}
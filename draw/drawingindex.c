@@ -0,0 +1,575 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include <string.h>
+#include "drawing.h"
+#define INDEX_CAPACITY  256
+#define INDEX_KEY(T, I) (((I) << 3) | (T))
+#define INDEX_NONE      G_MAXUINT
+#define INDEX_STACK     256
+
+typedef struct _DrawingIndexNode DrawingIndexNode;
+
+/* 境界ボリューム階層の節 */
+struct _DrawingIndexNode
+{
+	double  left;
+	double  top;
+	double  right;
+	double  bottom;
+	guint   parent;
+	guint   child1;
+	guint   child2;
+	int     height;
+	guint32 key;
+};
+
+/* 図形の空間索引 */
+struct _DrawingIndex
+{
+	DrawingIndexNode *nodes;
+	GArray           *leaves [DRAWING_SHAPE_N_TYPES];
+	guint             capacity;
+	guint             length;
+	guint             free_node;
+	guint             root;
+	gboolean          borrowed;
+};
+
+static guint    drawing_index_allocate    (DrawingIndex *self);
+static guint    drawing_index_balance     (DrawingIndex *self, guint a);
+static gboolean drawing_index_check       (const DrawingIndexArray *array, const DrawingShapeArray *shapes);
+static void     drawing_index_combine     (DrawingIndexNode *node, const DrawingIndexNode *a, const DrawingIndexNode *b);
+static double   drawing_index_cost        (const DrawingIndexNode *a, const DrawingIndexNode *b);
+static void     drawing_index_insert_leaf (DrawingIndex *self, guint leaf);
+static void     drawing_index_refit       (DrawingIndex *self, guint node);
+static void     drawing_index_release     (DrawingIndex *self, guint node);
+static void     drawing_index_remove_leaf (DrawingIndex *self, guint leaf);
+static void     drawing_index_replace     (DrawingIndex *self, guint parent, guint old_child, guint new_child);
+
+/*******************************************************************************
+節を確保します。空いている節がない場合は容量を倍に増やします。
+ファイルの節の配列を借りている場合は、このときに初めて複製します。
+新しい節は埋め草も含めて 0 で埋めるので、ファイルへ書き出す内容は毎回同じになります。
+*/
+static guint
+drawing_index_allocate (DrawingIndex *self)
+{
+	guint node;
+
+	if (self->free_node != INDEX_NONE)
+	{
+		node = self->free_node;
+		self->free_node = self->nodes [node].parent;
+	}
+	else
+	{
+		if (self->length == self->capacity)
+		{
+			if (self->borrowed)
+			{
+				self->nodes = g_memdup2 (self->nodes, self->length * sizeof (DrawingIndexNode));
+				self->borrowed = FALSE;
+			}
+
+			self->capacity = self->capacity ? self->capacity * 2 : INDEX_CAPACITY;
+			self->nodes = g_renew (DrawingIndexNode, self->nodes, self->capacity);
+		}
+
+		node = self->length++;
+		memset (&self->nodes [node], 0, sizeof (DrawingIndexNode));
+	}
+
+	self->nodes [node].parent = INDEX_NONE;
+	self->nodes [node].child1 = INDEX_NONE;
+	self->nodes [node].child2 = INDEX_NONE;
+	self->nodes [node].height = 0;
+	return node;
+}
+
+/*******************************************************************************
+節 a の左右の高さが 2 以上違う場合は、高い方の子を持ち上げて木の釣り合いを取ります。
+部分木の新しい根を返します。
+*/
+static guint
+drawing_index_balance (DrawingIndex *self, guint a)
+{
+	DrawingIndexNode *nodes;
+	guint b, c, d, e, f, g, result;
+	nodes = self->nodes;
+	result = a;
+
+	if (nodes [a].height >= 2)
+	{
+		b = nodes [a].child1;
+		c = nodes [a].child2;
+
+		if (nodes [c].height - nodes [b].height > 1)
+		{
+			f = nodes [c].child1;
+			g = nodes [c].child2;
+			nodes [c].child1 = a;
+			nodes [c].parent = nodes [a].parent;
+			nodes [a].parent = c;
+			drawing_index_replace (self, nodes [c].parent, a, c);
+
+			if (nodes [f].height > nodes [g].height)
+			{
+				nodes [c].child2 = f;
+				nodes [a].child2 = g;
+				nodes [g].parent = a;
+			}
+			else
+			{
+				nodes [c].child2 = g;
+				nodes [a].child2 = f;
+				nodes [f].parent = a;
+			}
+
+			drawing_index_refit (self, a);
+			drawing_index_refit (self, c);
+			result = c;
+		}
+		else if (nodes [b].height - nodes [c].height > 1)
+		{
+			d = nodes [b].child1;
+			e = nodes [b].child2;
+			nodes [b].child1 = a;
+			nodes [b].parent = nodes [a].parent;
+			nodes [a].parent = b;
+			drawing_index_replace (self, nodes [b].parent, a, b);
+
+			if (nodes [d].height > nodes [e].height)
+			{
+				nodes [b].child2 = d;
+				nodes [a].child1 = e;
+				nodes [e].parent = a;
+			}
+			else
+			{
+				nodes [b].child2 = e;
+				nodes [a].child1 = d;
+				nodes [d].parent = a;
+			}
+
+			drawing_index_refit (self, a);
+			drawing_index_refit (self, b);
+			result = b;
+		}
+	}
+
+	return result;
+}
+
+/*******************************************************************************
+ファイルから読み込んだ節と葉の配列が木として正しいかを確かめます。
+子と親が互いを指し、子の高さが親より低く、葉の番号が図形の配列に収まり、
+空いている節の一覧が循環しないことを確かめます。親は必ず自身より高いので、使用中の節は全て根につながり、
+空いている節や葉の下にある部分木は受け付けません。壊れたファイルでも範囲外を読みません。
+*/
+static gboolean
+drawing_index_check (const DrawingIndexArray *array, const DrawingShapeArray *shapes)
+{
+	const DrawingIndexNode *nodes, *node;
+	const guint *leaves;
+	guint n, count, free_nodes, type, index;
+	gboolean result;
+	nodes = array->nodes;
+	free_nodes = 0;
+	count = 0;
+	result = (array->node_size == sizeof (DrawingIndexNode)) && ((array->root == INDEX_NONE) || ((array->root < array->length) && (nodes [array->root].parent == INDEX_NONE) && (nodes [array->root].height >= 0) && (nodes [array->root].height < INDEX_STACK - 1)));
+
+	for (n = 0; result && (n < array->length); n++)
+	{
+		node = &nodes [n];
+
+		if (node->height < 0)
+		{
+			free_nodes++;
+		}
+		else if (n != array->root)
+		{
+			result = (node->parent < array->length) && (nodes [node->parent].height > node->height) && ((nodes [node->parent].child1 == n) || (nodes [node->parent].child2 == n));
+		}
+		if (result && (node->height > 0))
+		{
+			result = (node->child1 < array->length) && (node->child2 < array->length) && (node->child1 != node->child2)
+				&& (nodes [node->child1].parent == n) && (nodes [node->child1].height >= 0) && (nodes [node->child1].height < node->height)
+				&& (nodes [node->child2].parent == n) && (nodes [node->child2].height >= 0) && (nodes [node->child2].height < node->height);
+		}
+		else if (result && (node->height == 0))
+		{
+			type = node->key & 7;
+			index = node->key >> 3;
+			result = (type < DRAWING_SHAPE_N_TYPES) && (index < shapes [type].length);
+		}
+	}
+
+	for (n = array->free_node; result && (n != INDEX_NONE); count++)
+	{
+		result = (n < array->length) && (nodes [n].height < 0) && (count < free_nodes);
+		n = result ? nodes [n].parent : INDEX_NONE;
+	}
+
+	result = result && (count == free_nodes);
+
+	for (type = 0; result && (type < DRAWING_SHAPE_N_TYPES); type++)
+	{
+		leaves = array->leaves [type];
+
+		for (index = 0; result && (index < array->n_leaves [type]); index++)
+		{
+			n = leaves [index];
+			result = (n == INDEX_NONE) || ((n < array->length) && (nodes [n].height == 0) && (nodes [n].key == INDEX_KEY (type, index)));
+		}
+	}
+
+	return result;
+}
+
+/*******************************************************************************
+2 つの節を囲む長方形を node に設定します。
+*/
+static void
+drawing_index_combine (DrawingIndexNode *node, const DrawingIndexNode *a, const DrawingIndexNode *b)
+{
+	node->left = MIN (a->left, b->left);
+	node->top = MIN (a->top, b->top);
+	node->right = MAX (a->right, b->right);
+	node->bottom = MAX (a->bottom, b->bottom);
+}
+
+/*******************************************************************************
+2 つの節を囲む長方形の周の半分を求めます。挿入先を選ぶときの費用です。
+*/
+static double
+drawing_index_cost (const DrawingIndexNode *a, const DrawingIndexNode *b)
+{
+	return (MAX (a->right, b->right) - MIN (a->left, b->left)) + (MAX (a->bottom, b->bottom) - MIN (a->top, b->top));
+}
+
+/*******************************************************************************
+空間索引を破棄します。
+*/
+void
+drawing_index_free (DrawingIndex *self)
+{
+	int type;
+
+	for (type = 0; type < DRAWING_SHAPE_N_TYPES; type++)
+	{
+		g_array_unref (self->leaves [type]);
+	}
+
+	if (!self->borrowed)
+	{
+		g_free (self->nodes);
+	}
+
+	g_free (self);
+}
+
+/*******************************************************************************
+ファイルへ書き出すために、節と葉の配列を取得します。配列は次に空間索引を変更するまで有効です。
+*/
+void
+drawing_index_get_array (DrawingIndex *self, DrawingIndexArray *array)
+{
+	int type;
+	array->nodes = self->nodes;
+	array->node_size = sizeof (DrawingIndexNode);
+	array->length = self->length;
+	array->root = self->root;
+	array->free_node = self->free_node;
+
+	for (type = 0; type < DRAWING_SHAPE_N_TYPES; type++)
+	{
+		array->leaves [type] = (const guint *) self->leaves [type]->data;
+		array->n_leaves [type] = self->leaves [type]->len;
+	}
+}
+
+/*******************************************************************************
+図形を囲む長方形を空間索引に追加します。既に追加されている場合は位置を更新します。
+*/
+void
+drawing_index_insert (DrawingIndex *self, DrawingShapeType type, guint index, double x, double y, double width, double height)
+{
+	GArray *leaves;
+	guint leaf, n;
+	drawing_index_remove (self, type, index);
+	leaves = self->leaves [type];
+
+	if (index >= leaves->len)
+	{
+		n = leaves->len;
+		g_array_set_size (leaves, MAX (index + 1, leaves->len * 2));
+
+		for (; n < leaves->len; n++)
+		{
+			g_array_index (leaves, guint, n) = INDEX_NONE;
+		}
+	}
+
+	leaf = drawing_index_allocate (self);
+	self->nodes [leaf].left = x;
+	self->nodes [leaf].top = y;
+	self->nodes [leaf].right = x + width;
+	self->nodes [leaf].bottom = y + height;
+	self->nodes [leaf].key = INDEX_KEY (type, index);
+	g_array_index (leaves, guint, index) = leaf;
+	drawing_index_insert_leaf (self, leaf);
+}
+
+/*******************************************************************************
+葉を木に挿入します。囲む長方形の周が最も小さくなる兄弟を根から降りながら選び、
+新しい親の節を作成した後、根まで長方形を更新しながら釣り合いを取ります。
+*/
+static void
+drawing_index_insert_leaf (DrawingIndex *self, guint leaf)
+{
+	DrawingIndexNode *nodes, *node;
+	double perimeter, cost, inherited, cost1, cost2;
+	guint sibling, parent, old_parent;
+	gboolean descend;
+
+	if (self->root == INDEX_NONE)
+	{
+		self->root = leaf;
+		self->nodes [leaf].parent = INDEX_NONE;
+	}
+	else
+	{
+		nodes = self->nodes;
+		sibling = self->root;
+		descend = nodes [sibling].height > 0;
+
+		while (descend)
+		{
+			node = &nodes [sibling];
+			perimeter = (node->right - node->left) + (node->bottom - node->top);
+			cost = 2 * drawing_index_cost (node, &nodes [leaf]);
+			inherited = cost - 2 * perimeter;
+			cost1 = drawing_index_cost (&nodes [node->child1], &nodes [leaf]) + inherited;
+			cost2 = drawing_index_cost (&nodes [node->child2], &nodes [leaf]) + inherited;
+
+			if (nodes [node->child1].height > 0)
+			{
+				cost1 -= (nodes [node->child1].right - nodes [node->child1].left) + (nodes [node->child1].bottom - nodes [node->child1].top);
+			}
+			if (nodes [node->child2].height > 0)
+			{
+				cost2 -= (nodes [node->child2].right - nodes [node->child2].left) + (nodes [node->child2].bottom - nodes [node->child2].top);
+			}
+			if ((cost < cost1) && (cost < cost2))
+			{
+				descend = FALSE;
+			}
+			else
+			{
+				sibling = (cost1 < cost2) ? node->child1 : node->child2;
+				descend = nodes [sibling].height > 0;
+			}
+		}
+
+		old_parent = self->nodes [sibling].parent;
+		parent = drawing_index_allocate (self);
+		nodes = self->nodes;
+		nodes [parent].parent = old_parent;
+		nodes [parent].child1 = sibling;
+		nodes [parent].child2 = leaf;
+		nodes [sibling].parent = parent;
+		nodes [leaf].parent = parent;
+		drawing_index_replace (self, old_parent, sibling, parent);
+
+		for (parent = nodes [leaf].parent; parent != INDEX_NONE; parent = nodes [parent].parent)
+		{
+			parent = drawing_index_balance (self, parent);
+			drawing_index_refit (self, parent);
+		}
+	}
+}
+
+/*******************************************************************************
+空間索引を作成します。
+*/
+DrawingIndex *
+drawing_index_new (void)
+{
+	DrawingIndex *self;
+	int type;
+	self = g_new0 (DrawingIndex, 1);
+	self->free_node = INDEX_NONE;
+	self->root = INDEX_NONE;
+
+	for (type = 0; type < DRAWING_SHAPE_N_TYPES; type++)
+	{
+		self->leaves [type] = g_array_new (FALSE, FALSE, sizeof (guint));
+	}
+
+	return self;
+}
+
+/*******************************************************************************
+ファイルから読み込んだ配列から空間索引を作成します。図形を 1 つずつ挿入し直す代わりに
+節の配列を複製せずにそのまま使い、節を追加して容量が足りなくなったときに初めて複製します。
+複製するのは図形 1 つあたり 4 バイトの葉の配列だけです。配列が木として正しくない場合は NULL を返します。
+*/
+DrawingIndex *
+drawing_index_new_mapped (const DrawingIndexArray *array, const DrawingShapeArray *shapes)
+{
+	DrawingIndex *self;
+	int type;
+
+	if (drawing_index_check (array, shapes))
+	{
+		self = drawing_index_new ();
+		self->nodes = (DrawingIndexNode *) array->nodes;
+		self->capacity = array->length;
+		self->length = array->length;
+		self->root = array->root;
+		self->free_node = array->free_node;
+		self->borrowed = TRUE;
+
+		for (type = 0; type < DRAWING_SHAPE_N_TYPES; type++)
+		{
+			g_array_append_vals (self->leaves [type], array->leaves [type], array->n_leaves [type]);
+		}
+	}
+	else
+	{
+		self = NULL;
+	}
+
+	return self;
+}
+
+/*******************************************************************************
+長方形と交わる全ての図形に対して関数を呼び出します。図形の数を n とすると、
+見つかる図形が少なければ O(log n) の節だけを調べます。複数のスレッドから同時に呼び出せます。
+*/
+void
+drawing_index_query (DrawingIndex *self, double x, double y, double width, double height, DrawingIndexFunc func, gpointer data)
+{
+	const DrawingIndexNode *node;
+	guint stack [INDEX_STACK];
+	int n;
+	n = 0;
+
+	if (self->root != INDEX_NONE)
+	{
+		stack [n++] = self->root;
+	}
+	while (n > 0)
+	{
+		node = &self->nodes [stack [--n]];
+
+		if ((node->left <= x + width) && (x <= node->right) && (node->top <= y + height) && (y <= node->bottom))
+		{
+			if (node->height == 0)
+			{
+				func (node->key & 7, node->key >> 3, data);
+			}
+			else
+			{
+				stack [n++] = node->child1;
+				stack [n++] = node->child2;
+			}
+		}
+	}
+}
+
+/*******************************************************************************
+子の長方形と高さから節の長方形と高さを求め直します。
+*/
+static void
+drawing_index_refit (DrawingIndex *self, guint node)
+{
+	DrawingIndexNode *nodes;
+	nodes = self->nodes;
+	drawing_index_combine (&nodes [node], &nodes [nodes [node].child1], &nodes [nodes [node].child2]);
+	nodes [node].height = 1 + MAX (nodes [nodes [node].child1].height, nodes [nodes [node].child2].height);
+}
+
+/*******************************************************************************
+節を空いている節の一覧に戻します。古い長方形や葉の番号はファイルへ書き出さないように消します。
+*/
+static void
+drawing_index_release (DrawingIndex *self, guint node)
+{
+	memset (&self->nodes [node], 0, sizeof (DrawingIndexNode));
+	self->nodes [node].parent = self->free_node;
+	self->nodes [node].child1 = INDEX_NONE;
+	self->nodes [node].child2 = INDEX_NONE;
+	self->nodes [node].height = -1;
+	self->free_node = node;
+}
+
+/*******************************************************************************
+図形を空間索引から削除します。追加されていない場合は何もしません。
+*/
+void
+drawing_index_remove (DrawingIndex *self, DrawingShapeType type, guint index)
+{
+	GArray *leaves;
+	guint leaf;
+	leaves = self->leaves [type];
+	leaf = (index < leaves->len) ? g_array_index (leaves, guint, index) : INDEX_NONE;
+
+	if (leaf != INDEX_NONE)
+	{
+		drawing_index_remove_leaf (self, leaf);
+		drawing_index_release (self, leaf);
+		g_array_index (leaves, guint, index) = INDEX_NONE;
+	}
+}
+
+/*******************************************************************************
+葉を木から外します。親の節を取り除いて兄弟を祖父の子にし、根まで長方形を更新します。
+*/
+static void
+drawing_index_remove_leaf (DrawingIndex *self, guint leaf)
+{
+	DrawingIndexNode *nodes;
+	guint parent, grandparent, sibling;
+	nodes = self->nodes;
+
+	if (leaf == self->root)
+	{
+		self->root = INDEX_NONE;
+	}
+	else
+	{
+		parent = nodes [leaf].parent;
+		grandparent = nodes [parent].parent;
+		sibling = (nodes [parent].child1 == leaf) ? nodes [parent].child2 : nodes [parent].child1;
+		nodes [sibling].parent = grandparent;
+		drawing_index_replace (self, grandparent, parent, sibling);
+		drawing_index_release (self, parent);
+
+		for (; grandparent != INDEX_NONE; grandparent = nodes [grandparent].parent)
+		{
+			grandparent = drawing_index_balance (self, grandparent);
+			drawing_index_refit (self, grandparent);
+		}
+	}
+}
+
+/*******************************************************************************
+親の子を置き換えます。親がない場合は根を置き換えます。
+*/
+static void
+drawing_index_replace (DrawingIndex *self, guint parent, guint old_child, guint new_child)
+{
+	if (parent == INDEX_NONE)
+	{
+		self->root = new_child;
+	}
+	else if (self->nodes [parent].child1 == old_child)
+	{
+		self->nodes [parent].child1 = new_child;
+	}
+	else
+	{
+		self->nodes [parent].child2 = new_child;
+	}
+}
@@ -0,0 +1,49 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include "drawing.h"
+
+/* Drawing Rectangle クラスのインスタンス */
+struct _DrawingRectangle
+{
+	DrawingShape parent_instance;
+};
+
+static void drawing_rectangle_class_init (DrawingRectangleClass *this_class);
+static void drawing_rectangle_init       (DrawingRectangle *self);
+
+/* Drawing Rectangle クラス */
+G_DEFINE_TYPE (DrawingRectangle, drawing_rectangle, DRAWING_TYPE_SHAPE);
+
+/*******************************************************************************
+クラスを初期化します。
+*/
+static void
+drawing_rectangle_class_init (DrawingRectangleClass *this_class)
+{
+}
+
+/*******************************************************************************
+長方形の左上の座標と大きさを取得します。
+*/
+void
+drawing_rectangle_get_geometry (DrawingRectangle *self, double *x, double *y, double *width, double *height)
+{
+	drawing_shape_get_rectangle (DRAWING_SHAPE (self), x, y, width, height);
+}
+
+/*******************************************************************************
+クラスのインスタンスを初期化します。
+*/
+static void
+drawing_rectangle_init (DrawingRectangle *self)
+{
+}
+
+/*******************************************************************************
+長方形の左上の座標と大きさを設定します。
+*/
+void
+drawing_rectangle_set_geometry (DrawingRectangle *self, double x, double y, double width, double height)
+{
+	drawing_shape_set_rectangle (DRAWING_SHAPE (self), x, y, width, height);
+}
@@ -0,0 +1,106 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include "drawing.h"
+#define RENDER_ALPHA(C) ((((C) >> 24) & 0xFF) / 255.0)
+#define RENDER_BLUE(C)  (((C) & 0xFF) / 255.0)
+#define RENDER_GREEN(C) ((((C) >> 8) & 0xFF) / 255.0)
+#define RENDER_RED(C)   ((((C) >> 16) & 0xFF) / 255.0)
+
+typedef struct _DrawingRenderItem DrawingRenderItem;
+
+/* 描画する図形 */
+struct _DrawingRenderItem
+{
+	guint32          order;
+	DrawingShapeType type;
+	guint            index;
+};
+
+static void drawing_render_collect (DrawingShapeType type, guint index, gpointer data);
+static int  drawing_render_compare (gconstpointer a, gconstpointer b);
+static void drawing_render_shape   (cairo_t *cr, const DrawingShapeArray *array, DrawingShapeType type, guint index);
+
+/*******************************************************************************
+文書の範囲 (x, y, width, height) と交わる図形を、重なり順に cr へ塗りつぶします。
+cr は文書の座標系に変換しておきます。範囲の外にある図形は空間索引で除くので、
+描画の費用は文書全体ではなく範囲の中の図形の数で決まります。
+*/
+void
+drawing_render_area (DrawingDocument *document, cairo_t *cr, double x, double y, double width, double height)
+{
+	DrawingRenderItem *item;
+	GArray *items;
+	guint n;
+	items = g_array_new (FALSE, FALSE, sizeof (DrawingRenderItem));
+	drawing_document_query (document, x, y, width, height, drawing_render_collect, items);
+
+	for (n = 0; n < items->len; n++)
+	{
+		item = &g_array_index (items, DrawingRenderItem, n);
+		item->order = drawing_document_get_array (document, item->type)->orders [item->index];
+	}
+
+	g_array_sort (items, drawing_render_compare);
+
+	for (n = 0; n < items->len; n++)
+	{
+		item = &g_array_index (items, DrawingRenderItem, n);
+		drawing_render_shape (cr, drawing_document_get_array (document, item->type), item->type, item->index);
+	}
+
+	g_array_unref (items);
+}
+
+/*******************************************************************************
+空間索引で見つかった図形を一覧に追加します。重なり順は後でまとめて読み込みます。
+*/
+static void
+drawing_render_collect (DrawingShapeType type, guint index, gpointer data)
+{
+	DrawingRenderItem item;
+	item.order = 0;
+	item.type = type;
+	item.index = index;
+	g_array_append_val ((GArray *) data, item);
+}
+
+/*******************************************************************************
+図形を重なり順に比較します。
+*/
+static int
+drawing_render_compare (gconstpointer a, gconstpointer b)
+{
+	const DrawingRenderItem *item1, *item2;
+	item1 = a;
+	item2 = b;
+	return (item1->order > item2->order) - (item1->order < item2->order);
+}
+
+/*******************************************************************************
+図形を 1 つ塗りつぶします。円と楕円は、単位円を外接する長方形の大きさに拡大して描きます。
+*/
+static void
+drawing_render_shape (cairo_t *cr, const DrawingShapeArray *array, DrawingShapeType type, guint index)
+{
+	guint32 color;
+	double width, height;
+	color = array->colors [index];
+	width = array->width [index];
+	height = array->height [index];
+	cairo_set_source_rgba (cr, RENDER_RED (color), RENDER_GREEN (color), RENDER_BLUE (color), RENDER_ALPHA (color));
+
+	if (type == DRAWING_SHAPE_TYPE_RECTANGLE)
+	{
+		cairo_rectangle (cr, array->x [index], array->y [index], width, height);
+		cairo_fill (cr);
+	}
+	else if ((width > 0) && (height > 0))
+	{
+		cairo_save (cr);
+		cairo_translate (cr, array->x [index] + width / 2, array->y [index] + height / 2);
+		cairo_scale (cr, width / 2, height / 2);
+		cairo_arc (cr, 0, 0, 1, 0, 2 * G_PI);
+		cairo_restore (cr);
+		cairo_fill (cr);
+	}
+}
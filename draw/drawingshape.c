@@ -0,0 +1,240 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include "drawing.h"
+
+typedef struct _DrawingShapePrivate DrawingShapePrivate;
+
+/* Drawing Shape クラスのインスタンスの非公開部分 */
+struct _DrawingShapePrivate
+{
+	DrawingDocument *document;
+	DrawingShapeType type;
+	guint            index;
+};
+
+static void drawing_shape_class_init (DrawingShapeClass *this_class);
+static void drawing_shape_dispose    (GObject *self);
+static void drawing_shape_init       (DrawingShape *self);
+
+/* Drawing Shape クラス */
+G_DEFINE_TYPE_WITH_PRIVATE (DrawingShape, drawing_shape, G_TYPE_OBJECT);
+
+/*******************************************************************************
+操作オブジェクトを文書の図形に結び付けます。文書自身の場合は文書を参照しません。
+*/
+void
+drawing_shape_attach (DrawingShape *self, DrawingDocument *document, DrawingShapeType type, guint index)
+{
+	DrawingShapePrivate *properties;
+	properties = drawing_shape_get_instance_private (self);
+	properties->document = ((gpointer) document == (gpointer) self) ? document : g_object_ref (document);
+	properties->type = type;
+	properties->index = index;
+}
+
+/*******************************************************************************
+クラスを初期化します。
+*/
+static void
+drawing_shape_class_init (DrawingShapeClass *this_class)
+{
+	G_OBJECT_CLASS (this_class)->dispose = drawing_shape_dispose;
+}
+
+/*******************************************************************************
+操作オブジェクトを文書の図形から切り離します。図形を削除したときに文書が呼び出します。
+*/
+void
+drawing_shape_detach (DrawingShape *self)
+{
+	DrawingShapePrivate *properties;
+	properties = drawing_shape_get_instance_private (self);
+
+	if ((gpointer) properties->document != (gpointer) self)
+	{
+		g_clear_object (&properties->document);
+	}
+
+	properties->type = DRAWING_SHAPE_TYPE_NULL;
+	properties->index = 0;
+}
+
+/*******************************************************************************
+クラスのインスタンスを破棄します。文書の操作オブジェクトの一覧から削除します。
+*/
+static void
+drawing_shape_dispose (GObject *self)
+{
+	DrawingShapePrivate *properties;
+	properties = drawing_shape_get_instance_private (DRAWING_SHAPE (self));
+
+	if (properties->document && ((gpointer) properties->document != (gpointer) self))
+	{
+		drawing_document_forget (properties->document, properties->type, properties->index);
+		drawing_shape_detach (DRAWING_SHAPE (self));
+	}
+
+	G_OBJECT_CLASS (drawing_shape_parent_class)->dispose (self);
+}
+
+/*******************************************************************************
+図形を囲む長方形を取得します。図形が削除されている場合は FALSE を返します。
+*/
+gboolean
+drawing_shape_get_bounds (DrawingShape *self, graphene_rect_t *bounds)
+{
+	DrawingShapePrivate *properties;
+	properties = drawing_shape_get_instance_private (self);
+	return properties->document && drawing_document_get_bounds (properties->document, properties->type, properties->index, bounds);
+}
+
+/*******************************************************************************
+図形の色を 0xAARRGGBB の形式で取得します。
+*/
+guint32
+drawing_shape_get_color (DrawingShape *self)
+{
+	DrawingShapePrivate *properties;
+	guint32 color;
+	properties = drawing_shape_get_instance_private (self);
+
+	if (properties->document)
+	{
+		color = drawing_document_get_array (properties->document, properties->type)->colors [properties->index];
+	}
+	else
+	{
+		color = 0;
+	}
+
+	return color;
+}
+
+/*******************************************************************************
+図形を持つ文書を取得します。図形が削除されている場合は NULL を返します。
+*/
+DrawingDocument *
+drawing_shape_get_document (DrawingShape *self)
+{
+	DrawingShapePrivate *properties;
+	properties = drawing_shape_get_instance_private (self);
+	return properties->document;
+}
+
+/*******************************************************************************
+文書の配列における図形の番号を取得します。
+*/
+guint
+drawing_shape_get_index (DrawingShape *self)
+{
+	DrawingShapePrivate *properties;
+	properties = drawing_shape_get_instance_private (self);
+	return properties->index;
+}
+
+/*******************************************************************************
+図形を囲む長方形を、文書の配列と同じ精度で取得します。集団や削除された図形の場合は FALSE を返します。
+*/
+gboolean
+drawing_shape_get_rectangle (DrawingShape *self, double *x, double *y, double *width, double *height)
+{
+	DrawingShapePrivate *properties;
+	const DrawingShapeArray *array;
+	gboolean result;
+	properties = drawing_shape_get_instance_private (self);
+	result = properties->document && (properties->type != DRAWING_SHAPE_TYPE_CLUSTER) && (properties->type != DRAWING_SHAPE_TYPE_DOCUMENT);
+
+	if (result)
+	{
+		array = drawing_document_get_array (properties->document, properties->type);
+		*x = array->x [properties->index];
+		*y = array->y [properties->index];
+		*width = array->width [properties->index];
+		*height = array->height [properties->index];
+	}
+	else
+	{
+		*x = *y = *width = *height = 0;
+	}
+
+	return result;
+}
+
+/*******************************************************************************
+図形の種類を取得します。図形が削除されている場合は DRAWING_SHAPE_TYPE_NULL を返します。
+*/
+DrawingShapeType
+drawing_shape_get_shape_type (DrawingShape *self)
+{
+	DrawingShapePrivate *properties;
+	properties = drawing_shape_get_instance_private (self);
+	return properties->type;
+}
+
+/*******************************************************************************
+クラスのインスタンスを初期化します。
+*/
+static void
+drawing_shape_init (DrawingShape *self)
+{
+}
+
+/*******************************************************************************
+図形を移動します。
+*/
+void
+drawing_shape_move (DrawingShape *self, double dx, double dy)
+{
+	DrawingShapePrivate *properties;
+	properties = drawing_shape_get_instance_private (self);
+
+	if (properties->document)
+	{
+		drawing_document_move (properties->document, properties->type, properties->index, dx, dy);
+	}
+}
+
+/*******************************************************************************
+図形を文書から削除します。操作オブジェクトは図形から切り離されます。
+*/
+void
+drawing_shape_remove (DrawingShape *self)
+{
+	DrawingShapePrivate *properties;
+	properties = drawing_shape_get_instance_private (self);
+
+	if (properties->document)
+	{
+		drawing_document_remove (properties->document, properties->type, properties->index);
+	}
+}
+
+/*******************************************************************************
+図形の色を 0xAARRGGBB の形式で設定します。
+*/
+void
+drawing_shape_set_color (DrawingShape *self, guint32 color)
+{
+	DrawingShapePrivate *properties;
+	properties = drawing_shape_get_instance_private (self);
+
+	if (properties->document)
+	{
+		drawing_document_set_color (properties->document, properties->type, properties->index, color);
+	}
+}
+
+/*******************************************************************************
+図形を囲む長方形を設定します。集団の大きさは属する図形から決まるので設定できません。
+*/
+void
+drawing_shape_set_rectangle (DrawingShape *self, double x, double y, double width, double height)
+{
+	DrawingShapePrivate *properties;
+	properties = drawing_shape_get_instance_private (self);
+
+	if (properties->document)
+	{
+		drawing_document_set_rectangle (properties->document, properties->type, properties->index, x, y, width, height);
+	}
+}
@@ -0,0 +1,328 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include <math.h>
+#include "drawing.h"
+#define TILES_CAPACITY  256
+#define TILES_FORMAT    CAIRO_FORMAT_ARGB32
+#define TILES_KEY(C, R) ((gint64) (((guint64) (guint32) (R) << 32) | (guint32) (C)))
+#define TILES_SIZE      256
+#define TILES_TEXTURE   GDK_MEMORY_DEFAULT
+
+typedef struct _DrawingTilesJob  DrawingTilesJob;
+typedef struct _DrawingTilesTile DrawingTilesTile;
+
+/* 区画の描画の要求 */
+struct _DrawingTilesJob
+{
+	DrawingTilesTile *tile;
+	DrawingDocument  *document;
+	GdkTexture       *texture;
+	double            factor;
+	int               column;
+	int               row;
+};
+
+/* 描画済みの区画 */
+struct _DrawingTilesTile
+{
+	gint64      key;
+	GdkTexture *texture;
+	guint64     stamp;
+	int         column;
+	int         row;
+	gboolean    dirty;
+};
+
+/* 文書を区画に分けて描画した結果 */
+struct _DrawingTiles
+{
+	GHashTable  *tiles;
+	GThreadPool *pool;
+	GMutex       mutex;
+	GCond        cond;
+	double       factor;
+	guint64      clock;
+	int          pending;
+};
+
+static int  drawing_tiles_compare   (gconstpointer a, gconstpointer b);
+static void drawing_tiles_evict     (DrawingTiles *self);
+static void drawing_tiles_free_tile (DrawingTilesTile *tile);
+static void drawing_tiles_render    (DrawingTiles *self, GArray *jobs);
+static void drawing_tiles_run       (gpointer data, gpointer user_data);
+
+/*******************************************************************************
+全ての区画を破棄します。表示する文書が変わったときに呼び出します。
+*/
+void
+drawing_tiles_clear (DrawingTiles *self)
+{
+	g_hash_table_remove_all (self->tiles);
+}
+
+/*******************************************************************************
+区画を最後に表示した時刻の順に比較します。
+*/
+static int
+drawing_tiles_compare (gconstpointer a, gconstpointer b)
+{
+	const DrawingTilesTile *tile1, *tile2;
+	tile1 = a;
+	tile2 = b;
+	return (tile1->stamp > tile2->stamp) - (tile1->stamp < tile2->stamp);
+}
+
+/*******************************************************************************
+文書の範囲 (x, y, width, height) に重なる区画を、次に表示するときに描き直すようにします。
+範囲の広さに関わらず描画済みの区画だけを調べるので、まだ描画していない区画は何もしません。
+*/
+void
+drawing_tiles_damage (DrawingTiles *self, double x, double y, double width, double height)
+{
+	DrawingTilesTile *tile;
+	GHashTableIter iter;
+	double left, top, right, bottom;
+
+	if (self->factor > 0)
+	{
+		left = floor ((x * self->factor - 1) / TILES_SIZE);
+		top = floor ((y * self->factor - 1) / TILES_SIZE);
+		right = floor (((x + width) * self->factor + 1) / TILES_SIZE);
+		bottom = floor (((y + height) * self->factor + 1) / TILES_SIZE);
+		g_hash_table_iter_init (&iter, self->tiles);
+
+		while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &tile))
+		{
+			if ((tile->column >= left) && (tile->column <= right) && (tile->row >= top) && (tile->row <= bottom))
+			{
+				tile->dirty = TRUE;
+			}
+		}
+	}
+}
+
+/*******************************************************************************
+区画の数が上限を超えた場合は、最後に表示してから時間の経った区画から破棄します。
+今回表示した区画は破棄しません。
+*/
+static void
+drawing_tiles_evict (DrawingTiles *self)
+{
+	DrawingTilesTile *tile;
+	GList *tiles, *node;
+	guint size;
+	size = g_hash_table_size (self->tiles);
+
+	if (size > TILES_CAPACITY)
+	{
+		tiles = g_list_sort (g_hash_table_get_values (self->tiles), drawing_tiles_compare);
+
+		for (node = tiles; node && (size > TILES_CAPACITY); node = node->next)
+		{
+			tile = node->data;
+
+			if (tile->stamp != self->clock)
+			{
+				g_hash_table_remove (self->tiles, &tile->key);
+				size--;
+			}
+		}
+
+		g_list_free (tiles);
+	}
+}
+
+/*******************************************************************************
+区画の描画結果を破棄します。作業スレッドの終了を待ちます。
+*/
+void
+drawing_tiles_free (DrawingTiles *self)
+{
+	g_thread_pool_free (self->pool, FALSE, TRUE);
+	g_hash_table_unref (self->tiles);
+	g_mutex_clear (&self->mutex);
+	g_cond_clear (&self->cond);
+	g_free (self);
+}
+
+/*******************************************************************************
+区画を破棄します。
+*/
+static void
+drawing_tiles_free_tile (DrawingTilesTile *tile)
+{
+	g_clear_object (&tile->texture);
+	g_free (tile);
+}
+
+/*******************************************************************************
+区画の描画結果を作成します。区画は全てのプロセッサーで並列に描画します。
+*/
+DrawingTiles *
+drawing_tiles_new (void)
+{
+	DrawingTiles *self;
+	self = g_new0 (DrawingTiles, 1);
+	self->tiles = g_hash_table_new_full (g_int64_hash, g_int64_equal, NULL, (GDestroyNotify) drawing_tiles_free_tile);
+	self->pool = g_thread_pool_new (drawing_tiles_run, self, (int) g_get_num_processors (), FALSE, NULL);
+	g_mutex_init (&self->mutex);
+	g_cond_init (&self->cond);
+	return self;
+}
+
+/*******************************************************************************
+要求された区画をスレッド プールで描画し、全て終わるまで待ちます。
+作業スレッドは文書を読むだけなので、待っている間にメイン スレッドは文書を変更しません。
+*/
+static void
+drawing_tiles_render (DrawingTiles *self, GArray *jobs)
+{
+	DrawingTilesJob *job;
+	guint n;
+	self->pending = jobs->len;
+
+	for (n = 0; n < jobs->len; n++)
+	{
+		g_thread_pool_push (self->pool, &g_array_index (jobs, DrawingTilesJob, n), NULL);
+	}
+
+	g_mutex_lock (&self->mutex);
+
+	while (self->pending)
+	{
+		g_cond_wait (&self->cond, &self->mutex);
+	}
+
+	g_mutex_unlock (&self->mutex);
+
+	for (n = 0; n < jobs->len; n++)
+	{
+		job = &g_array_index (jobs, DrawingTilesJob, n);
+		g_clear_object (&job->tile->texture);
+		job->tile->texture = job->texture;
+		job->tile->dirty = FALSE;
+	}
+}
+
+/*******************************************************************************
+作業スレッドです。区画ごとに専用の画像に、区画と重なる図形だけを描画してテクスチャにします。
+*/
+static void
+drawing_tiles_run (gpointer data, gpointer user_data)
+{
+	DrawingTiles *self;
+	DrawingTilesJob *job;
+	cairo_surface_t *surface;
+	cairo_t *cr;
+	GBytes *bytes;
+	guchar *pixels;
+	int stride;
+	job = data;
+	self = user_data;
+	stride = cairo_format_stride_for_width (TILES_FORMAT, TILES_SIZE);
+	pixels = g_malloc ((gsize) stride * TILES_SIZE);
+	surface = cairo_image_surface_create_for_data (pixels, TILES_FORMAT, TILES_SIZE, TILES_SIZE, stride);
+	cr = cairo_create (surface);
+	cairo_set_source_rgb (cr, 1, 1, 1);
+	cairo_paint (cr);
+	cairo_translate (cr, -job->column * TILES_SIZE, -job->row * TILES_SIZE);
+	cairo_scale (cr, job->factor, job->factor);
+	drawing_render_area (job->document, cr, job->column * TILES_SIZE / job->factor, job->row * TILES_SIZE / job->factor, TILES_SIZE / job->factor, TILES_SIZE / job->factor);
+	cairo_destroy (cr);
+	cairo_surface_flush (surface);
+	cairo_surface_destroy (surface);
+	bytes = g_bytes_new_take (pixels, (gsize) stride * TILES_SIZE);
+	job->texture = gdk_memory_texture_new (TILES_SIZE, TILES_SIZE, TILES_TEXTURE, bytes, stride);
+	g_bytes_unref (bytes);
+	g_mutex_lock (&self->mutex);
+
+	if (!--self->pending)
+	{
+		g_cond_signal (&self->cond);
+	}
+
+	g_mutex_unlock (&self->mutex);
+}
+
+/*******************************************************************************
+表示領域と重なる区画のテクスチャを snapshot に追加します。
+(x, y) は表示領域の左上に表示する文書の座標、width と height は表示領域の大きさです。
+区画は文書の座標に固定した格子なので、拡大率が同じ間はスクロールしても描画済みの区画を使い回し、
+まだ描画していない区画と変更された区画だけを描画します。拡大率が変わった場合は全て描き直します。
+*/
+void
+drawing_tiles_snapshot (DrawingTiles *self, DrawingDocument *document, GtkSnapshot *snapshot, double zoom, double x, double y, int width, int height, int scale)
+{
+	DrawingTilesJob job = { 0 };
+	DrawingTilesTile *tile;
+	GArray *jobs;
+	gint64 key;
+	double left, top;
+	int column, row, first_column, first_row, last_column, last_row;
+
+	if (self->factor != zoom * scale)
+	{
+		drawing_tiles_clear (self);
+		self->factor = zoom * scale;
+	}
+
+	self->clock++;
+	left = round (x * self->factor);
+	top = round (y * self->factor);
+	first_column = (int) floor (left / TILES_SIZE);
+	first_row = (int) floor (top / TILES_SIZE);
+	last_column = (int) floor ((left + width * scale - 1) / TILES_SIZE);
+	last_row = (int) floor ((top + height * scale - 1) / TILES_SIZE);
+	jobs = g_array_new (FALSE, FALSE, sizeof (DrawingTilesJob));
+	job.document = document;
+	job.factor = self->factor;
+
+	for (row = first_row; row <= last_row; row++)
+	{
+		for (column = first_column; column <= last_column; column++)
+		{
+			key = TILES_KEY (column, row);
+			tile = g_hash_table_lookup (self->tiles, &key);
+
+			if (!tile)
+			{
+				tile = g_new0 (DrawingTilesTile, 1);
+				tile->key = key;
+				tile->column = column;
+				tile->row = row;
+				tile->dirty = TRUE;
+				g_hash_table_insert (self->tiles, &tile->key, tile);
+			}
+			if (tile->dirty)
+			{
+				job.tile = tile;
+				job.column = column;
+				job.row = row;
+				g_array_append_val (jobs, job);
+			}
+
+			tile->stamp = self->clock;
+		}
+	}
+
+	if (jobs->len)
+	{
+		drawing_tiles_render (self, jobs);
+	}
+
+	gtk_snapshot_push_clip (snapshot, &GRAPHENE_RECT_INIT (0, 0, width, height));
+
+	for (row = first_row; row <= last_row; row++)
+	{
+		for (column = first_column; column <= last_column; column++)
+		{
+			key = TILES_KEY (column, row);
+			tile = g_hash_table_lookup (self->tiles, &key);
+			gtk_snapshot_append_texture (snapshot, tile->texture, &GRAPHENE_RECT_INIT ((column * TILES_SIZE - left) / scale, (row * TILES_SIZE - top) / scale, (double) TILES_SIZE / scale, (double) TILES_SIZE / scale));
+		}
+	}
+
+	gtk_snapshot_pop (snapshot);
+	g_array_unref (jobs);
+	drawing_tiles_evict (self);
+}
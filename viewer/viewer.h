@@ -1,23 +1,138 @@
 /* Copyright (C) 2025 Taichi Murakami. */
 #include <gtk/gtk.h>
+#define VIEWER_CONVERT_N_PATHS   4
 #define VIEWER_RESOURCE_PATH_CCH 64
 #define VIEWER_TYPE_APPLICATION        (viewer_application_get_type        ())
 #define VIEWER_TYPE_APPLICATION_WINDOW (viewer_application_window_get_type ())
+#define VIEWER_TYPE_CACHE              (viewer_cache_get_type              ())
+#define VIEWER_TYPE_IMAGE              (viewer_image_get_type              ())
+#define VIEWER_TYPE_VIEW               (viewer_view_get_type               ())
 #define PARAM_SPEC_BOOLEAN(PROPERTY) (g_param_spec_boolean ((PROPERTY ## _NAME), (PROPERTY ## _NICK), (PROPERTY ## _BLURB),                                                             (PROPERTY ## _DEFAULT_VALUE), (PROPERTY ## _FLAGS)))
 #define PARAM_SPEC_FLOAT(PROPERTY)   (g_param_spec_float   ((PROPERTY ## _NAME), (PROPERTY ## _NICK), (PROPERTY ## _BLURB), (PROPERTY ## _MINIMUM_VALUE), (PROPERTY ## _MAXIMUM_VALUE), (PROPERTY ## _DEFAULT_VALUE), (PROPERTY ## _FLAGS)))
 #define PARAM_SPEC_OBJECT(PROPERTY)  (g_param_spec_object  ((PROPERTY ## _NAME), (PROPERTY ## _NICK), (PROPERTY ## _BLURB), (PROPERTY ## _OBJECT_TYPE),                                                               (PROPERTY ## _FLAGS)))
 
+typedef enum _ViewerConvertPath ViewerConvertPath;
+typedef enum _ViewerDeepFormat  ViewerDeepFormat;
+typedef struct _ViewerPlayer    ViewerPlayer;
+typedef void (*ViewerConvertFunc) (const guchar *source, guchar *destination, int width);
+
+/* 画素変換の命令セット */
+enum _ViewerConvertPath
+{
+	VIEWER_CONVERT_PATH_SCALAR,
+	VIEWER_CONVERT_PATH_SSE2,
+	VIEWER_CONVERT_PATH_AVX2,
+	VIEWER_CONVERT_PATH_NEON,
+};
+
+/* 8 ビットを超える精度の画素の並び */
+enum _ViewerDeepFormat
+{
+	VIEWER_DEEP_GRAY16,
+	VIEWER_DEEP_RGBA16,
+	VIEWER_DEEP_GRAY_FLOAT,
+	VIEWER_DEEP_RGBA_FLOAT,
+};
+
 G_DECLARE_FINAL_TYPE (ViewerApplication,       viewer_application,        VIEWER, APPLICATION,        GtkApplication);
 G_DECLARE_FINAL_TYPE (ViewerApplicationWindow, viewer_application_window, VIEWER, APPLICATION_WINDOW, GtkApplicationWindow);
+G_DECLARE_FINAL_TYPE (ViewerCache,             viewer_cache,              VIEWER, CACHE,              GObject);
+G_DECLARE_FINAL_TYPE (ViewerImage,             viewer_image,              VIEWER, IMAGE,              GObject);
+G_DECLARE_FINAL_TYPE (ViewerView,              viewer_view,               VIEWER, VIEW,               GtkWidget);
+
+typedef void (*ViewerCacheWaitFunc)      (ViewerImage *image, gpointer user_data);
+typedef void (*ViewerImageReadFunc)      (gpointer data, int level, int x, int y, int width, int height, guchar *destination, int destination_stride);
+typedef void (*ViewerLoaderProgressFunc) (gpointer source_object, ViewerImage *image, gpointer user_data);
 
 /* Viewer */
-cairo_surface_t *viewer_create_surface_from_file (cairo_t *cairo, GFile *file, int *surface_width, int *surface_height, GError **error);
-GResource       *viewer_get_resource             (void);
-int              viewer_get_resource_path        (char *buffer, size_t maxlen, const char *name);
-GSettings       *viewer_get_settings             (void);
+GResource *viewer_get_resource      (void);
+int        viewer_get_resource_path (char *buffer, size_t maxlen, const char *name);
+GSettings *viewer_get_settings      (void);
 
 /* Viewer Application */
-GApplication *viewer_application_new (const char *application_id, GApplicationFlags flags);
+ViewerCache  *viewer_application_get_cache (ViewerApplication *self);
+GApplication *viewer_application_new       (const char *application_id, GApplicationFlags flags);
+
+/* Viewer Cache */
+char        *viewer_cache_get_key      (GFile *file, GCancellable *cancellable, GError **error);
+void         viewer_cache_insert       (ViewerCache *self, const char *key, ViewerImage *image);
+ViewerImage *viewer_cache_lookup       (ViewerCache *self, const char *key, GCancellable *cancellable, ViewerCacheWaitFunc wait, gpointer user_data, GError **error);
+ViewerCache *viewer_cache_new          (gsize capacity);
+void         viewer_cache_release      (ViewerCache *self, const char *key);
+void         viewer_cache_set_capacity (ViewerCache *self, gsize capacity);
+void         viewer_cache_share        (ViewerCache *self, const char *key, ViewerImage *image);
+
+/* Viewer Convert */
+ViewerConvertFunc viewer_convert_get_func (ViewerConvertPath path, int n_channels);
+const char       *viewer_convert_get_name (ViewerConvertPath path);
+void              viewer_convert_halve    (const guchar *source, int source_stride, int source_width, int source_height, guchar *destination, int destination_stride);
+void              viewer_convert_pixels   (const guchar *source, int source_stride, int n_channels, guchar *destination, int destination_stride, int width, int height);
+
+/* Viewer Deep */
+gboolean     viewer_deep_get_range  (ViewerImage *image, float *low, float *high);
+ViewerImage *viewer_deep_new        (GBytes *bytes, gsize offset, ViewerDeepFormat format, int width, int height, gsize stride);
+ViewerImage *viewer_deep_open       (GFile *file);
+ViewerImage *viewer_deep_view       (ViewerImage *image, float black, float white);
+
+/* Viewer Directory */
+void       viewer_directory_list_async  (gpointer source_object, GFile *directory, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data);
+GPtrArray *viewer_directory_list_finish (GAsyncResult *result, GError **error);
+
+/* Viewer Image */
+GdkPixbufAnimation *viewer_image_get_animation (ViewerImage *self);
+int                 viewer_image_get_height    (ViewerImage *self);
+gpointer            viewer_image_get_reader    (ViewerImage *self, ViewerImageReadFunc read);
+gsize               viewer_image_get_size      (ViewerImage *self);
+int                 viewer_image_get_width     (ViewerImage *self);
+ViewerImage        *viewer_image_new           (int width, int height);
+ViewerImage        *viewer_image_new_lazy      (int width, int height, ViewerImageReadFunc read, gpointer data, gsize size, GDestroyNotify destroy);
+ViewerImage        *viewer_image_new_scaled    (int width, int height, int pixel_width, int pixel_height);
+GdkTexture         *viewer_image_render        (ViewerImage *self, double zoom, int width, int height);
+GdkTexture         *viewer_image_resample      (ViewerImage *self, double zoom, int x, int y, int width, int height, GCancellable *cancellable);
+void                viewer_image_set_animation (ViewerImage *self, GdkPixbufAnimation *animation);
+void                viewer_image_set_reader    (ViewerImage *self, ViewerImageReadFunc read, gpointer data, GDestroyNotify destroy);
+void                viewer_image_snapshot      (ViewerImage *self, GtkSnapshot *snapshot, double zoom, double x, double y, int width, int height, gboolean fast);
+void                viewer_image_write         (ViewerImage *self, const guchar *source, int source_stride, int n_channels, int x, int y, int width, int height);
+
+/* Viewer Loader */
+ViewerImage *viewer_create_image_from_file (GFile *file, GCancellable *cancellable, GError **error);
+void         viewer_loader_load_async      (gpointer source_object, GFile *file, ViewerCache *cache, int io_priority, int preview_width, int preview_height, GCancellable *cancellable, ViewerLoaderProgressFunc progress, GAsyncReadyCallback callback, gpointer user_data);
+ViewerImage *viewer_loader_load_finish     (GAsyncResult *result, GError **error);
+
+/* Viewer Mapped */
+ViewerImage *viewer_mapped_open (GFile *file);
+
+/* Viewer Player */
+gboolean      viewer_player_advance     (ViewerPlayer *self, gint64 time);
+void          viewer_player_free        (ViewerPlayer *self);
+GdkTexture   *viewer_player_get_texture (ViewerPlayer *self);
+ViewerPlayer *viewer_player_new         (GdkPixbufAnimation *animation);
+
+/* Viewer Preview */
+ViewerImage *viewer_preview_create (GFile *file, int width, int height, GCancellable *cancellable);
+
+/* Viewer Store */
+ViewerImage *viewer_store_lookup (GFile *file);
+void         viewer_store_save   (GFile *file, ViewerImage *image);
+
+/* Viewer Strip */
+ViewerImage *viewer_strip_open (GFile *file, GCancellable *cancellable);
+
+/* Viewer Trace */
+gint64   viewer_trace_begin       (void);
+void     viewer_trace_count       (const char *name, gint64 value);
+void     viewer_trace_end         (const char *name, gint64 begin, gint64 value);
+gboolean viewer_trace_get_enabled (void);
+void     viewer_trace_init        (void);
+void     viewer_trace_start       (const char *path, gboolean summary);
+void     viewer_trace_stop        (void);
+
+/* Viewer View */
+GtkWidget *viewer_view_new            (void);
+void       viewer_view_set_background (ViewerView *self, const GdkRGBA *color);
+void       viewer_view_set_image      (ViewerView *self, ViewerImage *image);
+void       viewer_view_set_position   (ViewerView *self, double zoom, double x, double y);
+void       viewer_view_update         (ViewerView *self);
 
 /* Viewer Application Window */
 void       viewer_application_window_get_background (ViewerApplicationWindow *self, float *red, float *green, float *blue);
@@ -2,10 +2,14 @@
 #include <gtk/gtk.h>
 #include "viewer.h"
 #define ACTION_NEW              "new"
+#define ACTION_TRACE            "trace"
 #define ATTRIBUTE_ACCEL         "accel"
 #define ATTRIBUTE_ACTION        "action"
+#define CACHE_SIZE_UNIT         (1024 * 1024)
 #define PROPERTY_APPLICATION_ID "application-id"
 #define PROPERTY_FLAGS          "flags"
+#define SETTINGS_CACHE_SIZE     "cache-size"
+#define SIGNAL_CHANGED_CACHE    "changed::cache-size"
 
 typedef struct _ViewerApplicationAccelEntry ViewerApplicationAccelEntry;
 
@@ -13,6 +17,8 @@ typedef struct _ViewerApplicationAccelEntry ViewerApplicationAccelEntry;
 struct _ViewerApplication
 {
 	GtkApplication parent_instance;
+	GSettings     *settings;
+	ViewerCache   *cache;
 };
 
 struct _ViewerApplicationAccelEntry
@@ -23,8 +29,12 @@ struct _ViewerApplicationAccelEntry
 
 static void viewer_application_activate                   (GApplication *self);
 static void viewer_application_activate_new               (GSimpleAction *action, GVariant *parameter, gpointer user_data);
+static void viewer_application_activate_trace             (GSimpleAction *action, GVariant *parameter, gpointer user_data);
+static void viewer_application_change_cache_size          (GSettings *settings, const char *key, gpointer user_data);
 static void viewer_application_class_init                 (ViewerApplicationClass *self);
 static void viewer_application_class_init_application     (GApplicationClass *self);
+static void viewer_application_class_init_object          (GObjectClass *self);
+static void viewer_application_dispose                    (GObject *self);
 static void viewer_application_init                       (ViewerApplication *self);
 static void viewer_application_init_accels                (GtkApplication *self);
 static void viewer_application_open                       (GApplication *self, GFile **files, int n_files, const char *hint);
@@ -37,8 +47,12 @@ static const char *ACCELS_CLOSE        [] = { "<Ctrl>q", NULL };
 static const char *ACCELS_FULLSCREEN   [] = { "F11", NULL };
 static const char *ACCELS_HELP_OVERLAY [] = { "<Ctrl>question", "<Ctrl>slash", NULL };
 static const char *ACCELS_NEW          [] = { "<Ctrl>n", NULL };
+static const char *ACCELS_NEXT         [] = { "Page_Down", "Right", NULL };
 static const char *ACCELS_OPEN         [] = { "<Ctrl>o", NULL };
+static const char *ACCELS_PREVIOUS     [] = { "Page_Up", "Left", NULL };
 static const char *ACCELS_RESTORE_ZOOM [] = { "<Ctrl>0", NULL };
+static const char *ACCELS_STRETCH      [] = { "<Ctrl>l", NULL };
+static const char *ACCELS_TRACE        [] = { "<Ctrl><Shift>F12", NULL };
 static const char *ACCELS_ZOOM_IN      [] = { "<Ctrl>plus", "<Ctrl>semicolon", NULL };
 static const char *ACCELS_ZOOM_OUT     [] = { "<Ctrl>minus", NULL };
 
@@ -51,8 +65,12 @@ ACCEL_ENTRIES [] =
 	{ "win.fullscreen",        ACCELS_FULLSCREEN   },
 	{ "win.show-help-overlay", ACCELS_HELP_OVERLAY },
 	{ "app.new",               ACCELS_NEW          },
+	{ "win.next",              ACCELS_NEXT         },
 	{ "win.open",              ACCELS_OPEN         },
+	{ "win.previous",          ACCELS_PREVIOUS     },
 	{ "win.restore-zoom",      ACCELS_RESTORE_ZOOM },
+	{ "win.stretch",           ACCELS_STRETCH      },
+	{ "app.trace",             ACCELS_TRACE        },
 	{ "win.zoom-in",           ACCELS_ZOOM_IN      },
 	{ "win.zoom-out",          ACCELS_ZOOM_OUT     },
 };
@@ -61,7 +79,8 @@ ACCEL_ENTRIES [] =
 static const GActionEntry
 ACTION_ENTRIES [] =
 {
-	{ ACTION_NEW, viewer_application_activate_new, NULL, NULL, NULL },
+	{ ACTION_NEW,   viewer_application_activate_new,   NULL, NULL, NULL },
+	{ ACTION_TRACE, viewer_application_activate_trace, NULL, NULL, NULL },
 };
 
 /*******************************************************************************
@@ -86,6 +105,34 @@ viewer_application_activate_new (GSimpleAction *action, GVariant *parameter, gpo
 	gtk_window_present (GTK_WINDOW (window));
 }
 
+/*******************************************************************************
+計測を開始または終了します。メニューには表示しません。
+開始すると集計を標準エラーへ定期的に出力し、終了すると記録を一時ファイルへ書き込みます。
+*/
+static void
+viewer_application_activate_trace (GSimpleAction *action, GVariant *parameter, gpointer user_data)
+{
+	if (viewer_trace_get_enabled ())
+	{
+		viewer_trace_stop ();
+	}
+	else
+	{
+		viewer_trace_start (NULL, TRUE);
+	}
+}
+
+/*******************************************************************************
+キャッシュの容量を変更します。
+*/
+static void
+viewer_application_change_cache_size (GSettings *settings, const char *key, gpointer user_data)
+{
+	ViewerApplication *self;
+	self = VIEWER_APPLICATION (user_data);
+	viewer_cache_set_capacity (self->cache, (gsize) g_settings_get_int (settings, key) * CACHE_SIZE_UNIT);
+}
+
 /*******************************************************************************
 クラスを初期化します。
 */
@@ -93,6 +140,7 @@ static void
 viewer_application_class_init (ViewerApplicationClass *self)
 {
 	viewer_application_class_init_application (G_APPLICATION_CLASS (self));
+	viewer_application_class_init_object (G_OBJECT_CLASS (self));
 }
 
 /*******************************************************************************
@@ -106,6 +154,37 @@ viewer_application_class_init_application (GApplicationClass *self)
 	self->startup = viewer_application_startup;
 }
 
+/*******************************************************************************
+Object クラスを初期化します。
+*/
+static void
+viewer_application_class_init_object (GObjectClass *self)
+{
+	self->dispose = viewer_application_dispose;
+}
+
+/*******************************************************************************
+クラスのインスタンスを破棄します。
+*/
+static void
+viewer_application_dispose (GObject *self)
+{
+	ViewerApplication *properties;
+	properties = VIEWER_APPLICATION (self);
+	g_clear_object (&properties->settings);
+	g_clear_object (&properties->cache);
+	G_OBJECT_CLASS (viewer_application_parent_class)->dispose (self);
+}
+
+/*******************************************************************************
+画像のキャッシュを取得します。
+*/
+ViewerCache *
+viewer_application_get_cache (ViewerApplication *self)
+{
+	return self->cache;
+}
+
 /*******************************************************************************
 クラスのインスタンスを初期化します。
 */
@@ -145,6 +224,7 @@ viewer_application_new (const char *application_id, GApplicationFlags flags)
 
 /*******************************************************************************
 指定したファイルを開きます。
+ファイルごとにウィンドウをすぐに表示し、画像はスレッド プールで並行して読み込みます。
 */
 static void
 viewer_application_open (GApplication *self, GFile **files, int n_files, const char *hint)
@@ -155,6 +235,7 @@ viewer_application_open (GApplication *self, GFile **files, int n_files, const c
 	for (n = 0; n < n_files; n++)
 	{
 		window = viewer_application_window_new (self);
+		viewer_application_window_set_file (VIEWER_APPLICATION_WINDOW (window), files [n]);
 		gtk_window_present (GTK_WINDOW (window));
 	}
 }
@@ -165,7 +246,12 @@ viewer_application_open (GApplication *self, GFile **files, int n_files, const c
 static void
 viewer_application_startup (GApplication *self)
 {
+	ViewerApplication *properties;
+	properties = VIEWER_APPLICATION (self);
 	G_APPLICATION_CLASS (viewer_application_parent_class)->startup (self);
+	properties->settings = viewer_get_settings ();
+	properties->cache = viewer_cache_new ((gsize) g_settings_get_int (properties->settings, SETTINGS_CACHE_SIZE) * CACHE_SIZE_UNIT);
+	g_signal_connect (properties->settings, SIGNAL_CHANGED_CACHE, G_CALLBACK (viewer_application_change_cache_size), self);
 	g_action_map_add_action_entries (G_ACTION_MAP (self), ACTION_ENTRIES, G_N_ELEMENTS (ACTION_ENTRIES), self);
 	viewer_application_init_accels (GTK_APPLICATION (self));
 }
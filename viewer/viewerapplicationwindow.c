@@ -5,12 +5,16 @@
 #define ACTION_ABOUT          "show-about"
 #define ACTION_BACKGROUND     "background"
 #define ACTION_FULLSCREEN     "fullscreen"
+#define ACTION_NEXT           "next"
 #define ACTION_OPEN           "open"
+#define ACTION_PREVIOUS       "previous"
 #define ACTION_RESTORE_ZOOM   "restore-zoom"
+#define ACTION_STRETCH        "stretch"
 #define ACTION_ZOOM_IN        "zoom-in"
 #define ACTION_ZOOM_OUT       "zoom-out"
 #define FORMAT_TITLE          "%s - %s"
 #define FORMAT_ZOOM_TITLE     "%.0f%% %s - %s"
+#define PREFETCH_SIZE_UNIT    (1024 * 1024)
 #define PROPERTY_APPLICATION  "application"
 #define PROPERTY_SHOW_MENUBAR "show-menubar"
 #define RESOURCE_ABOUT        "gtk/about.ui"
@@ -19,6 +23,8 @@
 #define SETTINGS_FULLSCREEN   "window-fullscreen"
 #define SETTINGS_HEIGHT       "window-height"
 #define SETTINGS_MAXIMIZED    "window-maximized"
+#define SETTINGS_PREFETCH     "prefetch-count"
+#define SETTINGS_PREFETCH_CAP "prefetch-size"
 #define SETTINGS_WIDTH        "window-width"
 #define SIGNAL_BEGIN          "begin"
 #define SIGNAL_DESTROY        "destroy"
@@ -52,12 +58,17 @@ struct _ViewerApplicationWindow
 {
 	GtkApplicationWindow parent_instance;
 	char                *name;
-	cairo_pattern_t     *pattern;
-	cairo_surface_t     *surface;
+	GCancellable        *cancellable;
+	GCancellable        *listing;
+	GFile               *directory;
 	GFile               *file;
+	GHashTable          *prefetches;
+	GPtrArray           *files;
 	GtkAdjustment       *hadjustment;
 	GtkAdjustment       *vadjustment;
 	GtkWidget           *area;
+	ViewerImage         *display;
+	ViewerImage         *image;
 	float                background_red;
 	float                background_green;
 	float                background_blue;
@@ -65,10 +76,14 @@ struct _ViewerApplicationWindow
 	float                scroll_y;
 	float                zoom;
 	float                zoom_origin;
+	gsize                prefetch_capacity;
+	gsize                prefetch_size;
+	int                  prefetch_count;
+	int                  index;
 	int                  area_width;
 	int                  area_height;
-	int                  surface_width;
-	int                  surface_height;
+	int                  image_width;
+	int                  image_height;
 	int                  width;
 	int                  height;
 	unsigned char        fullscreen;
@@ -78,14 +93,19 @@ struct _ViewerApplicationWindow
 static void     viewer_application_window_activate_about        (GSimpleAction *action, GVariant *parameter, gpointer user_data);
 static void     viewer_application_window_activate_background   (GSimpleAction *action, GVariant *parameter, gpointer user_data);
 static void     viewer_application_window_activate_fullscreen   (GSimpleAction *action, GVariant *parameter, gpointer user_data);
+static void     viewer_application_window_activate_next         (GSimpleAction *action, GVariant *parameter, gpointer user_data);
 static void     viewer_application_window_activate_open         (GSimpleAction *action, GVariant *parameter, gpointer user_data);
+static void     viewer_application_window_activate_previous     (GSimpleAction *action, GVariant *parameter, gpointer user_data);
 static void     viewer_application_window_activate_restore_zoom (GSimpleAction *action, GVariant *parameter, gpointer user_data);
 static void     viewer_application_window_activate_zoom_in      (GSimpleAction *action, GVariant *parameter, gpointer user_data);
 static void     viewer_application_window_activate_zoom_out     (GSimpleAction *action, GVariant *parameter, gpointer user_data);
 static void     viewer_application_window_apply_settings        (ViewerApplicationWindow *self);
+static void     viewer_application_window_apply_window          (ViewerApplicationWindow *self);
 static void     viewer_application_window_begin_drag            (GtkGestureDrag *gesture, gdouble x, gdouble y, gpointer user_data);
 static void     viewer_application_window_begin_zoom            (GtkGesture *gesture, GdkEventSequence *sequence, gpointer user_data);
+static void     viewer_application_window_cancel_prefetches     (ViewerApplicationWindow *self, GHashTable *keep);
 static void     viewer_application_window_change_adjustment     (GtkAdjustment *adjustment, gpointer user_data);
+static void     viewer_application_window_change_stretch        (GSimpleAction *action, GVariant *value, gpointer user_data);
 static void     viewer_application_window_change_zoom           (GtkGestureZoom *gesture, gdouble delta, gpointer user_data);
 static void     viewer_application_window_class_init            (ViewerApplicationWindowClass *this_class);
 static void     viewer_application_window_class_init_object     (GObjectClass *this_class);
@@ -94,29 +114,39 @@ static void     viewer_application_window_construct             (GObject *self);
 static void     viewer_application_window_destroy               (ViewerApplicationWindow *self);
 static void     viewer_application_window_dispose               (GObject *self);
 static void     viewer_application_window_drag                  (GtkGestureDrag *gesture, gdouble x, gdouble y, gpointer user_data);
-static void     viewer_application_window_draw                  (GtkDrawingArea *area, cairo_t *cairo, int width, int height, gpointer user_data);
 static void     viewer_application_window_end_drag              (GtkGestureDrag *gesture, gdouble x, gdouble y, gpointer user_data);
 static void     viewer_application_window_end_zoom              (GtkGesture *gesture, GdkEventSequence *sequence, gpointer user_data);
 static gboolean viewer_application_window_get_background_equal  (ViewerApplicationWindow *self, float red, float green, float blue);
 static void     viewer_application_window_get_property          (GObject *self, guint property_id, GValue *value, GParamSpec *pspec);
+static void     viewer_application_window_go                    (ViewerApplicationWindow *self, int offset);
 static void     viewer_application_window_init                  (ViewerApplicationWindow *self);
 static void     viewer_application_window_init_controllers      (ViewerApplicationWindow *self);
 static void     viewer_application_window_init_gestures         (ViewerApplicationWindow *self);
 static void     viewer_application_window_load_settings         (ViewerApplicationWindow *self);
+static void     viewer_application_window_prefetch              (ViewerApplicationWindow *self);
+static void     viewer_application_window_progress_load         (gpointer self, ViewerImage *image, gpointer user_data);
 static void     viewer_application_window_realize               (GtkWidget *self);
 static void     viewer_application_window_resize                (GtkWidget *self, int width, int height, int baseline);
-static void     viewer_application_window_resize_area           (GtkDrawingArea *area, int width, int height, gpointer user_data);
+static void     viewer_application_window_resize_area           (GtkWidget *area, int width, int height, gpointer user_data);
 static void     viewer_application_window_respond_background    (GObject *dialog, GAsyncResult *result, gpointer user_data);
+static void     viewer_application_window_respond_directory     (GObject *self, GAsyncResult *result, gpointer user_data);
+static void     viewer_application_window_respond_load          (GObject *self, GAsyncResult *result, gpointer user_data);
 static void     viewer_application_window_respond_open          (GObject *dialog, GAsyncResult *result, gpointer user_data);
+static void     viewer_application_window_respond_prefetch      (GObject *self, GAsyncResult *result, gpointer user_data);
 static void     viewer_application_window_save_settings         (ViewerApplicationWindow *self);
 static void     viewer_application_window_scroll                (GtkEventControllerScroll *controller, gdouble dx, gdouble dy, gpointer user_data);
 static void     viewer_application_window_set_property          (GObject *self, guint property_id, const GValue *value, GParamSpec *pspec);
+static void     viewer_application_window_show_image            (ViewerApplicationWindow *self, ViewerImage *image);
 static void     viewer_application_window_unrealize             (GtkWidget *self);
+static void     viewer_application_window_update_actions        (ViewerApplicationWindow *self);
+static void     viewer_application_window_update_directory      (ViewerApplicationWindow *self);
+static void     viewer_application_window_update_index          (ViewerApplicationWindow *self);
 static void     viewer_application_window_update_name           (ViewerApplicationWindow *self);
 static void     viewer_application_window_update_range          (ViewerApplicationWindow *self);
 static void     viewer_application_window_update_size           (ViewerApplicationWindow *self);
 static void     viewer_application_window_update_surface        (GObject *object, GParamSpec *pspec, gpointer user_data);
 static void     viewer_application_window_update_title          (ViewerApplicationWindow *self);
+static void     viewer_application_window_update_view           (ViewerApplicationWindow *self);
 
 /* Viewer Application Window クラス */
 G_DEFINE_TYPE (ViewerApplicationWindow, viewer_application_window, GTK_TYPE_APPLICATION_WINDOW);
@@ -170,8 +200,11 @@ static const GActionEntry ACTION_ENTRIES [] =
 	{ ACTION_ABOUT,        viewer_application_window_activate_about,        NULL, NULL, NULL },
 	{ ACTION_BACKGROUND,   viewer_application_window_activate_background,   NULL, NULL, NULL },
 	{ ACTION_FULLSCREEN,   viewer_application_window_activate_fullscreen,   NULL, NULL, NULL },
+	{ ACTION_NEXT,         viewer_application_window_activate_next,         NULL, NULL, NULL },
 	{ ACTION_OPEN,         viewer_application_window_activate_open,         NULL, NULL, NULL },
+	{ ACTION_PREVIOUS,     viewer_application_window_activate_previous,     NULL, NULL, NULL },
 	{ ACTION_RESTORE_ZOOM, viewer_application_window_activate_restore_zoom, NULL, NULL, NULL },
+	{ ACTION_STRETCH,      NULL,                                            NULL, "true", viewer_application_window_change_stretch },
 	{ ACTION_ZOOM_IN,      viewer_application_window_activate_zoom_in,      NULL, NULL, NULL },
 	{ ACTION_ZOOM_OUT,     viewer_application_window_activate_zoom_out,     NULL, NULL, NULL },
 };
@@ -234,6 +267,15 @@ viewer_application_window_activate_fullscreen (GSimpleAction *action, GVariant *
 	}
 }
 
+/*******************************************************************************
+同じディレクトリにある次の画像を開きます。
+*/
+static void
+viewer_application_window_activate_next (GSimpleAction *action, GVariant *parameter, gpointer user_data)
+{
+	viewer_application_window_go (VIEWER_APPLICATION_WINDOW (user_data), 1);
+}
+
 /*******************************************************************************
 ファイルを開きます。
 */
@@ -248,6 +290,15 @@ viewer_application_window_activate_open (GSimpleAction *action, GVariant *parame
 	g_object_unref               (dialog);
 }
 
+/*******************************************************************************
+同じディレクトリにある前の画像を開きます。
+*/
+static void
+viewer_application_window_activate_previous (GSimpleAction *action, GVariant *parameter, gpointer user_data)
+{
+	viewer_application_window_go (VIEWER_APPLICATION_WINDOW (user_data), -1);
+}
+
 /*******************************************************************************
 既定の拡大率に戻します。
 */
@@ -299,6 +350,39 @@ viewer_application_window_apply_settings (ViewerApplicationWindow *self)
 	}
 }
 
+/*******************************************************************************
+8 ビットを超える精度の画像の表示範囲を適用し、表示する画像を決めます。
+コントラストを強調する場合は値の大部分が収まる範囲を、それ以外の場合は値の全範囲を表示します。
+キャッシュの画像は他のウィンドウと共有しているので、表示範囲はこのウィンドウで表示する画像にだけ適用します。
+*/
+static void
+viewer_application_window_apply_window (ViewerApplicationWindow *self)
+{
+	GVariant *state;
+	float low, high;
+	g_clear_object (&self->display);
+
+	if (self->image && viewer_deep_get_range (self->image, &low, &high))
+	{
+		state = g_action_get_state (g_action_map_lookup_action (G_ACTION_MAP (self), ACTION_STRETCH));
+
+		if (g_variant_get_boolean (state))
+		{
+			self->display = viewer_deep_view (self->image, low, high);
+		}
+		else
+		{
+			self->display = viewer_deep_view (self->image, 0.0F, 1.0F);
+		}
+
+		g_variant_unref (state);
+	}
+	else if (self->image)
+	{
+		self->display = g_object_ref (self->image);
+	}
+}
+
 /*******************************************************************************
 画像スクロールを開始します。
 */
@@ -322,6 +406,26 @@ viewer_application_window_begin_zoom (GtkGesture *gesture, GdkEventSequence *seq
 	self->zoom_origin = self->zoom;
 }
 
+/*******************************************************************************
+先読みを取り消します。keep に含まれるファイルの先読みは続けます。
+*/
+static void
+viewer_application_window_cancel_prefetches (ViewerApplicationWindow *self, GHashTable *keep)
+{
+	GHashTableIter iter;
+	gpointer file, cancellable;
+	g_hash_table_iter_init (&iter, self->prefetches);
+
+	while (g_hash_table_iter_next (&iter, &file, &cancellable))
+	{
+		if (!keep || !g_hash_table_contains (keep, file))
+		{
+			g_cancellable_cancel (cancellable);
+			g_hash_table_iter_remove (&iter);
+		}
+	}
+}
+
 /*******************************************************************************
 スクロール位置を変更します。
 */
@@ -330,7 +434,20 @@ viewer_application_window_change_adjustment (GtkAdjustment *adjustment, gpointer
 {
 	ViewerApplicationWindow *self;
 	self = VIEWER_APPLICATION_WINDOW (user_data);
-	gtk_widget_queue_draw (self->area);
+	viewer_application_window_update_view (self);
+}
+
+/*******************************************************************************
+コントラストを強調するかを切り替えます。
+*/
+static void
+viewer_application_window_change_stretch (GSimpleAction *action, GVariant *value, gpointer user_data)
+{
+	ViewerApplicationWindow *self;
+	self = VIEWER_APPLICATION_WINDOW (user_data);
+	g_simple_action_set_state (action, value);
+	viewer_application_window_apply_window (self);
+	viewer_application_window_update_view (self);
 }
 
 /*******************************************************************************
@@ -380,6 +497,7 @@ static void
 viewer_application_window_class_init_widget (GtkWidgetClass *this_class)
 {
 	char path [VIEWER_RESOURCE_PATH_CCH];
+	g_type_ensure (VIEWER_TYPE_VIEW);
 	this_class->realize       = viewer_application_window_realize;
 	this_class->size_allocate = viewer_application_window_resize;
 	this_class->unrealize     = viewer_application_window_unrealize;
@@ -409,8 +527,26 @@ viewer_application_window_construct (GObject *self)
 static void
 viewer_application_window_destroy (ViewerApplicationWindow *self)
 {
-	g_clear_pointer (&self->pattern, cairo_pattern_destroy);
-	g_clear_pointer (&self->surface, cairo_surface_destroy);
+	if (self->cancellable)
+	{
+		g_cancellable_cancel (self->cancellable);
+		g_clear_object (&self->cancellable);
+	}
+	if (self->listing)
+	{
+		g_cancellable_cancel (self->listing);
+		g_clear_object (&self->listing);
+	}
+	if (self->prefetches)
+	{
+		viewer_application_window_cancel_prefetches (self, NULL);
+		g_clear_pointer (&self->prefetches, g_hash_table_unref);
+	}
+
+	g_clear_pointer (&self->files, g_ptr_array_unref);
+	g_clear_object (&self->directory);
+	g_clear_object (&self->display);
+	g_clear_object (&self->image);
 	g_clear_pointer (&self->name, g_free);
 	g_clear_object (&self->file);
 }
@@ -439,40 +575,6 @@ viewer_application_window_drag (GtkGestureDrag *gesture, gdouble x, gdouble y, g
 	gtk_adjustment_set_value (self->vadjustment, self->scroll_y - y);
 }
 
-/*******************************************************************************
-ウィンドウ領域を描画します。
-*/
-static void
-viewer_application_window_draw (GtkDrawingArea *area, cairo_t *cairo, int width, int height, gpointer user_data)
-{
-	ViewerApplicationWindow *self;
-	double zoom;
-	self = VIEWER_APPLICATION_WINDOW (user_data);
-
-	if (!self->pattern)
-	{
-		self->pattern = cairo_pattern_create_rgb (self->background_red, self->background_green, self->background_blue);
-	}
-	if (!self->surface && self->file)
-	{
-		self->surface = viewer_create_surface_from_file (cairo, self->file, &self->surface_width, &self->surface_height, NULL);
-		g_idle_add_once ((GSourceOnceFunc) viewer_application_window_update_range, self);
-	}
-	if (self->pattern)
-	{
-		cairo_set_source (cairo, self->pattern);
-		cairo_paint (cairo);
-	}
-	if (self->surface)
-	{
-		zoom = self->zoom;
-		cairo_translate (cairo, -gtk_adjustment_get_value (self->hadjustment), -gtk_adjustment_get_value (self->vadjustment));
-		cairo_scale (cairo, zoom, zoom);
-		cairo_set_source_surface (cairo, self->surface, 0, 0);
-		cairo_paint (cairo);
-	}
-}
-
 /*******************************************************************************
 画像スクロールを終了します。
 */
@@ -580,6 +682,25 @@ viewer_application_window_get_zoom (ViewerApplicationWindow *self)
 	return self->zoom;
 }
 
+/*******************************************************************************
+同じディレクトリにある画像の間を移動します。
+*/
+static void
+viewer_application_window_go (ViewerApplicationWindow *self, int offset)
+{
+	int index;
+
+	if (self->files)
+	{
+		index = self->index + offset;
+
+		if ((index >= 0) && (index < (int) self->files->len))
+		{
+			viewer_application_window_set_file (self, g_ptr_array_index (self->files, index));
+		}
+	}
+}
+
 /*******************************************************************************
 クラスのインスタンスを初期化します。
 */
@@ -588,14 +709,17 @@ viewer_application_window_init (ViewerApplicationWindow *self)
 {
 	g_action_map_add_action_entries (G_ACTION_MAP (self), ACTION_ENTRIES, G_N_ELEMENTS (ACTION_ENTRIES), self);
 	gtk_widget_init_template        (GTK_WIDGET (self));
-	gtk_drawing_area_set_draw_func  (GTK_DRAWING_AREA (self->area), viewer_application_window_draw, self, NULL);
 	self->background_blue  = BACKGROUND_BLUE_PROPERTY_DEFAULT_VALUE;
 	self->background_green = BACKGROUND_GREEN_PROPERTY_DEFAULT_VALUE;
 	self->background_red   = BACKGROUND_RED_PROPERTY_DEFAULT_VALUE;
 	self->zoom             = ZOOM_PROPERTY_DEFAULT_VALUE;
+	self->prefetches       = g_hash_table_new_full (g_file_hash, (GEqualFunc) g_file_equal, g_object_unref, g_object_unref);
+	self->index            = -1;
 	viewer_application_window_init_controllers (self);
 	viewer_application_window_init_gestures (self);
+	viewer_application_window_update_actions (self);
 	viewer_application_window_update_title (self);
+	viewer_application_window_update_view (self);
 }
 
 /*******************************************************************************
@@ -636,11 +760,13 @@ static void
 viewer_application_window_load_settings (ViewerApplicationWindow *self)
 {
 	GSettings *settings;
-	settings         = viewer_get_settings    ();
-	self->width      = g_settings_get_int     (settings, SETTINGS_WIDTH);
-	self->height     = g_settings_get_int     (settings, SETTINGS_HEIGHT);
-	self->fullscreen = g_settings_get_boolean (settings, SETTINGS_FULLSCREEN);
-	self->maximized  = g_settings_get_boolean (settings, SETTINGS_MAXIMIZED);
+	settings                = viewer_get_settings    ();
+	self->width             = g_settings_get_int     (settings, SETTINGS_WIDTH);
+	self->height            = g_settings_get_int     (settings, SETTINGS_HEIGHT);
+	self->fullscreen        = g_settings_get_boolean (settings, SETTINGS_FULLSCREEN);
+	self->maximized         = g_settings_get_boolean (settings, SETTINGS_MAXIMIZED);
+	self->prefetch_count    = g_settings_get_int     (settings, SETTINGS_PREFETCH);
+	self->prefetch_capacity = g_settings_get_int     (settings, SETTINGS_PREFETCH_CAP) * (gsize) PREFETCH_SIZE_UNIT;
 	g_object_unref (settings);
 }
 
@@ -656,6 +782,72 @@ viewer_application_window_new (GApplication *application)
 		NULL);
 }
 
+/*******************************************************************************
+前後の画像をキャッシュへ先読みします。
+近い画像から順に要求し、範囲外になった先読みは取り消します。
+*/
+static void
+viewer_application_window_prefetch (ViewerApplicationWindow *self)
+{
+	GtkApplication *application;
+	GCancellable *cancellable;
+	GHashTable *keep;
+	ViewerCache *cache;
+	GFile *file;
+	int distance, index, length, sign;
+	application = gtk_window_get_application (GTK_WINDOW (self));
+	cache = application ? viewer_application_get_cache (VIEWER_APPLICATION (application)) : NULL;
+	length = (cache && self->files && self->prefetch_capacity) ? (int) self->files->len : 0;
+	keep = g_hash_table_new (g_file_hash, (GEqualFunc) g_file_equal);
+
+	for (distance = 0; (self->index >= 0) && (distance <= self->prefetch_count); distance++)
+	{
+		for (sign = 1; sign >= -1; sign -= 2)
+		{
+			index = self->index + sign * distance;
+
+			if ((index >= 0) && (index < length))
+			{
+				g_hash_table_add (keep, g_ptr_array_index (self->files, index));
+			}
+		}
+	}
+
+	viewer_application_window_cancel_prefetches (self, keep);
+	self->prefetch_size = 0;
+
+	for (distance = 1; (self->index >= 0) && (distance <= self->prefetch_count); distance++)
+	{
+		for (sign = 1; sign >= -1; sign -= 2)
+		{
+			index = self->index + sign * distance;
+
+			if ((index >= 0) && (index < length))
+			{
+				file = g_ptr_array_index (self->files, index);
+
+				if (!g_hash_table_contains (self->prefetches, file))
+				{
+					cancellable = g_cancellable_new ();
+					g_hash_table_insert (self->prefetches, g_object_ref (file), cancellable);
+					viewer_loader_load_async (self, file, cache, G_PRIORITY_LOW, 0, 0, cancellable, NULL, viewer_application_window_respond_prefetch, g_object_ref (file));
+				}
+			}
+		}
+	}
+
+	g_hash_table_unref (keep);
+}
+
+/*******************************************************************************
+読み込み中の画像のうち、展開した部分を表示します。
+*/
+static void
+viewer_application_window_progress_load (gpointer self, ViewerImage *image, gpointer user_data)
+{
+	viewer_application_window_show_image (VIEWER_APPLICATION_WINDOW (self), image);
+}
+
 /*******************************************************************************
 ウィンドウを表示します。
 */
@@ -680,7 +872,7 @@ viewer_application_window_resize (GtkWidget *self, int width, int height, int ba
 描画領域の大きさを変更します。
 */
 static void
-viewer_application_window_resize_area (GtkDrawingArea *area, int width, int height, gpointer user_data)
+viewer_application_window_resize_area (GtkWidget *area, int width, int height, gpointer user_data)
 {
 	ViewerApplicationWindow *self;
 	self = VIEWER_APPLICATION_WINDOW (user_data);
@@ -705,6 +897,42 @@ viewer_application_window_respond_background (GObject *dialog, GAsyncResult *res
 	}
 }
 
+/*******************************************************************************
+ディレクトリにある画像の一覧を受け取ります。
+*/
+static void
+viewer_application_window_respond_directory (GObject *self, GAsyncResult *result, gpointer user_data)
+{
+	ViewerApplicationWindow *properties;
+	GPtrArray *files;
+	files = viewer_directory_list_finish (result, NULL);
+
+	if (files)
+	{
+		properties = VIEWER_APPLICATION_WINDOW (self);
+		g_clear_object (&properties->listing);
+		g_clear_pointer (&properties->files, g_ptr_array_unref);
+		properties->files = files;
+		viewer_application_window_update_index (properties);
+	}
+}
+
+/*******************************************************************************
+読み込んだ画像を表示します。
+*/
+static void
+viewer_application_window_respond_load (GObject *self, GAsyncResult *result, gpointer user_data)
+{
+	ViewerImage *image;
+	image = viewer_loader_load_finish (result, NULL);
+
+	if (image)
+	{
+		viewer_application_window_show_image (VIEWER_APPLICATION_WINDOW (self), image);
+		g_object_unref (image);
+	}
+}
+
 /*******************************************************************************
 ファイルを開きます。
 */
@@ -721,6 +949,39 @@ viewer_application_window_respond_open (GObject *dialog, GAsyncResult *result, g
 	}
 }
 
+/*******************************************************************************
+先読みの完了を受け取ります。user_data は先読みしたファイルです。
+先読みした画像の合計が上限に達すると、残りの先読みを取り消します。
+*/
+static void
+viewer_application_window_respond_prefetch (GObject *self, GAsyncResult *result, gpointer user_data)
+{
+	ViewerApplicationWindow *properties;
+	ViewerImage *image;
+	GCancellable *cancellable;
+	cancellable = g_task_get_cancellable (G_TASK (result));
+	image = viewer_loader_load_finish (result, NULL);
+
+	if (!g_cancellable_is_cancelled (cancellable))
+	{
+		properties = VIEWER_APPLICATION_WINDOW (self);
+		g_hash_table_remove (properties->prefetches, user_data);
+
+		if (image)
+		{
+			properties->prefetch_size += viewer_image_get_size (image);
+
+			if (properties->prefetch_size >= properties->prefetch_capacity)
+			{
+				viewer_application_window_cancel_prefetches (properties, NULL);
+			}
+		}
+	}
+
+	g_clear_object (&image);
+	g_object_unref (user_data);
+}
+
 /*******************************************************************************
 環境設定を保存します。
 */
@@ -759,8 +1020,7 @@ viewer_application_window_set_background (ViewerApplicationWindow *self, float r
 		self->background_red = red;
 		self->background_green = green;
 		self->background_blue = blue;
-		g_clear_pointer (&self->pattern, cairo_pattern_destroy);
-		gtk_widget_queue_draw (self->area);
+		viewer_application_window_update_view (self);
 	}
 }
 
@@ -770,6 +1030,10 @@ viewer_application_window_set_background (ViewerApplicationWindow *self, float r
 void
 viewer_application_window_set_file (ViewerApplicationWindow *self, GFile *file)
 {
+	GtkApplication *application;
+	ViewerCache *cache;
+	int scale, width, height;
+
 	if (self->file != file)
 	{
 		if (self->file)
@@ -785,8 +1049,29 @@ viewer_application_window_set_file (ViewerApplicationWindow *self, GFile *file)
 			self->file = NULL;
 		}
 
-		g_clear_pointer (&self->surface, cairo_surface_destroy);
-		gtk_widget_queue_draw (self->area);
+		if (self->cancellable)
+		{
+			g_cancellable_cancel (self->cancellable);
+			g_clear_object (&self->cancellable);
+		}
+		if (self->file)
+		{
+			application = gtk_window_get_application (GTK_WINDOW (self));
+			cache = application ? viewer_application_get_cache (VIEWER_APPLICATION (application)) : NULL;
+			scale = gtk_widget_get_scale_factor (self->area);
+			width = scale * (self->area_width ? self->area_width : self->width);
+			height = scale * (self->area_height ? self->area_height : self->height);
+			self->cancellable = g_cancellable_new ();
+			viewer_loader_load_async (self, self->file, cache, G_PRIORITY_DEFAULT, width, height, self->cancellable, viewer_application_window_progress_load, viewer_application_window_respond_load, NULL);
+		}
+
+		g_clear_object (&self->display);
+		g_clear_object (&self->image);
+		self->image_width = 0;
+		self->image_height = 0;
+		viewer_application_window_update_range (self);
+		viewer_application_window_update_view (self);
+		viewer_application_window_update_directory (self);
 		viewer_application_window_update_name (self);
 		viewer_application_window_update_title (self);
 	}
@@ -833,12 +1118,34 @@ viewer_application_window_set_zoom (ViewerApplicationWindow *self, float zoom)
 	if (self->zoom != zoom)
 	{
 		self->zoom = zoom;
-		gtk_widget_queue_draw (self->area);
 		viewer_application_window_update_range (VIEWER_APPLICATION_WINDOW (self));
+		viewer_application_window_update_view (self);
 		viewer_application_window_update_title (self);
 	}
 }
 
+/*******************************************************************************
+画像を表示します。読み込み中の画像は展開するたびに描画し直します。
+*/
+static void
+viewer_application_window_show_image (ViewerApplicationWindow *self, ViewerImage *image)
+{
+	if (self->image != image)
+	{
+		g_clear_object (&self->image);
+		self->image = g_object_ref (image);
+		self->image_width = viewer_image_get_width (image);
+		self->image_height = viewer_image_get_height (image);
+		viewer_application_window_apply_window (self);
+		viewer_application_window_update_range (self);
+		viewer_application_window_update_view (self);
+	}
+	else
+	{
+		viewer_view_update (VIEWER_VIEW (self->area));
+	}
+}
+
 /*******************************************************************************
 ウィンドウを隠蔽します。
 */
@@ -849,6 +1156,81 @@ viewer_application_window_unrealize (GtkWidget *self)
 	GTK_WIDGET_CLASS (viewer_application_window_parent_class)->unrealize (self);
 }
 
+/*******************************************************************************
+前後の画像へ移動するアクションの状態を更新します。
+*/
+static void
+viewer_application_window_update_actions (ViewerApplicationWindow *self)
+{
+	GAction *action;
+	int length;
+	length = self->files ? (int) self->files->len : 0;
+	action = g_action_map_lookup_action (G_ACTION_MAP (self), ACTION_NEXT);
+	g_simple_action_set_enabled (G_SIMPLE_ACTION (action), self->index + 1 < length);
+	action = g_action_map_lookup_action (G_ACTION_MAP (self), ACTION_PREVIOUS);
+	g_simple_action_set_enabled (G_SIMPLE_ACTION (action), self->index > 0);
+}
+
+/*******************************************************************************
+開いたファイルのディレクトリを更新します。
+ディレクトリが変わった場合は画像の一覧を非同期に取得し直します。
+*/
+static void
+viewer_application_window_update_directory (ViewerApplicationWindow *self)
+{
+	GFile *directory;
+	directory = self->file ? g_file_get_parent (self->file) : NULL;
+
+	if (directory && self->directory && g_file_equal (directory, self->directory))
+	{
+		g_object_unref (directory);
+	}
+	else
+	{
+		if (self->listing)
+		{
+			g_cancellable_cancel (self->listing);
+			g_clear_object (&self->listing);
+		}
+		if (directory)
+		{
+			self->listing = g_cancellable_new ();
+			viewer_directory_list_async (self, directory, self->listing, viewer_application_window_respond_directory, NULL);
+		}
+
+		g_clear_pointer (&self->files, g_ptr_array_unref);
+		g_clear_object (&self->directory);
+		self->directory = directory;
+	}
+
+	viewer_application_window_update_index (self);
+}
+
+/*******************************************************************************
+一覧の中で開いたファイルの位置を更新し、その前後を先読みします。
+*/
+static void
+viewer_application_window_update_index (ViewerApplicationWindow *self)
+{
+	guint n;
+	self->index = -1;
+
+	if (self->files && self->file)
+	{
+		for (n = 0; n < self->files->len; n++)
+		{
+			if (g_file_equal (g_ptr_array_index (self->files, n), self->file))
+			{
+				self->index = (int) n;
+				break;
+			}
+		}
+	}
+
+	viewer_application_window_update_actions (self);
+	viewer_application_window_prefetch (self);
+}
+
 /*******************************************************************************
 開いたファイルの名前を更新します。
 */
@@ -875,8 +1257,8 @@ viewer_application_window_update_name (ViewerApplicationWindow *self)
 static void
 viewer_application_window_update_range (ViewerApplicationWindow *self)
 {
-	gtk_adjustment_set_upper     (self->hadjustment, self->zoom * self->surface_width);
-	gtk_adjustment_set_upper     (self->vadjustment, self->zoom * self->surface_height);
+	gtk_adjustment_set_upper     (self->hadjustment, self->zoom * self->image_width);
+	gtk_adjustment_set_upper     (self->vadjustment, self->zoom * self->image_height);
 	gtk_adjustment_set_page_size (self->hadjustment, self->area_width);
 	gtk_adjustment_set_page_size (self->vadjustment, self->area_height);
 	gtk_adjustment_set_value     (self->hadjustment, gtk_adjustment_get_value (self->hadjustment));
@@ -940,3 +1322,19 @@ viewer_application_window_update_title (ViewerApplicationWindow *self)
 
 	gtk_window_set_title (GTK_WINDOW (self), title);
 }
+
+/*******************************************************************************
+表示する画像、拡大率、スクロール位置、背景色を画像の表示領域へ反映します。
+*/
+static void
+viewer_application_window_update_view (ViewerApplicationWindow *self)
+{
+	GdkRGBA color;
+	color.red = self->background_red;
+	color.green = self->background_green;
+	color.blue = self->background_blue;
+	color.alpha = 1.0F;
+	viewer_view_set_background (VIEWER_VIEW (self->area), &color);
+	viewer_view_set_image (VIEWER_VIEW (self->area), self->display);
+	viewer_view_set_position (VIEWER_VIEW (self->area), self->zoom, gtk_adjustment_get_value (self->hadjustment), gtk_adjustment_get_value (self->vadjustment));
+}
@@ -0,0 +1,825 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include "viewer.h"
+#define BENCH_CLEAR_REFS     "/proc/self/clear_refs"
+#define BENCH_CONVERT_GUARD  16
+#define BENCH_CONVERT_HEIGHT 256
+#define BENCH_CONVERT_WIDTH  2048
+#define BENCH_FILE_FORMAT    "%dx%d-%s.%s"
+#define BENCH_FRAMES         120
+#define BENCH_ITERATIONS     3
+#define BENCH_PAN_STEP       37
+#define BENCH_PEAK_FIELD     "VmHWM:"
+#define BENCH_RESET_PEAK     "5"
+#define BENCH_RSS_FIELD      "VmRSS:"
+#define BENCH_STATUS         "/proc/self/status"
+#define BENCH_STRIP_FILE     "strips.jpg"
+#define BENCH_STRIP_HEIGHT   4000
+#define BENCH_STRIP_ROWS     16
+#define BENCH_STRIP_WIDTH    6000
+#define BENCH_SURFACE_HEIGHT 800
+#define BENCH_SURFACE_WIDTH  1280
+#define BENCH_TEMPLATE       "viewerbench-XXXXXX"
+#define BENCH_USEC           1000000.0
+#define JPEG_DRI             0xDD
+#define JPEG_EOI             0xD9
+#define JPEG_MARKER          0xFF
+#define JPEG_RST0            0xD0
+#define JPEG_SOF0            0xC0
+#define JPEG_SOF1            0xC1
+#define JPEG_SOS             0xDA
+
+typedef struct _ViewerBenchCase   ViewerBenchCase;
+typedef struct _ViewerBenchStages ViewerBenchStages;
+
+/* 生成する画像 */
+struct _ViewerBenchCase
+{
+	const char *format;
+	const char *extension;
+	int         width;
+	int         height;
+	gboolean    alpha;
+};
+
+/* 各段階の所要時間 (マイクロ秒) と、読み込み処理全体で増えた最大のメモリ (KiB) */
+struct _ViewerBenchStages
+{
+	gint64 read;
+	gint64 decode;
+	gint64 swizzle;
+	gint64 upload;
+	gint64 composite;
+	gint64 paint;
+	gint64 load;
+	gint64 load_rss;
+};
+
+static gboolean viewer_bench_check         (ViewerConvertFunc func, ViewerConvertFunc scalar, const guchar *source);
+static gboolean viewer_bench_convert       (GString *json, int iterations);
+static char    *viewer_bench_create_file   (const ViewerBenchCase *entry, const char *directory, GError **error);
+static char    *viewer_bench_create_strips (const char *directory, GError **error);
+static guchar  *viewer_bench_download      (ViewerImage *image);
+static void     viewer_bench_draw          (ViewerImage *image, cairo_t *cairo, double zoom, double x, double y);
+static void     viewer_bench_fill          (GdkPixbuf *pixbuf);
+static gint64   viewer_bench_get_memory    (const char *field);
+static gboolean viewer_bench_measure       (const char *path, int frames, ViewerBenchStages *stages, GError **error);
+static void     viewer_bench_print_case    (GString *json, const ViewerBenchCase *entry, const ViewerBenchStages *stages);
+static double   viewer_bench_rate          (double megapixels, gint64 time);
+static gint64   viewer_bench_reset_peak    (void);
+static gboolean viewer_bench_strips        (GString *json, const char *directory, int iterations);
+
+/* 生成する画像の一覧 */
+static const ViewerBenchCase BENCH_CASES [] =
+{
+	{ "png",  "png",   512,  512, FALSE },
+	{ "png",  "png",   512,  512, TRUE  },
+	{ "png",  "png",  2048, 2048, FALSE },
+	{ "png",  "png",  2048, 2048, TRUE  },
+	{ "png",  "png",  6000, 4000, TRUE  },
+	{ "jpeg", "jpg",   512,  512, FALSE },
+	{ "jpeg", "jpg",  2048, 2048, FALSE },
+	{ "jpeg", "jpg",  6000, 4000, FALSE },
+	{ "bmp",  "bmp",  2048, 2048, FALSE },
+	{ "tiff", "tiff", 2048, 2048, TRUE  },
+};
+
+/* 端数の処理を確かめる画素変換の幅 */
+static const int BENCH_CONVERT_WIDTHS [] = { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 129, 2047 };
+
+/* 描画する拡大率の順序 */
+static const double BENCH_ZOOMS [] = { 1.0, 0.5, 0.25, 0.125, 2.0, 0.75 };
+
+/* 背景色 */
+static const GdkRGBA BENCH_BACKGROUND = { 0.1F, 0.2F, 0.3F, 1.0F };
+
+/* コマンド ライン引数 */
+static int bench_frames     = BENCH_FRAMES;
+static int bench_iterations = BENCH_ITERATIONS;
+static const GOptionEntry BENCH_OPTIONS [] =
+{
+	{ "frames",     'f', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT, &bench_frames,     "Number of zoom and pan frames to paint", "N" },
+	{ "iterations", 'i', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT, &bench_iterations, "Number of runs per image; the best run is reported", "N" },
+	G_OPTION_ENTRY_NULL
+};
+
+/*******************************************************************************
+ベンチマークのメイン エントリ ポイントです。
+画像を生成して読み込みと描画の各段階を計測し、結果を JSON で標準出力へ書き込みます。
+画素変換の結果がスカラー版と一致しない命令セットがあった場合と、
+帯に分けて展開した画像が 1 つのスレッドで展開した画像と一致しない場合は 1 を返します。
+*/
+int
+main (int argc, char *argv [])
+{
+	GOptionContext *context;
+	ViewerBenchStages stages, best;
+	struct rusage usage;
+	GString *json;
+	GError *error;
+	char *directory, *path, *message;
+	gsize n;
+	int iteration;
+	gboolean exact, strips;
+	error = NULL;
+	context = g_option_context_new (NULL);
+	g_option_context_add_main_entries (context, BENCH_OPTIONS, NULL);
+
+	if (!g_option_context_parse (context, &argc, &argv, &error) || !(directory = g_dir_make_tmp (BENCH_TEMPLATE, &error)))
+	{
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_option_context_free (context);
+		return 1;
+	}
+
+	bench_iterations = MAX (bench_iterations, 1);
+	json = g_string_new ("{\n");
+	g_string_append_printf (json, "  \"iterations\": %d,\n  \"frames\": %d,\n", bench_iterations, bench_frames);
+	exact = viewer_bench_convert (json, bench_iterations);
+	strips = viewer_bench_strips (json, directory, bench_iterations);
+	g_string_append (json, "  \"images\": [");
+
+	for (n = 0; n < G_N_ELEMENTS (BENCH_CASES); n++)
+	{
+		g_string_append (json, n ? ",\n    " : "\n    ");
+		path = viewer_bench_create_file (&BENCH_CASES [n], directory, &error);
+
+		for (iteration = 0; path && (iteration < bench_iterations); iteration++)
+		{
+			if (!viewer_bench_measure (path, bench_frames, &stages, &error))
+			{
+				break;
+			}
+			if (!iteration)
+			{
+				best = stages;
+			}
+			else
+			{
+				best.read      = MIN (best.read,      stages.read);
+				best.decode    = MIN (best.decode,    stages.decode);
+				best.swizzle   = MIN (best.swizzle,   stages.swizzle);
+				best.upload    = MIN (best.upload,    stages.upload);
+				best.composite = MIN (best.composite, stages.composite);
+				best.paint     = MIN (best.paint,     stages.paint);
+				best.load      = MIN (best.load,      stages.load);
+				best.load_rss  = MIN (best.load_rss,  stages.load_rss);
+			}
+		}
+		if (error)
+		{
+			message = g_strescape (error->message, NULL);
+			g_string_append_printf (json, "{ \"format\": \"%s\", \"width\": %d, \"height\": %d, \"alpha\": %s, \"error\": \"%s\" }",
+				BENCH_CASES [n].format, BENCH_CASES [n].width, BENCH_CASES [n].height, BENCH_CASES [n].alpha ? "true" : "false", message);
+			g_clear_error (&error);
+			g_free (message);
+		}
+		else
+		{
+			viewer_bench_print_case (json, &BENCH_CASES [n], &best);
+		}
+		if (path)
+		{
+			g_remove (path);
+			g_free (path);
+		}
+	}
+
+	getrusage (RUSAGE_SELF, &usage);
+	g_string_append_printf (json, "\n  ],\n  \"peak_rss_kib\": %ld\n}\n", usage.ru_maxrss);
+	fputs (json->str, stdout);
+	g_string_free (json, TRUE);
+	g_rmdir (directory);
+	g_free (directory);
+	g_option_context_free (context);
+
+	if (!exact)
+	{
+		g_printerr ("Pixel conversion does not match the scalar path\n");
+	}
+	if (!strips)
+	{
+		g_printerr ("Strip decoding failed or does not match the serial decode\n");
+	}
+
+	return (exact && strips) ? 0 : 1;
+}
+
+/*******************************************************************************
+端数の幅と境界に揃っていない位置で画素変換を実行し、スカラー版と結果が一致するかを調べます。
+出力の後ろに置いた番兵が書き換えられていないことも確かめます。
+*/
+static gboolean
+viewer_bench_check (ViewerConvertFunc func, ViewerConvertFunc scalar, const guchar *source)
+{
+	guchar expected [(BENCH_CONVERT_WIDTH + BENCH_CONVERT_GUARD) * 4], actual [(BENCH_CONVERT_WIDTH + BENCH_CONVERT_GUARD) * 4];
+	gsize n, offset, size;
+	gboolean result;
+	result = TRUE;
+
+	for (n = 0; result && (n < G_N_ELEMENTS (BENCH_CONVERT_WIDTHS)); n++)
+	{
+		for (offset = 0; result && (offset < 4); offset++)
+		{
+			size = (gsize) (BENCH_CONVERT_WIDTHS [n] + BENCH_CONVERT_GUARD) * 4;
+			memset (expected, 0xA5, size);
+			memset (actual, 0xA5, size);
+			scalar (source + offset, expected + offset, BENCH_CONVERT_WIDTHS [n]);
+			func (source + offset, actual + offset, BENCH_CONVERT_WIDTHS [n]);
+			result = !memcmp (expected, actual, size);
+		}
+	}
+
+	return result;
+}
+
+/*******************************************************************************
+各命令セットの画素変換を計測し、スカラー版と結果が一致するかを調べます。
+計測は幅 2048 の行で、一致は同じ行に加えて端数の幅でも調べます。全て一致した場合は TRUE を返します。
+*/
+static gboolean
+viewer_bench_convert (GString *json, int iterations)
+{
+	ViewerConvertFunc func, scalar;
+	guchar *source, *expected, *actual;
+	gint64 time, best;
+	int path, n_channels, iteration, y;
+	gboolean exact, result;
+	result = TRUE;
+	source = g_malloc ((gsize) BENCH_CONVERT_WIDTH * BENCH_CONVERT_HEIGHT * 4);
+	expected = g_malloc ((gsize) BENCH_CONVERT_WIDTH * BENCH_CONVERT_HEIGHT * 4);
+	actual = g_malloc ((gsize) BENCH_CONVERT_WIDTH * BENCH_CONVERT_HEIGHT * 4);
+
+	for (y = 0; y < BENCH_CONVERT_WIDTH * BENCH_CONVERT_HEIGHT * 4; y++)
+	{
+		source [y] = (guchar) g_random_int ();
+	}
+
+	g_string_append (json, "  \"swizzle\": [");
+
+	for (n_channels = 3; n_channels <= 4; n_channels++)
+	{
+		scalar = viewer_convert_get_func (VIEWER_CONVERT_PATH_SCALAR, n_channels);
+
+		for (y = 0; y < BENCH_CONVERT_HEIGHT; y++)
+		{
+			scalar (source + y * BENCH_CONVERT_WIDTH * n_channels, expected + y * BENCH_CONVERT_WIDTH * 4, BENCH_CONVERT_WIDTH);
+		}
+		for (path = 0; path < VIEWER_CONVERT_N_PATHS; path++)
+		{
+			func = viewer_convert_get_func (path, n_channels);
+			g_string_append (json, (n_channels == 3) && !path ? "\n    " : ",\n    ");
+			g_string_append_printf (json, "{ \"path\": \"%s\", \"channels\": %d, ", viewer_convert_get_name (path), n_channels);
+
+			if (func)
+			{
+				best = G_MAXINT64;
+
+				for (iteration = 0; iteration < iterations; iteration++)
+				{
+					time = g_get_monotonic_time ();
+
+					for (y = 0; y < BENCH_CONVERT_HEIGHT; y++)
+					{
+						func (source + y * BENCH_CONVERT_WIDTH * n_channels, actual + y * BENCH_CONVERT_WIDTH * 4, BENCH_CONVERT_WIDTH);
+					}
+
+					best = MIN (best, g_get_monotonic_time () - time);
+				}
+
+				exact = !memcmp (expected, actual, (gsize) BENCH_CONVERT_WIDTH * BENCH_CONVERT_HEIGHT * 4) && viewer_bench_check (func, scalar, source);
+				result = result && exact;
+				g_string_append_printf (json, "\"available\": true, \"exact\": %s, \"ms\": %.3f, \"mp_per_s\": %.1f }",
+					exact ? "true" : "false", best / 1000.0, viewer_bench_rate (BENCH_CONVERT_WIDTH * BENCH_CONVERT_HEIGHT / 1e6, best));
+			}
+			else
+			{
+				g_string_append (json, "\"available\": false }");
+			}
+		}
+	}
+
+	g_string_append (json, "\n  ],\n");
+	g_free (actual);
+	g_free (expected);
+	g_free (source);
+	return result;
+}
+
+/*******************************************************************************
+計測用の画像ファイルを生成します。生成したファイルのパスを返します。
+*/
+static char *
+viewer_bench_create_file (const ViewerBenchCase *entry, const char *directory, GError **error)
+{
+	GdkPixbuf *pixbuf;
+	char *name, *path;
+	pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, entry->alpha, 8, entry->width, entry->height);
+
+	if (pixbuf)
+	{
+		viewer_bench_fill (pixbuf);
+		name = g_strdup_printf (BENCH_FILE_FORMAT, entry->width, entry->height, entry->alpha ? "rgba" : "rgb", entry->extension);
+		path = g_build_filename (directory, name, NULL);
+		g_free (name);
+
+		if (!gdk_pixbuf_savev (pixbuf, path, entry->format, NULL, NULL, error))
+		{
+			g_clear_pointer (&path, g_free);
+		}
+
+		g_object_unref (pixbuf);
+	}
+	else
+	{
+		g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_NOMEM, "Out of memory");
+		path = NULL;
+	}
+
+	return path;
+}
+
+/*******************************************************************************
+リスタート マーカーを持つ大きな JPEG ファイルを生成します。生成したファイルのパスを返します。
+GdkPixbuf はリスタート間隔を指定して保存できないので、MCU の 1 行分の帯を別々に保存し、
+帯の圧縮データを RST マーカーで区切ってつなぎます。帯の先頭では DC 成分の予測が初期化されるので、
+つないだファイルは MCU の 1 行ごとにリスタート間隔を置いて保存したものと同じになります。
+*/
+static char *
+viewer_bench_create_strips (const char *directory, GError **error)
+{
+	GdkPixbuf *pixbuf, *band;
+	GByteArray *array;
+	guchar marker [6];
+	char *buffer, *path;
+	gsize length, offset, size, sof;
+	int y, n, max_h, max_v, interval;
+	pixbuf = gdk_pixbuf_new (GDK_COLORSPACE_RGB, FALSE, 8, BENCH_STRIP_WIDTH, BENCH_STRIP_HEIGHT);
+	array = g_byte_array_new ();
+	path = NULL;
+
+	if (pixbuf)
+	{
+		viewer_bench_fill (pixbuf);
+		path = g_build_filename (directory, BENCH_STRIP_FILE, NULL);
+
+		for (y = 0; path && (y < BENCH_STRIP_HEIGHT); y += BENCH_STRIP_ROWS)
+		{
+			band = gdk_pixbuf_new_subpixbuf (pixbuf, 0, y, BENCH_STRIP_WIDTH, MIN (BENCH_STRIP_ROWS, BENCH_STRIP_HEIGHT - y));
+
+			if (gdk_pixbuf_save_to_buffer (band, &buffer, &length, "jpeg", error, NULL))
+			{
+				offset = 2;
+				sof = 0;
+
+				while ((offset + 4 <= length) && ((guchar) buffer [offset + 1] != JPEG_SOS))
+				{
+					sof = (((guchar) buffer [offset + 1] == JPEG_SOF0) || ((guchar) buffer [offset + 1] == JPEG_SOF1)) ? offset : sof;
+					offset += 2 + ((guchar) buffer [offset + 2] << 8 | (guchar) buffer [offset + 3]);
+				}
+
+				size = (offset + 4 <= length) ? 2 + ((guchar) buffer [offset + 2] << 8 | (guchar) buffer [offset + 3]) : 0;
+
+				if (!sof || !size || (offset + size + 2 > length))
+				{
+					g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Unexpected JPEG layout");
+					g_clear_pointer (&path, g_free);
+				}
+				else if (!y)
+				{
+					g_byte_array_append (array, (const guchar *) buffer, offset);
+					array->data [sof + 5] = (guchar) (BENCH_STRIP_HEIGHT >> 8);
+					array->data [sof + 6] = (guchar) BENCH_STRIP_HEIGHT;
+					max_h = max_v = 1;
+
+					for (n = 0; n < array->data [sof + 9]; n++)
+					{
+						max_h = MAX (max_h, array->data [sof + 11 + 3 * n] >> 4);
+						max_v = MAX (max_v, array->data [sof + 11 + 3 * n] & 0x0F);
+					}
+
+					interval = (BENCH_STRIP_WIDTH + 8 * max_h - 1) / (8 * max_h) * (BENCH_STRIP_ROWS / (8 * max_v));
+					marker [0] = JPEG_MARKER;
+					marker [1] = JPEG_DRI;
+					marker [2] = 0;
+					marker [3] = 4;
+					marker [4] = (guchar) (interval >> 8);
+					marker [5] = (guchar) interval;
+					g_byte_array_append (array, marker, 6);
+					g_byte_array_append (array, (const guchar *) buffer + offset, size);
+				}
+				else
+				{
+					marker [0] = JPEG_MARKER;
+					marker [1] = (guchar) (JPEG_RST0 + (y / BENCH_STRIP_ROWS - 1) % 8);
+					g_byte_array_append (array, marker, 2);
+				}
+				if (path)
+				{
+					g_byte_array_append (array, (const guchar *) buffer + offset + size, length - offset - size - 2);
+				}
+
+				g_free (buffer);
+			}
+			else
+			{
+				g_clear_pointer (&path, g_free);
+			}
+
+			g_object_unref (band);
+		}
+		if (path)
+		{
+			marker [0] = JPEG_MARKER;
+			marker [1] = JPEG_EOI;
+			g_byte_array_append (array, marker, 2);
+
+			if (!g_file_set_contents (path, (const char *) array->data, array->len, error))
+			{
+				g_clear_pointer (&path, g_free);
+			}
+		}
+
+		g_object_unref (pixbuf);
+	}
+	else
+	{
+		g_set_error_literal (error, G_FILE_ERROR, G_FILE_ERROR_NOMEM, "Out of memory");
+	}
+
+	g_byte_array_unref (array);
+	return path;
+}
+
+/*******************************************************************************
+画像全体を等倍で描画し、その画素を読み取ります。描画できない場合は NULL を返します。
+*/
+static guchar *
+viewer_bench_download (ViewerImage *image)
+{
+	GdkTexture *texture;
+	guchar *pixels;
+	int width, height;
+	width = viewer_image_get_width (image);
+	height = viewer_image_get_height (image);
+	texture = viewer_image_render (image, 1.0, width, height);
+	pixels = NULL;
+
+	if (texture)
+	{
+		pixels = g_malloc ((gsize) width * height * 4);
+		gdk_texture_download (texture, pixels, (gsize) width * 4);
+		g_object_unref (texture);
+	}
+
+	return pixels;
+}
+
+/*******************************************************************************
+背景と画像をスナップショットへ追加し、ソフトウェア レンダラーと同じ cairo の経路で描画します。
+*/
+static void
+viewer_bench_draw (ViewerImage *image, cairo_t *cairo, double zoom, double x, double y)
+{
+	GtkSnapshot *snapshot;
+	GskRenderNode *node;
+	snapshot = gtk_snapshot_new ();
+	gtk_snapshot_append_color (snapshot, &BENCH_BACKGROUND, &GRAPHENE_RECT_INIT (0, 0, BENCH_SURFACE_WIDTH, BENCH_SURFACE_HEIGHT));
+	viewer_image_snapshot (image, snapshot, zoom, x, y, BENCH_SURFACE_WIDTH, BENCH_SURFACE_HEIGHT, FALSE);
+	node = gtk_snapshot_free_to_node (snapshot);
+
+	if (node)
+	{
+		gsk_render_node_draw (node, cairo);
+		gsk_render_node_unref (node);
+	}
+}
+
+/*******************************************************************************
+圧縮しにくいよう、グラデーションに雑音を加えた画素で塗りつぶします。
+*/
+static void
+viewer_bench_fill (GdkPixbuf *pixbuf)
+{
+	GRand *random;
+	guchar *pixels, *pixel;
+	int x, y, width, height, stride, n_channels;
+	random = g_rand_new_with_seed (0);
+	pixels = gdk_pixbuf_get_pixels (pixbuf);
+	width = gdk_pixbuf_get_width (pixbuf);
+	height = gdk_pixbuf_get_height (pixbuf);
+	stride = gdk_pixbuf_get_rowstride (pixbuf);
+	n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			pixel = pixels + (gsize) y * stride + x * n_channels;
+			pixel [0] = (guchar) (x * 255 / width + g_rand_int_range (random, 0, 16));
+			pixel [1] = (guchar) (y * 255 / height + g_rand_int_range (random, 0, 16));
+			pixel [2] = (guchar) ((x ^ y) + g_rand_int_range (random, 0, 16));
+
+			if (n_channels == 4)
+			{
+				pixel [3] = (guchar) ((x + y) * 255 / (width + height));
+			}
+		}
+	}
+
+	g_rand_free (random);
+}
+
+/*******************************************************************************
+/proc/self/status から field の値 (KiB) を読み取ります。読み取れない場合は 0 を返します。
+*/
+static gint64
+viewer_bench_get_memory (const char *field)
+{
+	char *contents, *found;
+	gint64 value;
+	value = 0;
+
+	if (g_file_get_contents (BENCH_STATUS, &contents, NULL, NULL))
+	{
+		found = strstr (contents, field);
+
+		if (found)
+		{
+			value = g_ascii_strtoll (found + strlen (field), NULL, 10);
+		}
+
+		g_free (contents);
+	}
+
+	return value;
+}
+
+/*******************************************************************************
+画像ファイルを 1 回読み込み、各段階の所要時間を計測します。
+read はファイルの読み取り、decode は展開、swizzle は ARGB32 への変換、
+upload は区画への書き込み、composite は各拡大率の初回描画 (縮小画像とテクスチャの作成を含む)、
+paint は拡大とスクロールを繰り返す描画、load は読み込み処理全体です。
+load_rss は読み込み処理全体の間に最大でどれだけメモリが増えたかで、読み込み直前の使用量との差です。
+*/
+static gboolean
+viewer_bench_measure (const char *path, int frames, ViewerBenchStages *stages, GError **error)
+{
+	GdkPixbufLoader *loader;
+	cairo_surface_t *surface;
+	ViewerImage *image;
+	GdkPixbuf *pixbuf;
+	cairo_t *cairo;
+	GFile *file;
+	guchar *buffer;
+	char *contents;
+	gsize length;
+	gint64 time;
+	double zoom, x, y;
+	int width, height, frame;
+	file = g_file_new_for_path (path);
+	time = g_get_monotonic_time ();
+
+	if (!g_file_load_contents (file, NULL, &contents, &length, NULL, error))
+	{
+		g_object_unref (file);
+		return FALSE;
+	}
+
+	stages->read = g_get_monotonic_time () - time;
+	time = g_get_monotonic_time ();
+	loader = gdk_pixbuf_loader_new ();
+
+	if (!gdk_pixbuf_loader_write (loader, (const guchar *) contents, length, error) || !gdk_pixbuf_loader_close (loader, error))
+	{
+		gdk_pixbuf_loader_close (loader, NULL);
+		g_object_unref (loader);
+		g_free (contents);
+		g_object_unref (file);
+		return FALSE;
+	}
+
+	pixbuf = g_object_ref (gdk_pixbuf_loader_get_pixbuf (loader));
+	stages->decode = g_get_monotonic_time () - time;
+	g_object_unref (loader);
+	g_free (contents);
+	width = gdk_pixbuf_get_width (pixbuf);
+	height = gdk_pixbuf_get_height (pixbuf);
+	buffer = g_malloc ((gsize) width * height * 4);
+	time = g_get_monotonic_time ();
+	viewer_convert_pixels (gdk_pixbuf_read_pixels (pixbuf), gdk_pixbuf_get_rowstride (pixbuf), gdk_pixbuf_get_n_channels (pixbuf), buffer, width * 4, width, height);
+	stages->swizzle = g_get_monotonic_time () - time;
+	g_free (buffer);
+	time = g_get_monotonic_time ();
+	image = viewer_image_new (width, height);
+	viewer_image_write (image, gdk_pixbuf_read_pixels (pixbuf), gdk_pixbuf_get_rowstride (pixbuf), gdk_pixbuf_get_n_channels (pixbuf), 0, 0, width, height);
+	stages->upload = g_get_monotonic_time () - time;
+	g_object_unref (pixbuf);
+	surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, BENCH_SURFACE_WIDTH, BENCH_SURFACE_HEIGHT);
+	cairo = cairo_create (surface);
+	time = g_get_monotonic_time ();
+
+	for (frame = 0; frame < (int) G_N_ELEMENTS (BENCH_ZOOMS); frame++)
+	{
+		viewer_bench_draw (image, cairo, BENCH_ZOOMS [frame], 0.0, 0.0);
+	}
+
+	cairo_surface_flush (surface);
+	stages->composite = g_get_monotonic_time () - time;
+	time = g_get_monotonic_time ();
+
+	for (frame = 0; frame < frames; frame++)
+	{
+		zoom = BENCH_ZOOMS [frame / 8 % G_N_ELEMENTS (BENCH_ZOOMS)];
+		x = MAX (0.0, fmod ((double) frame * BENCH_PAN_STEP, MAX (1.0, width * zoom - BENCH_SURFACE_WIDTH)));
+		y = MAX (0.0, fmod ((double) frame * BENCH_PAN_STEP, MAX (1.0, height * zoom - BENCH_SURFACE_HEIGHT)));
+		viewer_bench_draw (image, cairo, zoom, x, y);
+	}
+
+	cairo_surface_flush (surface);
+	stages->paint = g_get_monotonic_time () - time;
+	cairo_destroy (cairo);
+	cairo_surface_destroy (surface);
+	g_object_unref (image);
+	stages->load_rss = viewer_bench_reset_peak ();
+	time = g_get_monotonic_time ();
+	image = viewer_create_image_from_file (file, NULL, error);
+	stages->load = g_get_monotonic_time () - time;
+	stages->load_rss = stages->load_rss ? viewer_bench_get_memory (BENCH_PEAK_FIELD) - stages->load_rss : 0;
+	g_object_unref (file);
+
+	if (!image)
+	{
+		return FALSE;
+	}
+
+	g_object_unref (image);
+	return TRUE;
+}
+
+/*******************************************************************************
+1 つの画像の計測結果を JSON で書き込みます。
+*/
+static void
+viewer_bench_print_case (GString *json, const ViewerBenchCase *entry, const ViewerBenchStages *stages)
+{
+	double megapixels;
+	megapixels = (double) entry->width * entry->height / 1e6;
+	g_string_append_printf (json, "{ \"format\": \"%s\", \"width\": %d, \"height\": %d, \"alpha\": %s, \"megapixels\": %.2f,\n",
+		entry->format, entry->width, entry->height, entry->alpha ? "true" : "false", megapixels);
+	g_string_append_printf (json, "      \"ms\": { \"read\": %.3f, \"decode\": %.3f, \"swizzle\": %.3f, \"upload\": %.3f, \"composite\": %.3f, \"paint\": %.3f, \"load\": %.3f },\n",
+		stages->read / 1000.0, stages->decode / 1000.0, stages->swizzle / 1000.0, stages->upload / 1000.0, stages->composite / 1000.0, stages->paint / 1000.0, stages->load / 1000.0);
+	g_string_append_printf (json, "      \"mp_per_s\": { \"decode\": %.1f, \"swizzle\": %.1f, \"upload\": %.1f, \"load\": %.1f },\n",
+		viewer_bench_rate (megapixels, stages->decode), viewer_bench_rate (megapixels, stages->swizzle), viewer_bench_rate (megapixels, stages->upload), viewer_bench_rate (megapixels, stages->load));
+	g_string_append_printf (json, "      \"load_peak_rss_kib\": %" G_GINT64_FORMAT " }", stages->load_rss);
+}
+
+/*******************************************************************************
+1 秒あたりのメガピクセル数を求めます。
+*/
+static double
+viewer_bench_rate (double megapixels, gint64 time)
+{
+	return time > 0 ? megapixels * BENCH_USEC / time : 0.0;
+}
+
+/*******************************************************************************
+最大のメモリ使用量を今の使用量に戻し、今の使用量 (KiB) を返します。
+Linux 4.0 より前のように戻せない場合は 0 を返します。
+*/
+static gint64
+viewer_bench_reset_peak (void)
+{
+	FILE *stream;
+	gboolean written;
+	gint64 value;
+	stream = fopen (BENCH_CLEAR_REFS, "w");
+	value = 0;
+
+	if (stream)
+	{
+		written = fputs (BENCH_RESET_PEAK, stream) >= 0;
+
+		if (!fclose (stream) && written)
+		{
+			value = viewer_bench_get_memory (BENCH_RSS_FIELD);
+		}
+	}
+
+	return value;
+}
+
+/*******************************************************************************
+大きな JPEG ファイルを、1 つのスレッドで展開する場合と、帯に分けて全てのプロセッサーで展開する場合とで比較します。
+serial は GdkPixbuf による展開と区画への書き込み、parallel は帯ごとの展開と書き込みを合わせた時間です。
+どちらもファイルをメモリへ割り当てるところから計ります。
+最初の回では両方の画像を等倍で読み取って比べ、画素が全て一致した場合は TRUE を返します。
+*/
+static gboolean
+viewer_bench_strips (GString *json, const char *directory, int iterations)
+{
+	GdkPixbufLoader *loader;
+	ViewerImage *image;
+	GMappedFile *mapped;
+	GdkPixbuf *pixbuf;
+	GError *error;
+	GFile *file;
+	char *path, *message;
+	guchar *expected, *actual;
+	gint64 time, serial, parallel;
+	int iteration;
+	gboolean exact;
+	error = NULL;
+	expected = actual = NULL;
+	exact = FALSE;
+	path = viewer_bench_create_strips (directory, &error);
+	serial = parallel = G_MAXINT64;
+
+	for (iteration = 0; path && (iteration < iterations) && !error; iteration++)
+	{
+		time = g_get_monotonic_time ();
+		mapped = g_mapped_file_new (path, FALSE, &error);
+
+		if (mapped)
+		{
+			loader = gdk_pixbuf_loader_new ();
+
+			if (gdk_pixbuf_loader_write (loader, (const guchar *) g_mapped_file_get_contents (mapped), g_mapped_file_get_length (mapped), &error) && gdk_pixbuf_loader_close (loader, &error))
+			{
+				pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+				image = viewer_image_new (gdk_pixbuf_get_width (pixbuf), gdk_pixbuf_get_height (pixbuf));
+				viewer_image_write (image, gdk_pixbuf_read_pixels (pixbuf), gdk_pixbuf_get_rowstride (pixbuf), gdk_pixbuf_get_n_channels (pixbuf), 0, 0, gdk_pixbuf_get_width (pixbuf), gdk_pixbuf_get_height (pixbuf));
+				serial = MIN (serial, g_get_monotonic_time () - time);
+
+				if (!iteration)
+				{
+					expected = viewer_bench_download (image);
+				}
+
+				g_object_unref (image);
+			}
+			else
+			{
+				gdk_pixbuf_loader_close (loader, NULL);
+			}
+
+			g_object_unref (loader);
+			g_mapped_file_unref (mapped);
+		}
+		if (!error)
+		{
+			file = g_file_new_for_path (path);
+			time = g_get_monotonic_time ();
+			image = viewer_strip_open (file, NULL);
+			parallel = MIN (parallel, g_get_monotonic_time () - time);
+			g_object_unref (file);
+
+			if (image)
+			{
+				if (!iteration)
+				{
+					actual = viewer_bench_download (image);
+					exact = expected && actual && !memcmp (expected, actual, (gsize) BENCH_STRIP_WIDTH * BENCH_STRIP_HEIGHT * 4);
+					g_clear_pointer (&expected, g_free);
+					g_clear_pointer (&actual, g_free);
+				}
+
+				g_object_unref (image);
+			}
+			else
+			{
+				g_set_error_literal (&error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Cannot split the JPEG file");
+			}
+		}
+	}
+
+	g_string_append_printf (json, "  \"strips\": { \"width\": %d, \"height\": %d, \"threads\": %u, ", BENCH_STRIP_WIDTH, BENCH_STRIP_HEIGHT, g_get_num_processors ());
+
+	if (error)
+	{
+		message = g_strescape (error->message, NULL);
+		g_string_append_printf (json, "\"error\": \"%s\" },\n", message);
+		g_error_free (error);
+		g_free (message);
+		exact = FALSE;
+	}
+	else
+	{
+		g_string_append_printf (json, "\"exact\": %s, \"serial_ms\": %.3f, \"parallel_ms\": %.3f, \"speedup\": %.2f },\n",
+			exact ? "true" : "false", serial / 1000.0, parallel / 1000.0, (double) serial / MAX (parallel, 1));
+	}
+	if (path)
+	{
+		g_remove (path);
+		g_free (path);
+	}
+
+	g_free (expected);
+	return exact;
+}
@@ -0,0 +1,323 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include "viewer.h"
+#define CACHE_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_SIZE "," G_FILE_ATTRIBUTE_TIME_MODIFIED "," G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC "," G_FILE_ATTRIBUTE_UNIX_INODE
+#define CACHE_KEY_FORMAT "%s\n%" G_GUINT64_FORMAT "\n%u\n%" G_GOFFSET_FORMAT "\n%" G_GUINT64_FORMAT
+#define CACHE_WAIT       (100 * G_TIME_SPAN_MILLISECOND)
+#define TRACE_HIT        "cache-hit"
+#define TRACE_MISS       "cache-miss"
+
+typedef struct _ViewerCacheEntry   ViewerCacheEntry;
+typedef struct _ViewerCachePending ViewerCachePending;
+
+/* キャッシュの項目 */
+struct _ViewerCacheEntry
+{
+	char        *key;
+	ViewerImage *image;
+	gsize        size;
+};
+
+/* 読み込み中の項目 */
+struct _ViewerCachePending
+{
+	ViewerImage *image;
+	guint        stamp;
+};
+
+/* Viewer Cache クラスのインスタンス */
+struct _ViewerCache
+{
+	GObject     parent_instance;
+	GMutex      mutex;
+	GCond       cond;
+	GHashTable *pending;
+	GHashTable *table;
+	GQueue      queue;
+	gsize       capacity;
+	gsize       size;
+};
+
+static void viewer_cache_class_init   (ViewerCacheClass *this_class);
+static void viewer_cache_evict        (ViewerCache *self);
+static void viewer_cache_finalize     (GObject *self);
+static void viewer_cache_free_entry   (ViewerCacheEntry *entry);
+static void viewer_cache_free_pending (ViewerCachePending *pending);
+static void viewer_cache_init         (ViewerCache *self);
+static void viewer_cache_remove       (ViewerCache *self, GList *link);
+
+/* Viewer Cache クラス */
+G_DEFINE_TYPE (ViewerCache, viewer_cache, G_TYPE_OBJECT);
+
+/*******************************************************************************
+クラスを初期化します。
+*/
+static void
+viewer_cache_class_init (ViewerCacheClass *this_class)
+{
+	G_OBJECT_CLASS (this_class)->finalize = viewer_cache_finalize;
+}
+
+/*******************************************************************************
+容量を超えた分を最も長く使用していない項目から破棄します。
+呼び出し元はロックを保持します。最後に使用した項目は常に残します。
+*/
+static void
+viewer_cache_evict (ViewerCache *self)
+{
+	while ((self->size > self->capacity) && (self->queue.length > 1))
+	{
+		viewer_cache_remove (self, self->queue.tail);
+	}
+}
+
+/*******************************************************************************
+クラスのインスタンスを破棄します。
+*/
+static void
+viewer_cache_finalize (GObject *self)
+{
+	ViewerCache *properties;
+	properties = VIEWER_CACHE (self);
+	g_hash_table_unref (properties->pending);
+	g_hash_table_unref (properties->table);
+	g_queue_clear_full (&properties->queue, (GDestroyNotify) viewer_cache_free_entry);
+	g_cond_clear (&properties->cond);
+	g_mutex_clear (&properties->mutex);
+	G_OBJECT_CLASS (viewer_cache_parent_class)->finalize (self);
+}
+
+/*******************************************************************************
+項目を破棄します。
+*/
+static void
+viewer_cache_free_entry (ViewerCacheEntry *entry)
+{
+	g_object_unref (entry->image);
+	g_free (entry->key);
+	g_free (entry);
+}
+
+/*******************************************************************************
+読み込み中の項目を破棄します。
+*/
+static void
+viewer_cache_free_pending (ViewerCachePending *pending)
+{
+	g_clear_object (&pending->image);
+	g_free (pending);
+}
+
+/*******************************************************************************
+画像ファイルを識別するキーを作成します。
+URI、更新日時、大きさ、inode が同じファイルは同じ画像とみなします。
+*/
+char *
+viewer_cache_get_key (GFile *file, GCancellable *cancellable, GError **error)
+{
+	GFileInfo *info;
+	char *key, *uri;
+	info = g_file_query_info (file, CACHE_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, cancellable, error);
+
+	if (info)
+	{
+		uri = g_file_get_uri (file);
+		key = g_strdup_printf (CACHE_KEY_FORMAT, uri,
+			g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+			g_file_info_get_attribute_uint32 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED_USEC),
+			g_file_info_get_size (info),
+			g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_UNIX_INODE));
+		g_free (uri);
+		g_object_unref (info);
+	}
+	else
+	{
+		key = NULL;
+	}
+
+	return key;
+}
+
+/*******************************************************************************
+クラスのインスタンスを初期化します。
+*/
+static void
+viewer_cache_init (ViewerCache *self)
+{
+	g_mutex_init (&self->mutex);
+	g_cond_init (&self->cond);
+	g_queue_init (&self->queue);
+	self->pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) viewer_cache_free_pending);
+	self->table = g_hash_table_new (g_str_hash, g_str_equal);
+}
+
+/*******************************************************************************
+画像をキャッシュに追加します。任意のスレッドから呼び出せます。
+*/
+void
+viewer_cache_insert (ViewerCache *self, const char *key, ViewerImage *image)
+{
+	ViewerCacheEntry *entry;
+	GList *link;
+	g_mutex_lock (&self->mutex);
+	link = g_hash_table_lookup (self->table, key);
+
+	if (link)
+	{
+		viewer_cache_remove (self, link);
+	}
+
+	entry = g_new (ViewerCacheEntry, 1);
+	entry->key = g_strdup (key);
+	entry->image = g_object_ref (image);
+	entry->size = viewer_image_get_size (image);
+	self->size += entry->size;
+	g_queue_push_head (&self->queue, entry);
+	g_hash_table_insert (self->table, entry->key, self->queue.head);
+	viewer_cache_evict (self);
+
+	if (g_hash_table_remove (self->pending, key))
+	{
+		g_cond_broadcast (&self->cond);
+	}
+
+	g_mutex_unlock (&self->mutex);
+}
+
+/*******************************************************************************
+キャッシュから画像を取得します。任意のスレッドから呼び出せます。
+見つからない場合は NULL を返し、呼び出し元が viewer_cache_insert か
+viewer_cache_release を呼び出すまで、同じキーを検索する他のスレッドを待たせます。
+他のスレッドが読み込み中の場合は、待ち始めたときと viewer_cache_share で途中経過が渡されるたびに、
+ロックを解放して wait を呼び出します。途中経過がまだない場合は image に NULL を渡します。
+待っている間に cancellable が取り消された場合は、error を設定して NULL を返します。この場合は読み込みを引き受けません。
+*/
+ViewerImage *
+viewer_cache_lookup (ViewerCache *self, const char *key, GCancellable *cancellable, ViewerCacheWaitFunc wait, gpointer user_data, GError **error)
+{
+	ViewerCacheEntry *entry;
+	ViewerCachePending *pending;
+	ViewerImage *image, *partial;
+	GList *link;
+	gsize size;
+	guint stamp;
+	stamp = G_MAXUINT;
+	g_mutex_lock (&self->mutex);
+
+	while (!(link = g_hash_table_lookup (self->table, key)) && (pending = g_hash_table_lookup (self->pending, key)) && !g_cancellable_is_cancelled (cancellable))
+	{
+		if (wait && (pending->stamp != stamp))
+		{
+			stamp = pending->stamp;
+			partial = pending->image ? g_object_ref (pending->image) : NULL;
+			g_mutex_unlock (&self->mutex);
+			wait (partial, user_data);
+			g_clear_object (&partial);
+			g_mutex_lock (&self->mutex);
+		}
+		else
+		{
+			g_cond_wait_until (&self->cond, &self->mutex, g_get_monotonic_time () + CACHE_WAIT);
+		}
+	}
+
+	if (link)
+	{
+		entry = link->data;
+		image = g_object_ref (entry->image);
+		size = viewer_image_get_size (image);
+		self->size += size - entry->size;
+		entry->size = size;
+		g_queue_unlink (&self->queue, link);
+		g_queue_push_head_link (&self->queue, link);
+		viewer_cache_evict (self);
+	}
+	else if (g_cancellable_set_error_if_cancelled (cancellable, error))
+	{
+		image = NULL;
+	}
+	else
+	{
+		image = NULL;
+		g_hash_table_insert (self->pending, g_strdup (key), g_new0 (ViewerCachePending, 1));
+	}
+
+	g_mutex_unlock (&self->mutex);
+	viewer_trace_count (image ? TRACE_HIT : TRACE_MISS, 1);
+	return image;
+}
+
+/*******************************************************************************
+クラスのインスタンスを作成します。capacity はバイト単位の容量です。
+*/
+ViewerCache *
+viewer_cache_new (gsize capacity)
+{
+	ViewerCache *self;
+	self = g_object_new (VIEWER_TYPE_CACHE, NULL);
+	self->capacity = capacity;
+	return self;
+}
+
+/*******************************************************************************
+viewer_cache_lookup で見つからなかった画像を追加しないことを通知します。
+*/
+void
+viewer_cache_release (ViewerCache *self, const char *key)
+{
+	g_mutex_lock (&self->mutex);
+
+	if (g_hash_table_remove (self->pending, key))
+	{
+		g_cond_broadcast (&self->cond);
+	}
+
+	g_mutex_unlock (&self->mutex);
+}
+
+/*******************************************************************************
+項目を削除します。呼び出し元はロックを保持します。
+*/
+static void
+viewer_cache_remove (ViewerCache *self, GList *link)
+{
+	ViewerCacheEntry *entry;
+	entry = link->data;
+	g_hash_table_remove (self->table, entry->key);
+	g_queue_delete_link (&self->queue, link);
+	self->size -= entry->size;
+	viewer_cache_free_entry (entry);
+}
+
+/*******************************************************************************
+バイト単位の容量を設定します。
+*/
+void
+viewer_cache_set_capacity (ViewerCache *self, gsize capacity)
+{
+	g_mutex_lock (&self->mutex);
+	self->capacity = capacity;
+	viewer_cache_evict (self);
+	g_mutex_unlock (&self->mutex);
+}
+
+/*******************************************************************************
+viewer_cache_lookup で見つからなかった画像の読み込み途中の画像を、同じキーを待っている他のスレッドに渡します。
+画像を作成したときと画素を書き込むたびに呼び出します。任意のスレッドから呼び出せます。
+*/
+void
+viewer_cache_share (ViewerCache *self, const char *key, ViewerImage *image)
+{
+	ViewerCachePending *pending;
+	g_mutex_lock (&self->mutex);
+	pending = g_hash_table_lookup (self->pending, key);
+
+	if (pending)
+	{
+		g_set_object (&pending->image, image);
+		pending->stamp++;
+		g_cond_broadcast (&self->cond);
+	}
+
+	g_mutex_unlock (&self->mutex);
+}
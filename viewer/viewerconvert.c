@@ -0,0 +1,403 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include "viewer.h"
+#if defined (__x86_64__) || defined (__i386__)
+#include <immintrin.h>
+#define CONVERT_X86
+#elif defined (__aarch64__) && (G_BYTE_ORDER == G_LITTLE_ENDIAN)
+#include <arm_neon.h>
+#define CONVERT_NEON
+#endif
+#define CONVERT_ALPHA     0xFF000000U
+#define CONVERT_ENV       "VIEWER_CONVERT"
+#define CONVERT_OPAQUE    255
+#define CONVERT_RGB       3
+#define CONVERT_RGBA      4
+
+/* 変換関数の組 */
+typedef struct _ViewerConvertEntry ViewerConvertEntry;
+
+struct _ViewerConvertEntry
+{
+	const char       *name;
+	ViewerConvertFunc rgb;
+	ViewerConvertFunc rgba;
+};
+
+static gpointer viewer_convert_choose       (gpointer data);
+static gboolean viewer_convert_get_enabled  (ViewerConvertPath path);
+static guint    viewer_convert_premultiply  (guint color, guint alpha);
+static void     viewer_convert_rgb_scalar   (const guchar *source, guchar *destination, int width);
+static void     viewer_convert_rgba_scalar  (const guchar *source, guchar *destination, int width);
+#ifdef CONVERT_X86
+static void     viewer_convert_rgb_avx2     (const guchar *source, guchar *destination, int width);
+static void     viewer_convert_rgba_avx2    (const guchar *source, guchar *destination, int width);
+static void     viewer_convert_rgba_sse2    (const guchar *source, guchar *destination, int width);
+#endif
+#ifdef CONVERT_NEON
+static void     viewer_convert_rgb_neon     (const guchar *source, guchar *destination, int width);
+static void     viewer_convert_rgba_neon    (const guchar *source, guchar *destination, int width);
+#endif
+
+/* 命令セットごとの変換関数 */
+static const ViewerConvertEntry
+CONVERT_ENTRIES [VIEWER_CONVERT_N_PATHS] =
+{
+	{ "scalar", viewer_convert_rgb_scalar, viewer_convert_rgba_scalar },
+#ifdef CONVERT_X86
+	{ "sse2",   viewer_convert_rgb_scalar, viewer_convert_rgba_sse2   },
+	{ "avx2",   viewer_convert_rgb_avx2,   viewer_convert_rgba_avx2   },
+#else
+	{ "sse2",   NULL,                      NULL                       },
+	{ "avx2",   NULL,                      NULL                       },
+#endif
+#ifdef CONVERT_NEON
+	{ "neon",   viewer_convert_rgb_neon,   viewer_convert_rgba_neon   },
+#else
+	{ "neon",   NULL,                      NULL                       },
+#endif
+};
+
+/*******************************************************************************
+実行中の CPU で使用できる最速の変換関数を選択します。
+環境変数 VIEWER_CONVERT で命令セットを固定できます。
+*/
+static gpointer
+viewer_convert_choose (gpointer data)
+{
+	const char *name;
+	int path, chosen;
+	name = g_getenv (CONVERT_ENV);
+	chosen = VIEWER_CONVERT_PATH_SCALAR;
+
+	for (path = 0; path < VIEWER_CONVERT_N_PATHS; path++)
+	{
+		if (viewer_convert_get_enabled (path))
+		{
+			if (name)
+			{
+				if (!g_strcmp0 (name, CONVERT_ENTRIES [path].name))
+				{
+					chosen = path;
+				}
+			}
+			else
+			{
+				chosen = path;
+			}
+		}
+	}
+
+	return (gpointer) &CONVERT_ENTRIES [chosen];
+}
+
+/*******************************************************************************
+指定した命令セットを実行中の CPU で使用できるかどうかを取得します。
+*/
+static gboolean
+viewer_convert_get_enabled (ViewerConvertPath path)
+{
+	gboolean enabled;
+
+	switch (path)
+	{
+	case VIEWER_CONVERT_PATH_SCALAR:
+		enabled = TRUE;
+		break;
+#ifdef CONVERT_X86
+	case VIEWER_CONVERT_PATH_SSE2:
+		enabled = __builtin_cpu_supports ("sse2");
+		break;
+	case VIEWER_CONVERT_PATH_AVX2:
+		enabled = __builtin_cpu_supports ("avx2");
+		break;
+#endif
+#ifdef CONVERT_NEON
+	case VIEWER_CONVERT_PATH_NEON:
+		enabled = TRUE;
+		break;
+#endif
+	default:
+		enabled = FALSE;
+		break;
+	}
+
+	return enabled;
+}
+
+/*******************************************************************************
+指定した命令セットの変換関数を取得します。
+使用できない場合は NULL を返します。
+*/
+ViewerConvertFunc
+viewer_convert_get_func (ViewerConvertPath path, int n_channels)
+{
+	ViewerConvertFunc func;
+
+	if (viewer_convert_get_enabled (path))
+	{
+		func = (n_channels == CONVERT_RGBA) ? CONVERT_ENTRIES [path].rgba : CONVERT_ENTRIES [path].rgb;
+	}
+	else
+	{
+		func = NULL;
+	}
+
+	return func;
+}
+
+/*******************************************************************************
+命令セットの名前を取得します。
+*/
+const char *
+viewer_convert_get_name (ViewerConvertPath path)
+{
+	return CONVERT_ENTRIES [path].name;
+}
+
+/*******************************************************************************
+ARGB32 の画像を縦横半分に縮小します。4 画素の平均を求めます。
+幅または高さが奇数の場合は端の画素を繰り返します。
+*/
+void
+viewer_convert_halve (const guchar *source, int source_stride, int source_width, int source_height, guchar *destination, int destination_stride)
+{
+	const guint32 *top, *bottom;
+	guint32 *dest;
+	guint32 a, b, c, d, low, high;
+	int x, y, x1, width, height;
+	width = (source_width + 1) / 2;
+	height = (source_height + 1) / 2;
+
+	for (y = 0; y < height; y++)
+	{
+		top = (const guint32 *) (source + (gsize) (2 * y) * source_stride);
+		bottom = (const guint32 *) (source + (gsize) MIN (2 * y + 1, source_height - 1) * source_stride);
+		dest = (guint32 *) (destination + (gsize) y * destination_stride);
+
+		for (x = 0; x < width; x++)
+		{
+			x1 = MIN (2 * x + 1, source_width - 1);
+			a = top [2 * x];
+			b = top [x1];
+			c = bottom [2 * x];
+			d = bottom [x1];
+			low = (a & 0x00FF00FFU) + (b & 0x00FF00FFU) + (c & 0x00FF00FFU) + (d & 0x00FF00FFU) + 0x00020002U;
+			high = ((a >> 8) & 0x00FF00FFU) + ((b >> 8) & 0x00FF00FFU) + ((c >> 8) & 0x00FF00FFU) + ((d >> 8) & 0x00FF00FFU) + 0x00020002U;
+			*(dest++) = ((low >> 2) & 0x00FF00FFU) | (((high >> 2) & 0x00FF00FFU) << 8);
+		}
+	}
+}
+
+/*******************************************************************************
+RGB または RGBA の画素を乗算済み ARGB32 に変換します。
+*/
+void
+viewer_convert_pixels (const guchar *source, int source_stride, int n_channels, guchar *destination, int destination_stride, int width, int height)
+{
+	static GOnce once = G_ONCE_INIT;
+	const ViewerConvertEntry *entry;
+	ViewerConvertFunc func;
+	int y;
+	entry = g_once (&once, viewer_convert_choose, NULL);
+	func = (n_channels == CONVERT_RGBA) ? entry->rgba : entry->rgb;
+
+	for (y = 0; y < height; y++)
+	{
+		func (source, destination, width);
+		source += source_stride;
+		destination += destination_stride;
+	}
+}
+
+/*******************************************************************************
+乗算済みアルファに変換します。
+*/
+static guint
+viewer_convert_premultiply (guint color, guint alpha)
+{
+	guint value;
+	value = color * alpha + 128;
+	return (value + (value >> 8)) >> 8;
+}
+
+/*******************************************************************************
+RGB の 1 行を ARGB32 に変換します。
+*/
+static void
+viewer_convert_rgb_scalar (const guchar *source, guchar *destination, int width)
+{
+	guint32 *dest;
+	int x;
+	dest = (guint32 *) destination;
+
+	for (x = 0; x < width; x++)
+	{
+		*(dest++) = CONVERT_ALPHA | ((guint32) source [0] << 16) | ((guint32) source [1] << 8) | source [2];
+		source += CONVERT_RGB;
+	}
+}
+
+/*******************************************************************************
+RGBA の 1 行を乗算済み ARGB32 に変換します。
+ほかの変換関数はこの結果と一致しなければなりません。
+*/
+static void
+viewer_convert_rgba_scalar (const guchar *source, guchar *destination, int width)
+{
+	guint32 *dest;
+	guint alpha;
+	int x;
+	dest = (guint32 *) destination;
+
+	for (x = 0; x < width; x++)
+	{
+		alpha = source [3];
+		*(dest++) =
+			(alpha << 24) |
+			(viewer_convert_premultiply (source [0], alpha) << 16) |
+			(viewer_convert_premultiply (source [1], alpha) << 8) |
+			(viewer_convert_premultiply (source [2], alpha));
+		source += CONVERT_RGBA;
+	}
+}
+
+#ifdef CONVERT_X86
+/*******************************************************************************
+RGB の 1 行を ARGB32 に変換します。(AVX2)
+*/
+__attribute__ ((target ("avx2")))
+static void
+viewer_convert_rgb_avx2 (const guchar *source, guchar *destination, int width)
+{
+	__m128i alpha, mask, pixels;
+	int x;
+	alpha = _mm_set1_epi32 ((int) CONVERT_ALPHA);
+	mask = _mm_setr_epi8 (2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1);
+
+	/* 16 バイトを読み込むため、末尾の 2 画素はスカラーで変換します。 */
+	for (x = 0; x + 6 <= width; x += 4)
+	{
+		pixels = _mm_loadu_si128 ((const __m128i *) (source + x * CONVERT_RGB));
+		pixels = _mm_or_si128 (_mm_shuffle_epi8 (pixels, mask), alpha);
+		_mm_storeu_si128 ((__m128i *) (destination + x * CONVERT_RGBA), pixels);
+	}
+
+	viewer_convert_rgb_scalar (source + x * CONVERT_RGB, destination + x * CONVERT_RGBA, width - x);
+}
+
+/*******************************************************************************
+RGBA の 1 行を乗算済み ARGB32 に変換します。(AVX2)
+*/
+__attribute__ ((target ("avx2")))
+static void
+viewer_convert_rgba_avx2 (const guchar *source, guchar *destination, int width)
+{
+	__m256i bias, high, low, mask, opaque, pixels, zero;
+	int x;
+	zero = _mm256_setzero_si256 ();
+	bias = _mm256_set1_epi16 (128);
+	mask = _mm256_set1_epi64x (0x0000FFFFFFFFFFFFLL);
+	opaque = _mm256_set1_epi64x (0x00FF000000000000LL);
+
+	for (x = 0; x + 8 <= width; x += 8)
+	{
+		pixels = _mm256_loadu_si256 ((const __m256i *) (source + x * CONVERT_RGBA));
+		low = _mm256_unpacklo_epi8 (pixels, zero);
+		high = _mm256_unpackhi_epi8 (pixels, zero);
+		low = _mm256_add_epi16 (_mm256_mullo_epi16 (low, _mm256_or_si256 (_mm256_and_si256 (_mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 (low, 0xFF), 0xFF), mask), opaque)), bias);
+		high = _mm256_add_epi16 (_mm256_mullo_epi16 (high, _mm256_or_si256 (_mm256_and_si256 (_mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 (high, 0xFF), 0xFF), mask), opaque)), bias);
+		low = _mm256_srli_epi16 (_mm256_add_epi16 (low, _mm256_srli_epi16 (low, 8)), 8);
+		high = _mm256_srli_epi16 (_mm256_add_epi16 (high, _mm256_srli_epi16 (high, 8)), 8);
+		low = _mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 (low, 0xC6), 0xC6);
+		high = _mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 (high, 0xC6), 0xC6);
+		_mm256_storeu_si256 ((__m256i *) (destination + x * CONVERT_RGBA), _mm256_packus_epi16 (low, high));
+	}
+
+	viewer_convert_rgba_scalar (source + x * CONVERT_RGBA, destination + x * CONVERT_RGBA, width - x);
+}
+
+/*******************************************************************************
+RGBA の 1 行を乗算済み ARGB32 に変換します。(SSE2)
+*/
+__attribute__ ((target ("sse2")))
+static void
+viewer_convert_rgba_sse2 (const guchar *source, guchar *destination, int width)
+{
+	__m128i bias, high, low, mask, opaque, pixels, zero;
+	int x;
+	zero = _mm_setzero_si128 ();
+	bias = _mm_set1_epi16 (128);
+	mask = _mm_set_epi32 (0x0000FFFF, (int) 0xFFFFFFFF, 0x0000FFFF, (int) 0xFFFFFFFF);
+	opaque = _mm_set_epi32 (0x00FF0000, 0, 0x00FF0000, 0);
+
+	for (x = 0; x + 4 <= width; x += 4)
+	{
+		pixels = _mm_loadu_si128 ((const __m128i *) (source + x * CONVERT_RGBA));
+		low = _mm_unpacklo_epi8 (pixels, zero);
+		high = _mm_unpackhi_epi8 (pixels, zero);
+		low = _mm_add_epi16 (_mm_mullo_epi16 (low, _mm_or_si128 (_mm_and_si128 (_mm_shufflehi_epi16 (_mm_shufflelo_epi16 (low, 0xFF), 0xFF), mask), opaque)), bias);
+		high = _mm_add_epi16 (_mm_mullo_epi16 (high, _mm_or_si128 (_mm_and_si128 (_mm_shufflehi_epi16 (_mm_shufflelo_epi16 (high, 0xFF), 0xFF), mask), opaque)), bias);
+		low = _mm_srli_epi16 (_mm_add_epi16 (low, _mm_srli_epi16 (low, 8)), 8);
+		high = _mm_srli_epi16 (_mm_add_epi16 (high, _mm_srli_epi16 (high, 8)), 8);
+		low = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (low, 0xC6), 0xC6);
+		high = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (high, 0xC6), 0xC6);
+		_mm_storeu_si128 ((__m128i *) (destination + x * CONVERT_RGBA), _mm_packus_epi16 (low, high));
+	}
+
+	viewer_convert_rgba_scalar (source + x * CONVERT_RGBA, destination + x * CONVERT_RGBA, width - x);
+}
+#endif
+
+#ifdef CONVERT_NEON
+/*******************************************************************************
+RGB の 1 行を ARGB32 に変換します。(NEON)
+*/
+static void
+viewer_convert_rgb_neon (const guchar *source, guchar *destination, int width)
+{
+	uint8x16x3_t pixels;
+	uint8x16x4_t result;
+	int x;
+	result.val [3] = vdupq_n_u8 (CONVERT_OPAQUE);
+
+	for (x = 0; x + 16 <= width; x += 16)
+	{
+		pixels = vld3q_u8 (source + x * CONVERT_RGB);
+		result.val [0] = pixels.val [2];
+		result.val [1] = pixels.val [1];
+		result.val [2] = pixels.val [0];
+		vst4q_u8 (destination + x * CONVERT_RGBA, result);
+	}
+
+	viewer_convert_rgb_scalar (source + x * CONVERT_RGB, destination + x * CONVERT_RGBA, width - x);
+}
+
+/*******************************************************************************
+RGBA の 1 行を乗算済み ARGB32 に変換します。(NEON)
+*/
+static void
+viewer_convert_rgba_neon (const guchar *source, guchar *destination, int width)
+{
+	uint8x16x4_t pixels, result;
+	uint16x8_t high, low;
+	int x, n;
+
+	for (x = 0; x + 16 <= width; x += 16)
+	{
+		pixels = vld4q_u8 (source + x * CONVERT_RGBA);
+
+		for (n = 0; n < 3; n++)
+		{
+			low = vmull_u8 (vget_low_u8 (pixels.val [n]), vget_low_u8 (pixels.val [3]));
+			high = vmull_u8 (vget_high_u8 (pixels.val [n]), vget_high_u8 (pixels.val [3]));
+			result.val [2 - n] = vcombine_u8 (vraddhn_u16 (low, vrshrq_n_u16 (low, 8)), vraddhn_u16 (high, vrshrq_n_u16 (high, 8)));
+		}
+
+		result.val [3] = pixels.val [3];
+		vst4q_u8 (destination + x * CONVERT_RGBA, result);
+	}
+
+	viewer_convert_rgba_scalar (source + x * CONVERT_RGBA, destination + x * CONVERT_RGBA, width - x);
+}
+#endif
@@ -0,0 +1,447 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include <math.h>
+#include <string.h>
+#include "viewer.h"
+#define DEEP_ALPHA         0xFF000000U
+#define DEEP_HIGH          0.999
+#define DEEP_LEVELS        65536
+#define DEEP_LOW           0.001
+#define DEEP_MAX           65535.0F
+#define DEEP_OPAQUE        255
+#define DEEP_SAMPLES       256
+#define PNG_DEPTH_OFFSET   24
+#define PNG_MAGIC          "\x89PNG\r\n\x1A\n"
+#define PNG_MAGIC_SIZE     8
+#define TIFF_BIG_ENDIAN    "MM\0\x2A"
+#define TIFF_LITTLE_ENDIAN "II\x2A\0"
+#define TIFF_MAGIC_SIZE    4
+#define TRACE_OPEN         "deep-open"
+#define TRACE_TONE         "deep-tone"
+
+typedef struct _ViewerDeep ViewerDeep;
+
+/* 8 ビットを超える精度の画素と表示範囲 */
+struct _ViewerDeep
+{
+	GBytes          *bytes;
+	const guchar    *pixels;
+	guchar          *table;
+	gsize            stride;
+	ViewerDeepFormat format;
+	int              width;
+	int              height;
+	float            black;
+	float            white;
+	float            low;
+	float            high;
+};
+
+static ViewerDeep *viewer_deep_copy       (const ViewerDeep *source, float black, float white);
+static void        viewer_deep_free       (ViewerDeep *self);
+static int         viewer_deep_get_pixel  (ViewerDeepFormat format);
+static void        viewer_deep_measure    (ViewerDeep *self);
+static void        viewer_deep_read       (gpointer data, int level, int x, int y, int width, int height, guchar *destination, int destination_stride);
+static int         viewer_deep_sort       (gconstpointer a, gconstpointer b);
+static void        viewer_deep_tone16     (const ViewerDeep *self, const guint16 *source, guint32 *destination, int width, int n_channels);
+static void        viewer_deep_tone_float (const ViewerDeep *self, const float *source, guint32 *destination, int width, int n_channels);
+
+/*******************************************************************************
+表示範囲を変えた複製を作成します。画素は共有します。
+16 ビットの画素には、全ての値から 8 ビットへの対応表を作成します。
+*/
+static ViewerDeep *
+viewer_deep_copy (const ViewerDeep *source, float black, float white)
+{
+	ViewerDeep *self;
+	float scale;
+	int value;
+	self = g_memdup2 (source, sizeof (ViewerDeep));
+	self->bytes = g_bytes_ref (source->bytes);
+	self->table = NULL;
+	self->black = black;
+	self->white = white;
+
+	if ((self->format == VIEWER_DEEP_GRAY16) || (self->format == VIEWER_DEEP_RGBA16))
+	{
+		self->table = g_malloc (DEEP_LEVELS);
+		scale = DEEP_OPAQUE / (MAX (white - black, G_MINFLOAT) * DEEP_MAX);
+
+		for (value = 0; value < DEEP_LEVELS; value++)
+		{
+			self->table [value] = CLAMP ((value - black * DEEP_MAX) * scale + 0.5F, 0.0F, DEEP_OPAQUE);
+		}
+	}
+
+	return self;
+}
+
+/*******************************************************************************
+画素の参照と対応表を破棄します。
+*/
+static void
+viewer_deep_free (ViewerDeep *self)
+{
+	g_bytes_unref (self->bytes);
+	g_free (self->table);
+	g_free (self);
+}
+
+/*******************************************************************************
+1 画素のバイト数を取得します。
+*/
+static int
+viewer_deep_get_pixel (ViewerDeepFormat format)
+{
+	switch (format)
+	{
+	case VIEWER_DEEP_GRAY16:
+		return sizeof (guint16);
+	case VIEWER_DEEP_RGBA16:
+		return 4 * sizeof (guint16);
+	case VIEWER_DEEP_GRAY_FLOAT:
+		return sizeof (float);
+	default:
+		return 4 * sizeof (float);
+	}
+}
+
+/*******************************************************************************
+画像の値の大部分が収まる範囲を取得します。値は 0 から 1 に正規化しています。
+8 ビットを超える精度の画像でない場合は FALSE を返します。
+*/
+gboolean
+viewer_deep_get_range (ViewerImage *image, float *low, float *high)
+{
+	ViewerDeep *self;
+	self = viewer_image_get_reader (image, viewer_deep_read);
+
+	if (self)
+	{
+		*low = self->low;
+		*high = self->high;
+	}
+
+	return self != NULL;
+}
+
+/*******************************************************************************
+格子状に間引いた画素から、値の大部分が収まる範囲を求めます。
+アルファ チャネルは除き、外れ値に引きずられないように上下の端を切り捨てます。
+*/
+static void
+viewer_deep_measure (ViewerDeep *self)
+{
+	GArray *values;
+	const guchar *row;
+	float value;
+	int x, y, channel, n_channels, step, step_x, step_y;
+	step = ((self->format == VIEWER_DEEP_RGBA16) || (self->format == VIEWER_DEEP_RGBA_FLOAT)) ? 4 : 1;
+	n_channels = MIN (step, 3);
+	step_x = MAX (1, self->width / DEEP_SAMPLES);
+	step_y = MAX (1, self->height / DEEP_SAMPLES);
+	values = g_array_new (FALSE, FALSE, sizeof (float));
+
+	for (y = 0; y < self->height; y += step_y)
+	{
+		row = self->pixels + (gsize) y * self->stride;
+
+		for (x = 0; x < self->width; x += step_x)
+		{
+			for (channel = 0; channel < n_channels; channel++)
+			{
+				switch (self->format)
+				{
+				case VIEWER_DEEP_GRAY16:
+				case VIEWER_DEEP_RGBA16:
+					value = ((const guint16 *) row) [x * step + channel] / DEEP_MAX;
+					break;
+				default:
+					value = ((const float *) row) [x * step + channel];
+					break;
+				}
+
+				if (isfinite (value))
+				{
+					g_array_append_val (values, value);
+				}
+			}
+		}
+	}
+
+	if (values->len)
+	{
+		g_array_sort (values, viewer_deep_sort);
+		self->low = g_array_index (values, float, (guint) (DEEP_LOW * (values->len - 1)));
+		self->high = g_array_index (values, float, (guint) (DEEP_HIGH * (values->len - 1)));
+	}
+	if (!(self->high > self->low))
+	{
+		self->low = 0.0F;
+		self->high = 1.0F;
+	}
+
+	g_array_unref (values);
+}
+
+/*******************************************************************************
+8 ビットを超える精度の画素から画像を作成します。画素は bytes の offset から始まり、
+複製せずに参照します。画素はアルファを乗算していないものとします。
+表示範囲ははじめ、値の大部分が収まる範囲にします。bytes の大きさは画像のメモリの大きさに含めます。
+8 ビットへの変換は区画を表示するときに、その区画だけ行います。
+*/
+ViewerImage *
+viewer_deep_new (GBytes *bytes, gsize offset, ViewerDeepFormat format, int width, int height, gsize stride)
+{
+	ViewerDeep prototype = { 0 };
+	ViewerDeep *self;
+	prototype.bytes = bytes;
+	prototype.pixels = (const guchar *) g_bytes_get_data (bytes, NULL) + offset;
+	prototype.stride = stride;
+	prototype.format = format;
+	prototype.width = width;
+	prototype.height = height;
+	viewer_deep_measure (&prototype);
+	self = viewer_deep_copy (&prototype, prototype.low, prototype.high);
+	return viewer_image_new_lazy (width, height, viewer_deep_read, self, g_bytes_get_size (bytes), (GDestroyNotify) viewer_deep_free);
+}
+
+/*******************************************************************************
+8 ビットを超える精度の画素を持つ可能性がある画像ファイルを開きます。任意のスレッドから呼び出せます。
+16 ビットの PNG と TIFF を GdkTexture で読み込み、精度を保ったまま保持します。灰色の画像は灰色のまま保持します。
+TIFF の画素が 8 ビットの場合は、そのまま通常の画像にします。
+これらの形式でない場合と読み込めない場合は NULL を返します。
+*/
+ViewerImage *
+viewer_deep_open (GFile *file)
+{
+	GdkTextureDownloader *downloader;
+	GFileInputStream *input;
+	GdkTexture *texture;
+	ViewerImage *image;
+	GBytes *bytes;
+	guchar head [PNG_DEPTH_OFFSET + 1];
+	gsize length, stride;
+	gint64 begin;
+	begin = viewer_trace_begin ();
+	input = g_file_read (file, NULL, NULL);
+	length = 0;
+	texture = NULL;
+	image = NULL;
+
+	if (input)
+	{
+		g_input_stream_read_all (G_INPUT_STREAM (input), head, sizeof head, &length, NULL, NULL);
+		g_object_unref (input);
+	}
+	if (((length > PNG_DEPTH_OFFSET) && !memcmp (head, PNG_MAGIC, PNG_MAGIC_SIZE) && (head [PNG_DEPTH_OFFSET] == 16)) || ((length >= TIFF_MAGIC_SIZE) && (!memcmp (head, TIFF_BIG_ENDIAN, TIFF_MAGIC_SIZE) || !memcmp (head, TIFF_LITTLE_ENDIAN, TIFF_MAGIC_SIZE))))
+	{
+		texture = gdk_texture_new_from_file (file, NULL);
+	}
+	if (texture)
+	{
+		downloader = gdk_texture_downloader_new (texture);
+
+		switch (gdk_texture_get_format (texture))
+		{
+		case GDK_MEMORY_R16G16B16:
+		case GDK_MEMORY_R16G16B16A16:
+		case GDK_MEMORY_R16G16B16A16_PREMULTIPLIED:
+		case GDK_MEMORY_G16A16:
+		case GDK_MEMORY_G16A16_PREMULTIPLIED:
+		case GDK_MEMORY_A16:
+			gdk_texture_downloader_set_format (downloader, GDK_MEMORY_R16G16B16A16);
+			bytes = gdk_texture_downloader_download_bytes (downloader, &stride);
+			image = viewer_deep_new (bytes, 0, VIEWER_DEEP_RGBA16, gdk_texture_get_width (texture), gdk_texture_get_height (texture), stride);
+			break;
+		case GDK_MEMORY_G16:
+			gdk_texture_downloader_set_format (downloader, GDK_MEMORY_G16);
+			bytes = gdk_texture_downloader_download_bytes (downloader, &stride);
+			image = viewer_deep_new (bytes, 0, VIEWER_DEEP_GRAY16, gdk_texture_get_width (texture), gdk_texture_get_height (texture), stride);
+			break;
+		case GDK_MEMORY_R16G16B16_FLOAT:
+		case GDK_MEMORY_R16G16B16A16_FLOAT:
+		case GDK_MEMORY_R16G16B16A16_FLOAT_PREMULTIPLIED:
+		case GDK_MEMORY_R32G32B32_FLOAT:
+		case GDK_MEMORY_R32G32B32A32_FLOAT:
+		case GDK_MEMORY_R32G32B32A32_FLOAT_PREMULTIPLIED:
+		case GDK_MEMORY_A16_FLOAT:
+		case GDK_MEMORY_A32_FLOAT:
+			gdk_texture_downloader_set_format (downloader, GDK_MEMORY_R32G32B32A32_FLOAT);
+			bytes = gdk_texture_downloader_download_bytes (downloader, &stride);
+			image = viewer_deep_new (bytes, 0, VIEWER_DEEP_RGBA_FLOAT, gdk_texture_get_width (texture), gdk_texture_get_height (texture), stride);
+			break;
+		default:
+			gdk_texture_downloader_set_format (downloader, GDK_MEMORY_R8G8B8A8);
+			bytes = gdk_texture_downloader_download_bytes (downloader, &stride);
+			image = viewer_image_new (gdk_texture_get_width (texture), gdk_texture_get_height (texture));
+			viewer_image_write (image, g_bytes_get_data (bytes, NULL), stride, 4, 0, 0, gdk_texture_get_width (texture), gdk_texture_get_height (texture));
+			break;
+		}
+
+		g_bytes_unref (bytes);
+		gdk_texture_downloader_free (downloader);
+		g_object_unref (texture);
+	}
+
+	viewer_trace_end (TRACE_OPEN, begin, image ? (gint64) viewer_image_get_width (image) * viewer_image_get_height (image) : 0);
+	return image;
+}
+
+/*******************************************************************************
+区画の範囲の画素を表示範囲に合わせて 8 ビットへ変換します。
+縮小画像の画素は元の画像の画素をそのまま使用します。
+*/
+static void
+viewer_deep_read (gpointer data, int level, int x, int y, int width, int height, guchar *destination, int destination_stride)
+{
+	ViewerDeep *self;
+	const guchar *row;
+	guchar *buffer;
+	gint64 begin;
+	int column, line, n_channels, pixel;
+	begin = viewer_trace_begin ();
+	self = data;
+	pixel = viewer_deep_get_pixel (self->format);
+	n_channels = ((self->format == VIEWER_DEEP_RGBA16) || (self->format == VIEWER_DEEP_RGBA_FLOAT)) ? 4 : 1;
+	buffer = level ? g_malloc ((gsize) width * pixel) : NULL;
+
+	for (line = 0; line < height; line++)
+	{
+		row = self->pixels + MIN ((gint64) (y + line) << level, self->height - 1) * self->stride;
+
+		if (buffer)
+		{
+			for (column = 0; column < width; column++)
+			{
+				memcpy (buffer + column * pixel, row + MIN ((gint64) (x + column) << level, self->width - 1) * pixel, pixel);
+			}
+
+			row = buffer;
+		}
+		else
+		{
+			row += (gsize) x * pixel;
+		}
+		if ((self->format == VIEWER_DEEP_GRAY16) || (self->format == VIEWER_DEEP_RGBA16))
+		{
+			viewer_deep_tone16 (self, (const guint16 *) row, (guint32 *) (destination + (gsize) line * destination_stride), width, n_channels);
+		}
+		else
+		{
+			viewer_deep_tone_float (self, (const float *) row, (guint32 *) (destination + (gsize) line * destination_stride), width, n_channels);
+		}
+	}
+
+	g_free (buffer);
+	viewer_trace_end (TRACE_TONE, begin, (gint64) width * height);
+}
+
+/*******************************************************************************
+浮動小数点数を比較します。
+*/
+static int
+viewer_deep_sort (gconstpointer a, gconstpointer b)
+{
+	float value1, value2;
+	value1 = *(const float *) a;
+	value2 = *(const float *) b;
+	return (value1 > value2) - (value1 < value2);
+}
+
+/*******************************************************************************
+1 行の 16 ビットの画素を対応表で ARGB32 へ変換します。
+*/
+static void
+viewer_deep_tone16 (const ViewerDeep *self, const guint16 *source, guint32 *destination, int width, int n_channels)
+{
+	const guchar *table;
+	guint alpha;
+	int x;
+	table = self->table;
+
+	if (n_channels == 1)
+	{
+		for (x = 0; x < width; x++)
+		{
+			destination [x] = DEEP_ALPHA | (table [source [x]] * 0x010101U);
+		}
+	}
+	else
+	{
+		for (x = 0; x < width; x++, source += 4)
+		{
+			alpha = source [3] >> 8;
+
+			if (alpha == DEEP_OPAQUE)
+			{
+				destination [x] = DEEP_ALPHA | ((guint32) table [source [0]] << 16) | ((guint32) table [source [1]] << 8) | table [source [2]];
+			}
+			else
+			{
+				destination [x] = ((guint32) alpha << 24) | ((guint32) ((table [source [0]] * alpha + 127) / DEEP_OPAQUE) << 16) | ((guint32) ((table [source [1]] * alpha + 127) / DEEP_OPAQUE) << 8) | ((table [source [2]] * alpha + 127) / DEEP_OPAQUE);
+			}
+		}
+	}
+}
+
+/*******************************************************************************
+1 行の浮動小数点数の画素を表示範囲に合わせて ARGB32 へ変換します。
+分岐のない演算だけで書き、コンパイラーがベクトル化できるようにしています。
+*/
+static void
+viewer_deep_tone_float (const ViewerDeep *self, const float *source, guint32 *destination, int width, int n_channels)
+{
+	float scale, offset, alpha, red, green, blue;
+	int x;
+	scale = DEEP_OPAQUE / MAX (self->white - self->black, G_MINFLOAT);
+	offset = -self->black * scale;
+
+	if (n_channels == 1)
+	{
+		for (x = 0; x < width; x++)
+		{
+			red = CLAMP (source [x] * scale + offset, 0.0F, DEEP_OPAQUE);
+			destination [x] = DEEP_ALPHA | ((guint32) (red + 0.5F) * 0x010101U);
+		}
+	}
+	else
+	{
+		for (x = 0; x < width; x++, source += 4)
+		{
+			alpha = CLAMP (source [3], 0.0F, 1.0F);
+			red = CLAMP (source [0] * scale + offset, 0.0F, DEEP_OPAQUE) * alpha;
+			green = CLAMP (source [1] * scale + offset, 0.0F, DEEP_OPAQUE) * alpha;
+			blue = CLAMP (source [2] * scale + offset, 0.0F, DEEP_OPAQUE) * alpha;
+			destination [x] = ((guint32) (alpha * DEEP_OPAQUE + 0.5F) << 24) | ((guint32) (red + 0.5F) << 16) | ((guint32) (green + 0.5F) << 8) | (guint32) (blue + 0.5F);
+		}
+	}
+}
+
+/*******************************************************************************
+表示範囲を変えて表示するための画像を取得します。値は 0 から 1 に正規化しています。
+作成する画像は画素を元の画像と共有し、区画だけを別に持つので、キャッシュで共有している元の画像の表示は変わりません。
+範囲が元の画像と同じ場合は元の画像を返します。8 ビットを超える精度の画像でない場合は NULL を返します。
+*/
+ViewerImage *
+viewer_deep_view (ViewerImage *image, float black, float white)
+{
+	ViewerDeep *self;
+	ViewerImage *result;
+	self = viewer_image_get_reader (image, viewer_deep_read);
+
+	if (!self)
+	{
+		result = NULL;
+	}
+	else if ((self->black == black) && (self->white == white))
+	{
+		result = g_object_ref (image);
+	}
+	else
+	{
+		result = viewer_image_new_lazy (self->width, self->height, viewer_deep_read, viewer_deep_copy (self, black, white), 0, (GDestroyNotify) viewer_deep_free);
+	}
+
+	return result;
+}
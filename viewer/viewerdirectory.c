@@ -0,0 +1,257 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include "viewer.h"
+#define DIRECTORY_ATTRIBUTES G_FILE_ATTRIBUTE_STANDARD_NAME "," G_FILE_ATTRIBUTE_STANDARD_TYPE "," G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE
+#define DIRECTORY_N_FILES    256
+#define DIRECTORY_RAW_SUFFIX ".hdr"
+
+typedef struct _ViewerDirectoryEntry ViewerDirectoryEntry;
+typedef struct _ViewerDirectoryList  ViewerDirectoryList;
+
+/* ディレクトリの項目 */
+struct _ViewerDirectoryEntry
+{
+	char  *key;
+	char  *header;
+	GFile *file;
+};
+
+/* 読み取り中の一覧 */
+struct _ViewerDirectoryList
+{
+	GPtrArray  *entries;
+	GHashTable *headers;
+};
+
+static int      viewer_directory_compare        (gconstpointer a, gconstpointer b);
+static gpointer viewer_directory_create_formats (gpointer data);
+static void     viewer_directory_free_entry     (ViewerDirectoryEntry *entry);
+static void     viewer_directory_free_list      (ViewerDirectoryList *list);
+static gboolean viewer_directory_get_supported  (GFileInfo *info);
+static void     viewer_directory_next           (GObject *enumerator, GAsyncResult *result, gpointer user_data);
+static void     viewer_directory_open           (GObject *directory, GAsyncResult *result, gpointer user_data);
+static void     viewer_directory_return         (GTask *task);
+
+/*******************************************************************************
+ファイル名の順序を比較します。
+*/
+static int
+viewer_directory_compare (gconstpointer a, gconstpointer b)
+{
+	const ViewerDirectoryEntry *entry1, *entry2;
+	entry1 = *(const ViewerDirectoryEntry **) a;
+	entry2 = *(const ViewerDirectoryEntry **) b;
+	return strcmp (entry1->key, entry2->key);
+}
+
+/*******************************************************************************
+画像として開くことができる MIME タイプの一覧を作成します。
+*/
+static gpointer
+viewer_directory_create_formats (gpointer data)
+{
+	GHashTable *table;
+	GSList *formats, *format;
+	char **mime_types;
+	int n;
+	table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	formats = gdk_pixbuf_get_formats ();
+
+	for (format = formats; format; format = format->next)
+	{
+		mime_types = gdk_pixbuf_format_get_mime_types (format->data);
+
+		for (n = 0; mime_types [n]; n++)
+		{
+			g_hash_table_add (table, mime_types [n]);
+		}
+
+		g_free (mime_types);
+	}
+
+	g_slist_free (formats);
+	return table;
+}
+
+/*******************************************************************************
+項目を破棄します。
+*/
+static void
+viewer_directory_free_entry (ViewerDirectoryEntry *entry)
+{
+	g_object_unref (entry->file);
+	g_free (entry->header);
+	g_free (entry->key);
+	g_free (entry);
+}
+
+/*******************************************************************************
+読み取り中の一覧を破棄します。
+*/
+static void
+viewer_directory_free_list (ViewerDirectoryList *list)
+{
+	g_ptr_array_unref (list->entries);
+	g_hash_table_unref (list->headers);
+	g_free (list);
+}
+
+/*******************************************************************************
+画像として開くことができるファイルかどうかを取得します。
+*/
+static gboolean
+viewer_directory_get_supported (GFileInfo *info)
+{
+	static GOnce once = G_ONCE_INIT;
+	const char *content_type;
+	char *mime_type;
+	gboolean supported;
+	content_type = g_file_info_get_content_type (info);
+
+	if ((g_file_info_get_file_type (info) == G_FILE_TYPE_REGULAR) && content_type)
+	{
+		mime_type = g_content_type_get_mime_type (content_type);
+		supported = mime_type && g_hash_table_contains (g_once (&once, viewer_directory_create_formats, NULL), mime_type);
+		g_free (mime_type);
+	}
+	else
+	{
+		supported = FALSE;
+	}
+
+	return supported;
+}
+
+/*******************************************************************************
+ディレクトリにある画像ファイルの一覧を非同期に取得します。
+GdkPixbuf が対応していないファイルも、名前に .hdr を付けた説明のファイルがあれば非圧縮の画像として一覧に加えます。
+*/
+void
+viewer_directory_list_async (gpointer source_object, GFile *directory, GCancellable *cancellable, GAsyncReadyCallback callback, gpointer user_data)
+{
+	ViewerDirectoryList *list;
+	GTask *task;
+	task = g_task_new (source_object, cancellable, callback, user_data);
+	list = g_new (ViewerDirectoryList, 1);
+	list->entries = g_ptr_array_new_with_free_func ((GDestroyNotify) viewer_directory_free_entry);
+	list->headers = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	g_task_set_source_tag (task, viewer_directory_list_async);
+	g_task_set_task_data (task, list, (GDestroyNotify) viewer_directory_free_list);
+	g_file_enumerate_children_async (directory, DIRECTORY_ATTRIBUTES, G_FILE_QUERY_INFO_NONE, G_PRIORITY_DEFAULT, cancellable, viewer_directory_open, task);
+}
+
+/*******************************************************************************
+画像ファイルの一覧を取得します。各要素は GFile です。
+*/
+GPtrArray *
+viewer_directory_list_finish (GAsyncResult *result, GError **error)
+{
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/*******************************************************************************
+次の項目を読み取ります。説明のファイルは全ての項目を読み取るまで揃わないので、
+GdkPixbuf が対応していないファイルは、必要な説明のファイルの名前を添えて仮に加えておきます。
+*/
+static void
+viewer_directory_next (GObject *enumerator, GAsyncResult *result, gpointer user_data)
+{
+	ViewerDirectoryList *list;
+	ViewerDirectoryEntry *entry;
+	GFileInfo *info;
+	GError *error;
+	GList *infos, *link;
+	GTask *task;
+	const char *name;
+	task = G_TASK (user_data);
+	list = g_task_get_task_data (task);
+	error = NULL;
+	infos = g_file_enumerator_next_files_finish (G_FILE_ENUMERATOR (enumerator), result, &error);
+
+	if (infos)
+	{
+		for (link = infos; link; link = link->next)
+		{
+			info = G_FILE_INFO (link->data);
+			name = g_file_info_get_name (info);
+
+			if ((g_file_info_get_file_type (info) == G_FILE_TYPE_REGULAR) && g_str_has_suffix (name, DIRECTORY_RAW_SUFFIX))
+			{
+				g_hash_table_add (list->headers, g_strdup (name));
+			}
+			else if (g_file_info_get_file_type (info) == G_FILE_TYPE_REGULAR)
+			{
+				entry = g_new (ViewerDirectoryEntry, 1);
+				entry->key = g_utf8_collate_key_for_filename (name, -1);
+				entry->header = viewer_directory_get_supported (info) ? NULL : g_strconcat (name, DIRECTORY_RAW_SUFFIX, NULL);
+				entry->file = g_file_enumerator_get_child (G_FILE_ENUMERATOR (enumerator), info);
+				g_ptr_array_add (list->entries, entry);
+			}
+		}
+
+		g_list_free_full (infos, g_object_unref);
+		g_file_enumerator_next_files_async (G_FILE_ENUMERATOR (enumerator), DIRECTORY_N_FILES, G_PRIORITY_DEFAULT, g_task_get_cancellable (task), viewer_directory_next, task);
+	}
+	else if (error)
+	{
+		g_task_return_error (task, error);
+		g_object_unref (task);
+	}
+	else
+	{
+		viewer_directory_return (task);
+	}
+}
+
+/*******************************************************************************
+ディレクトリを開きます。
+*/
+static void
+viewer_directory_open (GObject *directory, GAsyncResult *result, gpointer user_data)
+{
+	GFileEnumerator *enumerator;
+	GError *error;
+	GTask *task;
+	task = G_TASK (user_data);
+	error = NULL;
+	enumerator = g_file_enumerate_children_finish (G_FILE (directory), result, &error);
+
+	if (enumerator)
+	{
+		g_file_enumerator_next_files_async (enumerator, DIRECTORY_N_FILES, G_PRIORITY_DEFAULT, g_task_get_cancellable (task), viewer_directory_next, task);
+		g_object_unref (enumerator);
+	}
+	else
+	{
+		g_task_return_error (task, error);
+		g_object_unref (task);
+	}
+}
+
+/*******************************************************************************
+ファイル名の順に並べた一覧を返します。仮に加えたファイルは、説明のファイルがあった場合だけ返します。
+*/
+static void
+viewer_directory_return (GTask *task)
+{
+	ViewerDirectoryList *list;
+	GPtrArray *files;
+	ViewerDirectoryEntry *entry;
+	guint n;
+	list = g_task_get_task_data (task);
+	g_ptr_array_sort (list->entries, viewer_directory_compare);
+	files = g_ptr_array_new_full (list->entries->len, g_object_unref);
+
+	for (n = 0; n < list->entries->len; n++)
+	{
+		entry = g_ptr_array_index (list->entries, n);
+
+		if (!entry->header || g_hash_table_contains (list->headers, entry->header))
+		{
+			g_ptr_array_add (files, g_object_ref (entry->file));
+		}
+	}
+
+	g_task_return_pointer (task, files, (GDestroyNotify) g_ptr_array_unref);
+	g_object_unref (task);
+}
@@ -0,0 +1,935 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include <math.h>
+#include <string.h>
+#include "viewer.h"
+#define IMAGE_FORMAT        CAIRO_FORMAT_ARGB32
+#define IMAGE_LAZY_TILES    1024
+#define IMAGE_NEAREST_SCALE 4.0
+#define IMAGE_PIXEL         4
+#define IMAGE_RESAMPLE_ROWS 64
+#define IMAGE_TEXTURE       GDK_MEMORY_DEFAULT
+#define IMAGE_TILE_SIZE     256
+
+typedef struct _ViewerImageLevel ViewerImageLevel;
+typedef struct _ViewerImageTile  ViewerImageTile;
+
+/* 縮小画像の 1 段階 */
+struct _ViewerImageLevel
+{
+	ViewerImageTile *tiles;
+	int              width;
+	int              height;
+	int              columns;
+	int              rows;
+};
+
+/* 画像の区画 */
+struct _ViewerImageTile
+{
+	cairo_surface_t *surface;
+	GdkTexture      *texture;
+	GList            link;
+};
+
+/* Viewer Image クラスのインスタンス */
+struct _ViewerImage
+{
+	GObject             parent_instance;
+	GMutex              mutex;
+	GdkPixbufAnimation *animation;
+	ViewerImageLevel   *levels;
+	ViewerImageReadFunc read;
+	gpointer            read_data;
+	GDestroyNotify      read_destroy;
+	GQueue              lazy_tiles;
+	gsize               read_size;
+	gsize               size;
+	int                 n_levels;
+	int                 width;
+	int                 height;
+};
+
+static int              viewer_image_choose_level  (ViewerImage *self, double zoom);
+static void             viewer_image_class_init    (ViewerImageClass *this_class);
+static cairo_surface_t *viewer_image_create_tile   (ViewerImage *self, int level, int column, int row);
+static void             viewer_image_destroy_tile  (ViewerImage *self, ViewerImageTile *tile);
+static cairo_surface_t *viewer_image_detach_tile   (ViewerImageTile *tile);
+static void             viewer_image_evict         (ViewerImage *self, ViewerImageTile *keep);
+static void             viewer_image_finalize      (GObject *self);
+static GdkTexture      *viewer_image_get_texture   (ViewerImage *self, int level, int column, int row);
+static cairo_surface_t *viewer_image_get_tile      (ViewerImage *self, int level, int column, int row);
+static void             viewer_image_init          (ViewerImage *self);
+static void             viewer_image_init_levels   (ViewerImage *self, int width, int height);
+static int              viewer_image_init_weights  (double scale, int start, int length, int limit, int *indices, float *weights);
+static void             viewer_image_invalidate    (ViewerImage *self, int x, int y, int width, int height);
+static void             viewer_image_read          (ViewerImage *self, int level, int x, int y, int width, int height, guchar *destination, int destination_stride);
+static GdkTexture      *viewer_image_sample        (ViewerImage *self, double zoom, int width, int height);
+
+/* Viewer Image クラス */
+G_DEFINE_TYPE (ViewerImage, viewer_image, G_TYPE_OBJECT);
+
+/*******************************************************************************
+指定した拡大率に最も近い縮小画像を選択します。
+選択した縮小画像は表示する大きさ以上の解像度を持ちます。
+*/
+static int
+viewer_image_choose_level (ViewerImage *self, double zoom)
+{
+	int level;
+	level = 0;
+	zoom = zoom * self->width / self->levels [0].width;
+
+	while ((level + 1 < self->n_levels) && (zoom * 2.0 <= 1.0))
+	{
+		zoom *= 2.0;
+		level++;
+	}
+
+	return level;
+}
+
+/*******************************************************************************
+クラスを初期化します。
+*/
+static void
+viewer_image_class_init (ViewerImageClass *this_class)
+{
+	G_OBJECT_CLASS (this_class)->finalize = viewer_image_finalize;
+}
+
+/*******************************************************************************
+区画を作成します。呼び出し元はロックを保持します。
+*/
+static cairo_surface_t *
+viewer_image_create_tile (ViewerImage *self, int level, int column, int row)
+{
+	ViewerImageLevel *levels;
+	ViewerImageTile *tile;
+	cairo_surface_t *surface;
+	int width, height;
+	levels = &self->levels [level];
+	tile = &levels->tiles [row * levels->columns + column];
+	width = MIN (IMAGE_TILE_SIZE, levels->width - column * IMAGE_TILE_SIZE);
+	height = MIN (IMAGE_TILE_SIZE, levels->height - row * IMAGE_TILE_SIZE);
+	surface = cairo_image_surface_create (IMAGE_FORMAT, width, height);
+
+	if (cairo_surface_status (surface) == CAIRO_STATUS_SUCCESS)
+	{
+		tile->surface = surface;
+		self->size += (gsize) cairo_image_surface_get_stride (surface) * height;
+	}
+	else
+	{
+		cairo_surface_destroy (surface);
+		surface = NULL;
+	}
+
+	return surface;
+}
+
+/*******************************************************************************
+区画を破棄します。読み直せる区画の場合は、使用した順の一覧からも外します。呼び出し元はロックを保持します。
+*/
+static void
+viewer_image_destroy_tile (ViewerImage *self, ViewerImageTile *tile)
+{
+	if (tile->link.data)
+	{
+		g_queue_unlink (&self->lazy_tiles, &tile->link);
+		tile->link.data = NULL;
+	}
+	if (tile->surface)
+	{
+		self->size -= (gsize) cairo_image_surface_get_stride (tile->surface) * cairo_image_surface_get_height (tile->surface);
+		g_clear_pointer (&tile->surface, cairo_surface_destroy);
+	}
+
+	g_clear_object (&tile->texture);
+}
+
+/*******************************************************************************
+テクスチャと画素を共有している区画に書き込む前に、画素を複製して共有を解除します。
+描画中のテクスチャの画素は変更しません。複製できない場合は NULL を返します。呼び出し元はロックを保持します。
+*/
+static cairo_surface_t *
+viewer_image_detach_tile (ViewerImageTile *tile)
+{
+	cairo_surface_t *surface;
+	int stride, height;
+
+	if (tile->texture)
+	{
+		stride = cairo_image_surface_get_stride (tile->surface);
+		height = cairo_image_surface_get_height (tile->surface);
+		surface = cairo_image_surface_create (IMAGE_FORMAT, cairo_image_surface_get_width (tile->surface), height);
+
+		if (cairo_surface_status (surface) == CAIRO_STATUS_SUCCESS)
+		{
+			cairo_surface_flush (tile->surface);
+			cairo_surface_flush (surface);
+			memcpy (cairo_image_surface_get_data (surface), cairo_image_surface_get_data (tile->surface), (gsize) stride * height);
+			cairo_surface_mark_dirty (surface);
+			cairo_surface_destroy (tile->surface);
+			tile->surface = surface;
+			g_clear_object (&tile->texture);
+		}
+		else
+		{
+			cairo_surface_destroy (surface);
+			surface = NULL;
+		}
+	}
+	else
+	{
+		surface = tile->surface;
+	}
+
+	return surface;
+}
+
+/*******************************************************************************
+必要なときに読み直せる区画の数が上限を超えた場合は、最も長く使用していない区画を破棄します。
+区画は使用した順の一覧の末尾から破棄するので、区画の総数に関わらず破棄する区画の数だけの時間で済みます。
+keep は破棄しません。呼び出し元はロックを保持します。
+*/
+static void
+viewer_image_evict (ViewerImage *self, ViewerImageTile *keep)
+{
+	ViewerImageTile *oldest;
+
+	while ((self->lazy_tiles.length > IMAGE_LAZY_TILES) && ((oldest = self->lazy_tiles.tail->data) != keep))
+	{
+		viewer_image_destroy_tile (self, oldest);
+	}
+}
+
+/*******************************************************************************
+クラスのインスタンスを破棄します。
+*/
+static void
+viewer_image_finalize (GObject *self)
+{
+	ViewerImage *properties;
+	ViewerImageLevel *levels;
+	int level, n;
+	properties = VIEWER_IMAGE (self);
+
+	for (level = 0; level < properties->n_levels; level++)
+	{
+		levels = &properties->levels [level];
+
+		for (n = 0; n < levels->columns * levels->rows; n++)
+		{
+			viewer_image_destroy_tile (properties, &levels->tiles [n]);
+		}
+
+		g_free (levels->tiles);
+	}
+
+	g_free (properties->levels);
+	g_clear_object (&properties->animation);
+
+	if (properties->read_destroy)
+	{
+		properties->read_destroy (properties->read_data);
+	}
+
+	g_mutex_clear (&properties->mutex);
+	G_OBJECT_CLASS (viewer_image_parent_class)->finalize (self);
+}
+
+/*******************************************************************************
+動画像の場合は、その全てのコマを持つアニメーションを取得します。静止画像の場合は NULL を返します。
+画像の区画は最初のコマを表します。
+*/
+GdkPixbufAnimation *
+viewer_image_get_animation (ViewerImage *self)
+{
+	GdkPixbufAnimation *animation;
+	g_mutex_lock (&self->mutex);
+	animation = self->animation;
+	g_mutex_unlock (&self->mutex);
+	return animation;
+}
+
+/*******************************************************************************
+画像の高さを取得します。
+*/
+int
+viewer_image_get_height (ViewerImage *self)
+{
+	return self->height;
+}
+
+/*******************************************************************************
+区画と、画素を読み取る関数に渡すデータが使用しているメモリの大きさを取得します。
+*/
+gsize
+viewer_image_get_size (ViewerImage *self)
+{
+	gsize size;
+	g_mutex_lock (&self->mutex);
+	size = self->size + self->read_size;
+	g_mutex_unlock (&self->mutex);
+	return size;
+}
+
+/*******************************************************************************
+画素を読み取る関数が read の場合は、その関数に渡すデータを取得します。
+それ以外の場合は NULL を返します。
+*/
+gpointer
+viewer_image_get_reader (ViewerImage *self, ViewerImageReadFunc read)
+{
+	gpointer data;
+	g_mutex_lock (&self->mutex);
+	data = (self->read == read) ? self->read_data : NULL;
+	g_mutex_unlock (&self->mutex);
+	return data;
+}
+
+/*******************************************************************************
+区画のテクスチャを取得します。呼び出し元はロックを保持します。
+テクスチャは区画の画素を複製せずに参照し、区画に書き込むまで使い回します。
+*/
+static GdkTexture *
+viewer_image_get_texture (ViewerImage *self, int level, int column, int row)
+{
+	ViewerImageLevel *levels;
+	ViewerImageTile *tile;
+	cairo_surface_t *surface;
+	GBytes *bytes;
+	int stride, height;
+	levels = &self->levels [level];
+	tile = &levels->tiles [row * levels->columns + column];
+
+	if (!tile->texture && (surface = viewer_image_get_tile (self, level, column, row)))
+	{
+		cairo_surface_flush (surface);
+		stride = cairo_image_surface_get_stride (surface);
+		height = cairo_image_surface_get_height (surface);
+		bytes = g_bytes_new_with_free_func (cairo_image_surface_get_data (surface), (gsize) stride * height, (GDestroyNotify) cairo_surface_destroy, cairo_surface_reference (surface));
+		tile->texture = gdk_memory_texture_new (cairo_image_surface_get_width (surface), height, IMAGE_TEXTURE, bytes, stride);
+		g_bytes_unref (bytes);
+	}
+
+	return tile->texture;
+}
+
+/*******************************************************************************
+区画を取得します。呼び出し元はロックを保持します。
+縮小画像の区画は、はじめて要求されたときに 1 段階大きな区画から作成します。
+画素を読み取る関数を持つ画像では、どの段階の区画もその関数で直接作成し、使用した順の一覧の先頭へ移します。
+上限を超えた分は最も長く使用していない区画から破棄します。
+*/
+static cairo_surface_t *
+viewer_image_get_tile (ViewerImage *self, int level, int column, int row)
+{
+	ViewerImageLevel *levels, *children;
+	ViewerImageTile *tile;
+	cairo_surface_t *surface, *child;
+	guchar *data;
+	int stride, x, y, n;
+	levels = &self->levels [level];
+	tile = &levels->tiles [row * levels->columns + column];
+	surface = tile->surface;
+
+	if (self->read)
+	{
+		if (!surface && (surface = viewer_image_create_tile (self, level, column, row)))
+		{
+			cairo_surface_flush (surface);
+			self->read (self->read_data, level, column * IMAGE_TILE_SIZE, row * IMAGE_TILE_SIZE, cairo_image_surface_get_width (surface), cairo_image_surface_get_height (surface), cairo_image_surface_get_data (surface), cairo_image_surface_get_stride (surface));
+			cairo_surface_mark_dirty (surface);
+		}
+		if (surface && (self->lazy_tiles.head != &tile->link))
+		{
+			if (tile->link.data)
+			{
+				g_queue_unlink (&self->lazy_tiles, &tile->link);
+			}
+
+			tile->link.data = tile;
+			g_queue_push_head_link (&self->lazy_tiles, &tile->link);
+			viewer_image_evict (self, tile);
+		}
+	}
+	else if (!surface && level)
+	{
+		children = &self->levels [level - 1];
+
+		for (n = 0; n < 4; n++)
+		{
+			x = column * 2 + (n & 1);
+			y = row * 2 + (n >> 1);
+
+			if ((x < children->columns) && (y < children->rows))
+			{
+				child = viewer_image_get_tile (self, level - 1, x, y);
+
+				if (child && (surface || (surface = viewer_image_create_tile (self, level, column, row))))
+				{
+					cairo_surface_flush (child);
+					cairo_surface_flush (surface);
+					stride = cairo_image_surface_get_stride (surface);
+					data = cairo_image_surface_get_data (surface) + (n >> 1) * (IMAGE_TILE_SIZE / 2) * stride + (n & 1) * (IMAGE_TILE_SIZE / 2) * IMAGE_PIXEL;
+					viewer_convert_halve (cairo_image_surface_get_data (child), cairo_image_surface_get_stride (child), cairo_image_surface_get_width (child), cairo_image_surface_get_height (child), data, stride);
+					cairo_surface_mark_dirty (surface);
+				}
+			}
+		}
+	}
+
+	return surface;
+}
+
+/*******************************************************************************
+画像の幅を取得します。
+*/
+int
+viewer_image_get_width (ViewerImage *self)
+{
+	return self->width;
+}
+
+/*******************************************************************************
+クラスのインスタンスを初期化します。
+*/
+static void
+viewer_image_init (ViewerImage *self)
+{
+	g_mutex_init (&self->mutex);
+	g_queue_init (&self->lazy_tiles);
+}
+
+/*******************************************************************************
+縮小画像の各段階を初期化します。width と height は最も大きい段階の画素数です。
+区画が 1 つになるまで縦横を半分にします。
+*/
+static void
+viewer_image_init_levels (ViewerImage *self, int width, int height)
+{
+	ViewerImageLevel *levels;
+	int level, n;
+	self->n_levels = 1;
+
+	for (n = MAX (width, height); n > IMAGE_TILE_SIZE; n = (n + 1) / 2)
+	{
+		self->n_levels++;
+	}
+
+	self->levels = g_new0 (ViewerImageLevel, self->n_levels);
+
+	for (level = 0; level < self->n_levels; level++)
+	{
+		levels = &self->levels [level];
+		levels->width = width;
+		levels->height = height;
+		levels->columns = (width + IMAGE_TILE_SIZE - 1) / IMAGE_TILE_SIZE;
+		levels->rows = (height + IMAGE_TILE_SIZE - 1) / IMAGE_TILE_SIZE;
+		levels->tiles = g_new0 (ViewerImageTile, levels->columns * levels->rows);
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+	}
+}
+
+/*******************************************************************************
+面積平均で縮小するときの、出力画素ごとの入力画素の範囲と重みを求めます。
+出力画素 n は拡大後の座標 start + n から start + n + 1 を覆う入力画素の平均です。
+indices には各出力画素の最初の入力画素を、weights には出力画素ごとに返り値の個数の重みを格納します。
+weights には length * (ceil (1 / scale) + 1) 個の領域が必要です。返り値は出力画素ごとの重みの個数です。
+*/
+static int
+viewer_image_init_weights (double scale, int start, int length, int limit, int *indices, float *weights)
+{
+	double first, last, overlap, total;
+	int n, taps, tap, index;
+	taps = (int) ceil (1.0 / scale) + 1;
+
+	for (n = 0; n < length; n++)
+	{
+		first = CLAMP ((start + n) / scale, 0.0, limit);
+		last = CLAMP ((start + n + 1) / scale, 0.0, limit);
+		index = MIN ((int) floor (first), limit - 1);
+		indices [n] = index;
+		total = 0.0;
+
+		for (tap = 0; tap < taps; tap++)
+		{
+			overlap = MAX (0.0, MIN (last, index + tap + 1.0) - MAX (first, (double) (index + tap)));
+			weights [n * taps + tap] = (float) overlap;
+			total += overlap;
+		}
+		for (tap = 0; (tap < taps) && (total > 0.0); tap++)
+		{
+			weights [n * taps + tap] /= (float) total;
+		}
+	}
+
+	return taps;
+}
+
+/*******************************************************************************
+指定した領域を含む縮小画像の区画を破棄します。呼び出し元はロックを保持します。
+*/
+static void
+viewer_image_invalidate (ViewerImage *self, int x, int y, int width, int height)
+{
+	ViewerImageLevel *levels;
+	int level, column, row;
+
+	for (level = 1; level < self->n_levels; level++)
+	{
+		levels = &self->levels [level];
+
+		for (row = (y >> level) / IMAGE_TILE_SIZE; row <= ((y + height - 1) >> level) / IMAGE_TILE_SIZE; row++)
+		{
+			for (column = (x >> level) / IMAGE_TILE_SIZE; column <= ((x + width - 1) >> level) / IMAGE_TILE_SIZE; column++)
+			{
+				viewer_image_destroy_tile (self, &levels->tiles [row * levels->columns + column]);
+			}
+		}
+	}
+}
+
+/*******************************************************************************
+クラスのインスタンスを作成します。
+*/
+ViewerImage *
+viewer_image_new (int width, int height)
+{
+	return viewer_image_new_scaled (width, height, width, height);
+}
+
+/*******************************************************************************
+画素を必要になったときに読み取る画像を作成します。
+read は区画を表示するときに、その段階の座標で区画の範囲を ARGB32 で書き込みます。
+段階 n の画素 (x, y) は元の画像の画素 (x << n, y << n) を表します。
+区画は一定の数だけ保持し、それを超えた分は破棄して必要になったときに読み直します。
+size は data が保持する画素のバイト数で、キャッシュの容量を計算するために区画の大きさに加えます。
+destroy は画像を破棄するときに data を引数として呼び出します。
+*/
+ViewerImage *
+viewer_image_new_lazy (int width, int height, ViewerImageReadFunc read, gpointer data, gsize size, GDestroyNotify destroy)
+{
+	ViewerImage *self;
+	self = viewer_image_new (width, height);
+	viewer_image_set_reader (self, read, data, destroy);
+	self->read_size = size;
+	return self;
+}
+
+/*******************************************************************************
+表示上の大きさより少ない画素数で画像を作成します。
+縮小して展開した下見用の画像を元の大きさで表示するために使用します。
+*/
+ViewerImage *
+viewer_image_new_scaled (int width, int height, int pixel_width, int pixel_height)
+{
+	ViewerImage *self;
+	self = g_object_new (VIEWER_TYPE_IMAGE, NULL);
+	self->width = width;
+	self->height = height;
+	viewer_image_init_levels (self, pixel_width, pixel_height);
+	return self;
+}
+
+/*******************************************************************************
+指定した段階の縮小画像から領域の画素を読み取ります。任意のスレッドから呼び出せます。
+ロックは区画ごとに取得するので、読み取り中も描画を妨げません。展開していない区画は透明にします。
+*/
+static void
+viewer_image_read (ViewerImage *self, int level, int x, int y, int width, int height, guchar *destination, int destination_stride)
+{
+	cairo_surface_t *surface;
+	const guchar *source;
+	int column, row, left, top, right, bottom, stride, line;
+
+	for (row = y / IMAGE_TILE_SIZE; row <= (y + height - 1) / IMAGE_TILE_SIZE; row++)
+	{
+		for (column = x / IMAGE_TILE_SIZE; column <= (x + width - 1) / IMAGE_TILE_SIZE; column++)
+		{
+			left = MAX (x, column * IMAGE_TILE_SIZE);
+			top = MAX (y, row * IMAGE_TILE_SIZE);
+			right = MIN (x + width, (column + 1) * IMAGE_TILE_SIZE);
+			bottom = MIN (y + height, (row + 1) * IMAGE_TILE_SIZE);
+			g_mutex_lock (&self->mutex);
+			surface = viewer_image_get_tile (self, level, column, row);
+
+			if (surface)
+			{
+				cairo_surface_flush (surface);
+				stride = cairo_image_surface_get_stride (surface);
+				source = cairo_image_surface_get_data (surface) + (top - row * IMAGE_TILE_SIZE) * stride + (left - column * IMAGE_TILE_SIZE) * IMAGE_PIXEL;
+			}
+			for (line = top; line < bottom; line++)
+			{
+				if (surface)
+				{
+					memcpy (destination + (gsize) (line - y) * destination_stride + (left - x) * IMAGE_PIXEL, source + (gsize) (line - top) * stride, (gsize) (right - left) * IMAGE_PIXEL);
+				}
+				else
+				{
+					memset (destination + (gsize) (line - y) * destination_stride + (left - x) * IMAGE_PIXEL, 0, (gsize) (right - left) * IMAGE_PIXEL);
+				}
+			}
+
+			g_mutex_unlock (&self->mutex);
+		}
+	}
+}
+
+/*******************************************************************************
+画像全体を指定した拡大率で描画したテクスチャを作成します。任意のスレッドから呼び出せます。
+width と height は拡大後の大きさです。縮小する場合は面積平均で縮小し、
+拡大率に最も近い縮小画像を等倍以上で表示できる場合は、その区画の画素を直接写します。作成できない場合は NULL を返します。
+*/
+GdkTexture *
+viewer_image_render (ViewerImage *self, double zoom, int width, int height)
+{
+	GdkTexture *texture;
+	texture = viewer_image_resample (self, zoom, 0, 0, width, height, NULL);
+
+	if (!texture && (width > 0) && (height > 0))
+	{
+		texture = viewer_image_sample (self, zoom, width, height);
+	}
+
+	return texture;
+}
+
+/*******************************************************************************
+表示する領域を面積平均で縮小した高画質なテクスチャを作成します。任意のスレッドから呼び出せます。
+(x, y, width, height) は拡大後の座標で、作成したテクスチャの 1 画素が拡大後の 1 画素に対応します。
+拡大率に最も近い縮小画像を等倍以上で表示できる場合や、取り消された場合は NULL を返します。
+*/
+GdkTexture *
+viewer_image_resample (ViewerImage *self, double zoom, int x, int y, int width, int height, GCancellable *cancellable)
+{
+	ViewerImageLevel *levels;
+	GdkTexture *texture;
+	GBytes *bytes;
+	const guchar *source;
+	guchar *pixels, *buffer, *pixel;
+	float *row, *weights_x, *weights_y;
+	double scale_x, scale_y;
+	int *indices_x, *indices_y;
+	int level, taps_x, taps_y, first, left, right, top, bottom, stride, n, m, tap, channel;
+	float value;
+	level = viewer_image_choose_level (self, zoom);
+	levels = &self->levels [level];
+	scale_x = zoom * self->width / levels->width;
+	scale_y = zoom * self->height / levels->height;
+
+	if (((scale_x >= 1.0) && (scale_y >= 1.0)) || (width <= 0) || (height <= 0))
+	{
+		return NULL;
+	}
+
+	indices_x = g_new (int, width);
+	indices_y = g_new (int, height);
+	weights_x = g_new (float, (gsize) width * ((int) ceil (1.0 / scale_x) + 1));
+	weights_y = g_new (float, (gsize) height * ((int) ceil (1.0 / scale_y) + 1));
+	taps_x = viewer_image_init_weights (scale_x, x, width, levels->width, indices_x, weights_x);
+	taps_y = viewer_image_init_weights (scale_y, y, height, levels->height, indices_y, weights_y);
+	left = indices_x [0];
+	right = MIN (indices_x [width - 1] + taps_x, levels->width);
+	stride = (right - left) * IMAGE_PIXEL;
+	pixels = g_malloc ((gsize) width * height * IMAGE_PIXEL);
+	buffer = g_malloc ((gsize) stride * (IMAGE_RESAMPLE_ROWS * (taps_y - 1) + taps_y));
+	row = g_new (float, (gsize) (right - left) * IMAGE_PIXEL);
+
+	for (first = 0; (first < height) && !g_cancellable_is_cancelled (cancellable); first += IMAGE_RESAMPLE_ROWS)
+	{
+		top = indices_y [first];
+		bottom = MIN (indices_y [MIN (first + IMAGE_RESAMPLE_ROWS, height) - 1] + taps_y, levels->height);
+		viewer_image_read (self, level, left, top, right - left, bottom - top, buffer, stride);
+
+		for (n = first; n < MIN (first + IMAGE_RESAMPLE_ROWS, height); n++)
+		{
+			memset (row, 0, sizeof (float) * (right - left) * IMAGE_PIXEL);
+
+			for (tap = 0; (tap < taps_y) && (indices_y [n] + tap < bottom); tap++)
+			{
+				source = buffer + (gsize) (indices_y [n] + tap - top) * stride;
+
+				for (m = 0; m < (right - left) * IMAGE_PIXEL; m++)
+				{
+					row [m] += weights_y [n * taps_y + tap] * source [m];
+				}
+			}
+			for (m = 0; m < width; m++)
+			{
+				pixel = pixels + ((gsize) n * width + m) * IMAGE_PIXEL;
+
+				for (channel = 0; channel < IMAGE_PIXEL; channel++)
+				{
+					value = 0.5F;
+
+					for (tap = 0; (tap < taps_x) && (indices_x [m] + tap < right); tap++)
+					{
+						value += weights_x [m * taps_x + tap] * row [(indices_x [m] + tap - left) * IMAGE_PIXEL + channel];
+					}
+
+					pixel [channel] = (guchar) MIN (value, 255.0F);
+				}
+			}
+		}
+	}
+
+	if (g_cancellable_is_cancelled (cancellable))
+	{
+		g_free (pixels);
+		texture = NULL;
+	}
+	else
+	{
+		bytes = g_bytes_new_take (pixels, (gsize) width * height * IMAGE_PIXEL);
+		texture = gdk_memory_texture_new (width, height, IMAGE_TEXTURE, bytes, (gsize) width * IMAGE_PIXEL);
+		g_bytes_unref (bytes);
+	}
+
+	g_free (row);
+	g_free (buffer);
+	g_free (weights_y);
+	g_free (weights_x);
+	g_free (indices_y);
+	g_free (indices_x);
+	return texture;
+}
+
+/*******************************************************************************
+拡大率に最も近い縮小画像を等倍以上で表示する場合に、その画素を最近傍で写したテクスチャを作成します。
+GTK の描画を使わないので、任意のスレッドから呼び出せます。縮小画像が等倍の場合は区画を読み取るだけです。
+*/
+static GdkTexture *
+viewer_image_sample (ViewerImage *self, double zoom, int width, int height)
+{
+	ViewerImageLevel *levels;
+	GdkTexture *texture;
+	GBytes *bytes;
+	guchar *source, *pixels;
+	double scale_x, scale_y;
+	int *columns;
+	int level, row, n, m;
+	level = viewer_image_choose_level (self, zoom);
+	levels = &self->levels [level];
+	scale_x = zoom * self->width / levels->width;
+	scale_y = zoom * self->height / levels->height;
+	source = g_malloc ((gsize) levels->width * levels->height * IMAGE_PIXEL);
+	viewer_image_read (self, level, 0, 0, levels->width, levels->height, source, levels->width * IMAGE_PIXEL);
+
+	if ((width == levels->width) && (height == levels->height))
+	{
+		pixels = source;
+	}
+	else
+	{
+		pixels = g_malloc ((gsize) width * height * IMAGE_PIXEL);
+		columns = g_new (int, width);
+
+		for (m = 0; m < width; m++)
+		{
+			columns [m] = MIN ((int) ((m + 0.5) / scale_x), levels->width - 1);
+		}
+		for (n = 0; n < height; n++)
+		{
+			row = MIN ((int) ((n + 0.5) / scale_y), levels->height - 1);
+
+			for (m = 0; m < width; m++)
+			{
+				memcpy (pixels + ((gsize) n * width + m) * IMAGE_PIXEL, source + ((gsize) row * levels->width + columns [m]) * IMAGE_PIXEL, IMAGE_PIXEL);
+			}
+		}
+
+		g_free (columns);
+		g_free (source);
+	}
+
+	bytes = g_bytes_new_take (pixels, (gsize) width * height * IMAGE_PIXEL);
+	texture = gdk_memory_texture_new (width, height, IMAGE_TEXTURE, bytes, (gsize) width * IMAGE_PIXEL);
+	g_bytes_unref (bytes);
+	return texture;
+}
+
+/*******************************************************************************
+動画像の全てのコマを持つアニメーションを設定します。
+アニメーションは複数のスレッドから読み取るので、設定した後に変更してはいけません。
+*/
+void
+viewer_image_set_animation (ViewerImage *self, GdkPixbufAnimation *animation)
+{
+	g_mutex_lock (&self->mutex);
+	g_set_object (&self->animation, animation);
+	g_mutex_unlock (&self->mutex);
+}
+
+/*******************************************************************************
+画素を読み取る関数を置き換え、読み取り済みの区画をすべて破棄します。
+表示の設定を変えて画素を読み直すときに使用します。古い data は置き換えた後に破棄します。
+*/
+void
+viewer_image_set_reader (ViewerImage *self, ViewerImageReadFunc read, gpointer data, GDestroyNotify destroy)
+{
+	ViewerImageLevel *levels;
+	GDestroyNotify previous_destroy;
+	gpointer previous_data;
+	int level, n;
+	g_mutex_lock (&self->mutex);
+
+	if (self->read)
+	{
+		for (level = 0; level < self->n_levels; level++)
+		{
+			levels = &self->levels [level];
+
+			for (n = 0; n < levels->columns * levels->rows; n++)
+			{
+				viewer_image_destroy_tile (self, &levels->tiles [n]);
+			}
+		}
+	}
+
+	previous_data = self->read_data;
+	previous_destroy = self->read_destroy;
+	self->read = read;
+	self->read_data = data;
+	self->read_destroy = destroy;
+	g_mutex_unlock (&self->mutex);
+
+	if (previous_destroy)
+	{
+		previous_destroy (previous_data);
+	}
+}
+
+/*******************************************************************************
+画像をスナップショットへ追加します。(x, y) は拡大後の表示開始位置です。
+表示領域と交差する区画だけを、拡大率に最も近い縮小画像のテクスチャとして追加します。
+等倍と大きく拡大したときは画素が分かるように最近傍で、それ以外は線形補間で拡大縮小します。
+fast が TRUE の場合は、操作中の応答を優先して常に最近傍で拡大縮小します。
+*/
+void
+viewer_image_snapshot (ViewerImage *self, GtkSnapshot *snapshot, double zoom, double x, double y, int width, int height, gboolean fast)
+{
+	ViewerImageLevel *levels;
+	GskScalingFilter filter;
+	GdkTexture *texture;
+	double scale_x, scale_y;
+	int level, column, row, first_column, first_row, last_column, last_row;
+	int left, top, right, bottom, tile_width, tile_height;
+	level = viewer_image_choose_level (self, zoom);
+	levels = &self->levels [level];
+	scale_x = zoom * self->width / levels->width;
+	scale_y = zoom * self->height / levels->height;
+	filter = (fast || (scale_x == 1.0) || (scale_x >= IMAGE_NEAREST_SCALE)) ? GSK_SCALING_FILTER_NEAREST : GSK_SCALING_FILTER_LINEAR;
+	first_column = CLAMP ((int) floor (x / scale_x) / IMAGE_TILE_SIZE, 0, levels->columns - 1);
+	first_row = CLAMP ((int) floor (y / scale_y) / IMAGE_TILE_SIZE, 0, levels->rows - 1);
+	last_column = CLAMP ((int) ceil ((x + width) / scale_x) / IMAGE_TILE_SIZE, 0, levels->columns - 1);
+	last_row = CLAMP ((int) ceil ((y + height) / scale_y) / IMAGE_TILE_SIZE, 0, levels->rows - 1);
+	g_mutex_lock (&self->mutex);
+
+	for (row = first_row; row <= last_row; row++)
+	{
+		for (column = first_column; column <= last_column; column++)
+		{
+			texture = viewer_image_get_texture (self, level, column, row);
+
+			if (texture)
+			{
+				tile_width = gdk_texture_get_width (texture);
+				tile_height = gdk_texture_get_height (texture);
+				left = (int) round (column * IMAGE_TILE_SIZE * scale_x - x);
+				top = (int) round (row * IMAGE_TILE_SIZE * scale_y - y);
+				right = (int) round ((column * IMAGE_TILE_SIZE + tile_width) * scale_x - x);
+				bottom = (int) round ((row * IMAGE_TILE_SIZE + tile_height) * scale_y - y);
+
+				if ((left < right) && (top < bottom))
+				{
+					gtk_snapshot_append_scaled_texture (snapshot, texture, filter, &GRAPHENE_RECT_INIT (left, top, right - left, bottom - top));
+				}
+			}
+		}
+	}
+
+	g_mutex_unlock (&self->mutex);
+}
+
+/*******************************************************************************
+RGB または RGBA の画素を画像の指定した領域へ書き込みます。
+任意のスレッドから呼び出せます。source は (x, y) の画素を指します。
+ロックは区画を取得するときと書き終えたときだけ保持し、画素の変換はロックを解放して行うので、
+重ならない領域は複数のスレッドから同時に書き込めます。変換中に他のスレッドが区画を複製した場合は、複製した区画へ書き直します。
+変換中に描画のためのテクスチャが作成された場合は、書き終えた区画を複製してそのテクスチャと切り離します。
+*/
+void
+viewer_image_write (ViewerImage *self, const guchar *source, int source_stride, int n_channels, int x, int y, int width, int height)
+{
+	ViewerImageLevel *levels;
+	ViewerImageTile *tile;
+	cairo_surface_t *surface;
+	int column, row, left, top, right, bottom, stride;
+	gboolean written;
+	levels = &self->levels [0];
+
+	for (row = y / IMAGE_TILE_SIZE; row <= (y + height - 1) / IMAGE_TILE_SIZE; row++)
+	{
+		for (column = x / IMAGE_TILE_SIZE; column <= (x + width - 1) / IMAGE_TILE_SIZE; column++)
+		{
+			left = MAX (x, column * IMAGE_TILE_SIZE);
+			top = MAX (y, row * IMAGE_TILE_SIZE);
+			right = MIN (x + width, MIN ((column + 1) * IMAGE_TILE_SIZE, levels->width));
+			bottom = MIN (y + height, MIN ((row + 1) * IMAGE_TILE_SIZE, levels->height));
+			tile = &levels->tiles [row * levels->columns + column];
+
+			do
+			{
+				g_mutex_lock (&self->mutex);
+				surface = tile->surface ? viewer_image_detach_tile (tile) : viewer_image_create_tile (self, 0, column, row);
+
+				if (surface)
+				{
+					cairo_surface_reference (surface);
+					cairo_surface_flush (surface);
+				}
+
+				g_mutex_unlock (&self->mutex);
+
+				if (surface)
+				{
+					stride = cairo_image_surface_get_stride (surface);
+					viewer_convert_pixels (
+						source + (gsize) (top - y) * source_stride + (left - x) * n_channels, source_stride, n_channels,
+						cairo_image_surface_get_data (surface) + (top - row * IMAGE_TILE_SIZE) * stride + (left - column * IMAGE_TILE_SIZE) * IMAGE_PIXEL, stride,
+						right - left, bottom - top);
+				}
+
+				g_mutex_lock (&self->mutex);
+				written = !surface || (tile->surface == surface);
+
+				if (surface && written)
+				{
+					cairo_surface_mark_dirty (surface);
+
+					if (tile->texture)
+					{
+						viewer_image_detach_tile (tile);
+					}
+				}
+
+				g_mutex_unlock (&self->mutex);
+
+				if (surface)
+				{
+					cairo_surface_destroy (surface);
+				}
+			}
+			while (!written);
+		}
+	}
+
+	g_mutex_lock (&self->mutex);
+	viewer_image_invalidate (self, x, y, width, height);
+	g_mutex_unlock (&self->mutex);
+}
@@ -0,0 +1,531 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include "viewer.h"
+#define POOL_EXCLUSIVE       FALSE
+#define SIGNAL_AREA_PREPARED "area-prepared"
+#define SIGNAL_AREA_UPDATED  "area-updated"
+#define STREAM_BUFFER_SIZE   (64 * 1024)
+#define TRACE_DECODE         "decode"
+
+typedef struct _ViewerLoaderJob    ViewerLoaderJob;
+typedef struct _ViewerLoaderStream ViewerLoaderStream;
+
+/* 画像の読み込み要求 */
+struct _ViewerLoaderJob
+{
+	GFile                   *file;
+	ViewerCache             *cache;
+	ViewerImage             *image;
+	ViewerImage             *preview;
+	GMutex                   mutex;
+	ViewerLoaderProgressFunc progress;
+	gpointer                 user_data;
+	const char              *key;
+	int                      preview_width;
+	int                      preview_height;
+	gint                     notifying;
+	gboolean                 previewed;
+	gboolean                 save;
+};
+
+/* 読み込み中の画像 */
+struct _ViewerLoaderStream
+{
+	GTask       *task;
+	ViewerImage *image;
+};
+
+static int          viewer_loader_compare     (gconstpointer a, gconstpointer b, gpointer user_data);
+static gpointer     viewer_loader_create_pool (gpointer data);
+static ViewerImage *viewer_loader_decode      (GFile *file, GTask *task, GCancellable *cancellable, GError **error);
+static void         viewer_loader_free_job    (ViewerLoaderJob *job);
+static GThreadPool *viewer_loader_get_pool    (void);
+static ViewerImage *viewer_loader_load        (GTask *task, GError **error);
+static gboolean     viewer_loader_notify      (gpointer data);
+static ViewerImage *viewer_loader_open        (GTask *task, GError **error);
+static void         viewer_loader_prepare     (GdkPixbufLoader *loader, gpointer user_data);
+static gboolean     viewer_loader_preview     (GTask *task);
+static void         viewer_loader_progress    (GTask *task);
+static void         viewer_loader_run         (gpointer data, gpointer user_data);
+static void         viewer_loader_set_image   (GTask *task, ViewerImage *image);
+static void         viewer_loader_share       (GTask *task, ViewerImage *image);
+static void         viewer_loader_update      (GdkPixbufLoader *loader, int x, int y, int width, int height, gpointer user_data);
+static void         viewer_loader_wait        (ViewerImage *image, gpointer user_data);
+
+/*******************************************************************************
+画像ファイルを開きます。任意のスレッドから呼び出せます。
+画素は画像の区画へ直接書き込みます。非圧縮の画像ファイルはメモリへ割り当てて開きます。
+16 ビットの画像ファイルは精度を保ったまま開きます。リスタート マーカーを持つ大きな JPEG ファイルは帯に分けて並列に展開します。
+*/
+ViewerImage *
+viewer_create_image_from_file (GFile *file, GCancellable *cancellable, GError **error)
+{
+	ViewerImage *image;
+	image = viewer_mapped_open (file);
+
+	if (!image)
+	{
+		image = viewer_deep_open (file);
+	}
+	if (!image)
+	{
+		image = viewer_strip_open (file, cancellable);
+	}
+
+	return image ? image : viewer_loader_decode (file, NULL, cancellable, error);
+}
+
+/*******************************************************************************
+読み込み要求の優先順位を比較します。同じ優先順位の要求は要求した順に処理します。
+*/
+static int
+viewer_loader_compare (gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	int priority1, priority2;
+	priority1 = g_task_get_priority (G_TASK (a));
+	priority2 = g_task_get_priority (G_TASK (b));
+	return (priority1 > priority2) - (priority1 < priority2);
+}
+
+/*******************************************************************************
+画像を読み込むスレッド プールを作成します。
+*/
+static gpointer
+viewer_loader_create_pool (gpointer data)
+{
+	GThreadPool *pool;
+	pool = g_thread_pool_new (viewer_loader_run, NULL, g_get_num_processors (), POOL_EXCLUSIVE, NULL);
+	g_thread_pool_set_sort_function (pool, viewer_loader_compare, NULL);
+	return pool;
+}
+
+/*******************************************************************************
+画像ファイルを少しずつ読み取りながら展開します。動画像の場合は、最初のコマを画像にしてアニメーションを添えます。
+task が NULL でない場合は、展開した範囲を読み込みの途中でも通知します。
+展開できなかった場合は error を設定して NULL を返します。画像の大きさが分からないまま読み終えた場合も失敗とします。
+*/
+static ViewerImage *
+viewer_loader_decode (GFile *file, GTask *task, GCancellable *cancellable, GError **error)
+{
+	ViewerLoaderStream stream;
+	GdkPixbufAnimation *animation;
+	GdkPixbufLoader *loader;
+	GFileInputStream *input;
+	guchar *buffer;
+	gssize length;
+	gint64 begin;
+	begin = viewer_trace_begin ();
+	input = g_file_read (file, cancellable, error);
+	stream.task = task;
+	stream.image = NULL;
+
+	if (input)
+	{
+		loader = gdk_pixbuf_loader_new ();
+		g_signal_connect (loader, SIGNAL_AREA_PREPARED, G_CALLBACK (viewer_loader_prepare), &stream);
+		g_signal_connect (loader, SIGNAL_AREA_UPDATED,  G_CALLBACK (viewer_loader_update),  &stream);
+		buffer = g_malloc (STREAM_BUFFER_SIZE);
+
+		do
+		{
+			length = g_input_stream_read (G_INPUT_STREAM (input), buffer, STREAM_BUFFER_SIZE, cancellable, error);
+		}
+		while ((length > 0) && gdk_pixbuf_loader_write (loader, buffer, length, error));
+
+		if (length)
+		{
+			gdk_pixbuf_loader_close (loader, NULL);
+			g_clear_object (&stream.image);
+		}
+		else if (!gdk_pixbuf_loader_close (loader, error))
+		{
+			g_clear_object (&stream.image);
+		}
+		else if (!stream.image)
+		{
+			g_set_error_literal (error, GDK_PIXBUF_ERROR, GDK_PIXBUF_ERROR_CORRUPT_IMAGE, "The file contains no image data");
+		}
+		else if (stream.image && (animation = gdk_pixbuf_loader_get_animation (loader)) && !gdk_pixbuf_animation_is_static_image (animation))
+		{
+			viewer_image_set_animation (stream.image, animation);
+		}
+
+		g_free (buffer);
+		g_object_unref (loader);
+		g_object_unref (input);
+	}
+
+	viewer_trace_end (TRACE_DECODE, begin, stream.image ? (gint64) viewer_image_get_width (stream.image) * viewer_image_get_height (stream.image) : 0);
+	return stream.image;
+}
+
+/*******************************************************************************
+読み込み要求を破棄します。
+*/
+static void
+viewer_loader_free_job (ViewerLoaderJob *job)
+{
+	g_object_unref (job->file);
+	g_clear_object (&job->cache);
+	g_clear_object (&job->image);
+	g_clear_object (&job->preview);
+	g_mutex_clear (&job->mutex);
+	g_free (job);
+}
+
+/*******************************************************************************
+画像を読み込むスレッド プールを取得します。
+*/
+static GThreadPool *
+viewer_loader_get_pool (void)
+{
+	static GOnce once = G_ONCE_INIT;
+	return g_once (&once, viewer_loader_create_pool, NULL);
+}
+
+/*******************************************************************************
+画像ファイルを開きます。キャッシュにある場合はそれを使用します。
+先読みなどで他のスレッドが同じ画像を読み込み中の場合は、下見用の画像か読み込み途中の画像を通知しながら待ちます。
+*/
+static ViewerImage *
+viewer_loader_load (GTask *task, GError **error)
+{
+	ViewerLoaderJob *job;
+	ViewerImage *image;
+	GCancellable *cancellable;
+	GError *cancelled;
+	char *key;
+	job = g_task_get_task_data (task);
+	cancellable = g_task_get_cancellable (task);
+	cancelled = NULL;
+
+	if (job->cache)
+	{
+		key = viewer_cache_get_key (job->file, cancellable, error);
+
+		if (key)
+		{
+			image = viewer_cache_lookup (job->cache, key, cancellable, viewer_loader_wait, task, &cancelled);
+
+			if (cancelled)
+			{
+				g_propagate_error (error, cancelled);
+			}
+			else if (!image)
+			{
+				job->key = key;
+				image = viewer_loader_open (task, error);
+				job->key = NULL;
+
+				if (image)
+				{
+					viewer_cache_insert (job->cache, key, image);
+				}
+				else
+				{
+					viewer_cache_release (job->cache, key);
+				}
+			}
+
+			g_free (key);
+		}
+		else
+		{
+			image = NULL;
+		}
+	}
+	else
+	{
+		image = viewer_loader_open (task, error);
+	}
+
+	return image;
+}
+
+/*******************************************************************************
+画像ファイルを非同期に開きます。cache は NULL でもかまいません。
+io_priority の値が小さい要求から先に処理します。
+progress が NULL でない場合は、展開の途中にも画像を渡して呼び出します。
+preview_width と preview_height が 0 でない場合は、先にその大きさに合わせた下見用の画像を渡します。
+どちらも呼び出し元のメイン コンテキストで呼び出します。
+*/
+void
+viewer_loader_load_async (gpointer source_object, GFile *file, ViewerCache *cache, int io_priority, int preview_width, int preview_height, GCancellable *cancellable, ViewerLoaderProgressFunc progress, GAsyncReadyCallback callback, gpointer user_data)
+{
+	ViewerLoaderJob *job;
+	GTask *task;
+	job = g_new0 (ViewerLoaderJob, 1);
+	job->file = g_object_ref (file);
+	job->cache = cache ? g_object_ref (cache) : NULL;
+	job->progress = progress;
+	job->user_data = user_data;
+	job->preview_width = preview_width;
+	job->preview_height = preview_height;
+	g_mutex_init (&job->mutex);
+	task = g_task_new (source_object, cancellable, callback, user_data);
+	g_task_set_source_tag (task, viewer_loader_load_async);
+	g_task_set_priority (task, io_priority);
+	g_task_set_task_data (task, job, (GDestroyNotify) viewer_loader_free_job);
+	g_thread_pool_push (viewer_loader_get_pool (), task, NULL);
+}
+
+/*******************************************************************************
+非同期に開いた画像を取得します。
+*/
+ViewerImage *
+viewer_loader_load_finish (GAsyncResult *result, GError **error)
+{
+	return g_task_propagate_pointer (G_TASK (result), error);
+}
+
+/*******************************************************************************
+展開の途中経過をメイン コンテキストで通知します。
+通知する画像は作業スレッドが差し替えるので、ロックを保持して参照を取得してから渡します。
+*/
+static gboolean
+viewer_loader_notify (gpointer data)
+{
+	ViewerLoaderJob *job;
+	ViewerImage *image;
+	GCancellable *cancellable;
+	GTask *task;
+	task = G_TASK (data);
+	job = g_task_get_task_data (task);
+	cancellable = g_task_get_cancellable (task);
+	g_atomic_int_set (&job->notifying, FALSE);
+
+	if (!g_task_get_completed (task) && !(cancellable && g_cancellable_is_cancelled (cancellable)))
+	{
+		g_mutex_lock (&job->mutex);
+		image = job->image ? g_object_ref (job->image) : NULL;
+		g_mutex_unlock (&job->mutex);
+
+		if (image)
+		{
+			job->progress (g_task_get_source_object (task), image, job->user_data);
+			g_object_unref (image);
+		}
+	}
+
+	return G_SOURCE_REMOVE;
+}
+
+/*******************************************************************************
+画像ファイルを展開します。非圧縮の画像ファイルは展開せずにメモリへ割り当てます。
+16 ビットの画像ファイルは精度を保ったまま展開します。
+以前に保存した縮小画像があればそれを、なければ下見用の画像を作成し、それを通知してから途中経過を通知せずに展開します。
+リスタート マーカーを持つ大きな JPEG ファイルは、途中経過を通知せずに帯に分けて並列に展開します。
+縮小画像を保存していなかった画像は、読み込みを終えた後で保存します。
+*/
+static ViewerImage *
+viewer_loader_open (GTask *task, GError **error)
+{
+	ViewerLoaderJob *job;
+	ViewerImage *image;
+	gboolean preview;
+	job = g_task_get_task_data (task);
+	image = viewer_mapped_open (job->file);
+
+	if (!image)
+	{
+		image = viewer_deep_open (job->file);
+	}
+	if (!image)
+	{
+		preview = viewer_loader_preview (task);
+		image = viewer_strip_open (job->file, g_task_get_cancellable (task));
+
+		if (!image)
+		{
+			image = viewer_loader_decode (job->file, preview ? NULL : task, g_task_get_cancellable (task), error);
+		}
+	}
+
+	return image;
+}
+
+/*******************************************************************************
+画像の大きさが分かったときに画像を作成します。
+*/
+static void
+viewer_loader_prepare (GdkPixbufLoader *loader, gpointer user_data)
+{
+	ViewerLoaderStream *stream;
+	GdkPixbuf *pixbuf;
+	stream = user_data;
+	pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+
+	if (!stream->image)
+	{
+		stream->image = viewer_image_new (gdk_pixbuf_get_width (pixbuf), gdk_pixbuf_get_height (pixbuf));
+
+		if (stream->task)
+		{
+			viewer_loader_set_image (stream->task, stream->image);
+			viewer_loader_share (stream->task, stream->image);
+		}
+	}
+}
+
+/*******************************************************************************
+以前に保存した縮小画像があればそれを、なければ下見用の画像を作成して通知します。
+途中経過を通知しない要求と、既に作成を試みた要求は何もしません。下見用の画像を通知した場合は TRUE を返します。
+*/
+static gboolean
+viewer_loader_preview (GTask *task)
+{
+	ViewerLoaderJob *job;
+	job = g_task_get_task_data (task);
+
+	if (job->progress && job->preview_width && job->preview_height && !job->previewed)
+	{
+		job->previewed = TRUE;
+		job->preview = viewer_store_lookup (job->file);
+		job->save = !job->preview;
+
+		if (!job->preview)
+		{
+			job->preview = viewer_preview_create (job->file, job->preview_width, job->preview_height, g_task_get_cancellable (task));
+		}
+		if (job->preview)
+		{
+			viewer_loader_set_image (task, job->preview);
+			viewer_loader_progress (task);
+		}
+	}
+
+	return job->preview != NULL;
+}
+
+/*******************************************************************************
+途中経過の通知が予約されていない場合は、メイン コンテキストへ通知を予約します。
+*/
+static void
+viewer_loader_progress (GTask *task)
+{
+	ViewerLoaderJob *job;
+	job = g_task_get_task_data (task);
+
+	if (job->progress && g_atomic_int_compare_and_exchange (&job->notifying, FALSE, TRUE))
+	{
+		g_main_context_invoke_full (g_task_get_context (task), G_PRIORITY_DEFAULT, viewer_loader_notify, g_object_ref (task), g_object_unref);
+	}
+}
+
+/*******************************************************************************
+スレッド プールで画像ファイルを開きます。
+縮小画像を保存する場合は、画像を返して表示を待たせないようにしてから保存します。
+*/
+static void
+viewer_loader_run (gpointer data, gpointer user_data)
+{
+	ViewerLoaderJob *job;
+	ViewerImage *image;
+	GError *error;
+	GTask *task;
+	task = G_TASK (data);
+	job = g_task_get_task_data (task);
+	error = NULL;
+
+	if (!g_task_return_error_if_cancelled (task))
+	{
+		image = viewer_loader_load (task, &error);
+
+		if (image)
+		{
+			g_task_return_pointer (task, g_object_ref (image), g_object_unref);
+
+			if (job->save)
+			{
+				viewer_store_save (job->file, image);
+			}
+
+			g_object_unref (image);
+		}
+		else
+		{
+			g_task_return_error (task, error);
+		}
+	}
+
+	g_object_unref (task);
+}
+
+/*******************************************************************************
+途中経過として通知する画像を差し替えます。作業スレッドから呼び出します。
+メイン コンテキストの通知はロックを保持して参照を取得するので、差し替えた古い画像を破棄しても通知とは競合しません。
+*/
+static void
+viewer_loader_set_image (GTask *task, ViewerImage *image)
+{
+	ViewerLoaderJob *job;
+	ViewerImage *previous;
+	job = g_task_get_task_data (task);
+	g_mutex_lock (&job->mutex);
+	previous = job->image;
+	job->image = g_object_ref (image);
+	g_mutex_unlock (&job->mutex);
+	g_clear_object (&previous);
+}
+
+/*******************************************************************************
+読み込み途中の画像を、キャッシュで同じ画像を待っている他の要求に渡します。
+*/
+static void
+viewer_loader_share (GTask *task, ViewerImage *image)
+{
+	ViewerLoaderJob *job;
+	job = g_task_get_task_data (task);
+
+	if (job->key)
+	{
+		viewer_cache_share (job->cache, job->key, image);
+	}
+}
+
+/*******************************************************************************
+展開した範囲の画素を画像へ書き込み、途中経過を通知します。
+*/
+static void
+viewer_loader_update (GdkPixbufLoader *loader, int x, int y, int width, int height, gpointer user_data)
+{
+	ViewerLoaderStream *stream;
+	GdkPixbuf *pixbuf;
+	int n_channels, stride;
+	stream = user_data;
+	pixbuf = gdk_pixbuf_loader_get_pixbuf (loader);
+	width = MIN (x + width, gdk_pixbuf_get_width (pixbuf)) - x;
+	height = MIN (y + height, gdk_pixbuf_get_height (pixbuf)) - y;
+
+	if (stream->image && (width > 0) && (height > 0))
+	{
+		n_channels = gdk_pixbuf_get_n_channels (pixbuf);
+		stride = gdk_pixbuf_get_rowstride (pixbuf);
+		viewer_image_write (stream->image, gdk_pixbuf_read_pixels (pixbuf) + (gsize) y * stride + x * n_channels, stride, n_channels, x, y, width, height);
+
+		if (stream->task)
+		{
+			viewer_loader_progress (stream->task);
+			viewer_loader_share (stream->task, stream->image);
+		}
+	}
+}
+
+/*******************************************************************************
+他の要求が同じ画像を読み込み終えるのを待つ間に呼び出されます。
+下見用の画像を通知できない場合は、他の要求が読み込み途中の画像 image を途中経過として通知します。
+*/
+static void
+viewer_loader_wait (ViewerImage *image, gpointer user_data)
+{
+	ViewerLoaderJob *job;
+	GTask *task;
+	task = G_TASK (user_data);
+	job = g_task_get_task_data (task);
+
+	if (!viewer_loader_preview (task) && image && job->progress)
+	{
+		viewer_loader_set_image (task, image);
+		viewer_loader_progress (task);
+	}
+}
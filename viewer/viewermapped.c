@@ -0,0 +1,424 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include <string.h>
+#include "viewer.h"
+#define BMP_BITFIELDS     3
+#define BMP_HEADER_SIZE   54
+#define BMP_INFO_SIZE     40
+#define BMP_MAGIC         "BM"
+#define BMP_MASK_SIZE     12
+#define BMP_RGB           0
+#define MAPPED_ALPHA      0xFF000000U
+#define MAPPED_MAX_SIZE   G_MAXINT
+#define PNM_GRAY          "P5"
+#define PNM_MAXVAL        255
+#define PNM_RGB           "P6"
+#define RAW_CHANNELS      "Channels"
+#define RAW_DEPTH         "Depth"
+#define RAW_GROUP         "Raw"
+#define RAW_HEIGHT        "Height"
+#define RAW_OFFSET        "Offset"
+#define RAW_STRIDE        "Stride"
+#define RAW_SUFFIX        ".hdr"
+#define RAW_WIDTH         "Width"
+#define TRACE_CONVERT     "map-convert"
+#define TRACE_MAP         "map"
+
+typedef enum   _ViewerMappedFormat ViewerMappedFormat;
+typedef struct _ViewerMapped       ViewerMapped;
+
+/* 画素の並び */
+enum _ViewerMappedFormat
+{
+	VIEWER_MAPPED_GRAY,
+	VIEWER_MAPPED_RGB,
+	VIEWER_MAPPED_RGBA,
+	VIEWER_MAPPED_BGR,
+	VIEWER_MAPPED_BGRX,
+};
+
+/* メモリへ割り当てた画像ファイル */
+struct _ViewerMapped
+{
+	GMappedFile       *file;
+	const guchar      *pixels;
+	gssize             stride;
+	ViewerMappedFormat format;
+	ViewerDeepFormat   deep_format;
+	int                depth;
+	int                n_channels;
+	int                width;
+	int                height;
+};
+
+static gboolean viewer_mapped_check      (ViewerMapped *self, guint64 offset, gint64 width, gint64 height, gint64 stride, int n_channels, gboolean bottom_up);
+static void     viewer_mapped_convert    (ViewerMapped *self, const guchar *source, guchar *destination, int width);
+static void     viewer_mapped_free       (ViewerMapped *self);
+static gboolean viewer_mapped_parse_bmp  (ViewerMapped *self);
+static gboolean viewer_mapped_parse_pnm  (ViewerMapped *self);
+static gboolean viewer_mapped_parse_raw  (ViewerMapped *self, const char *path);
+static void     viewer_mapped_read       (gpointer data, int level, int x, int y, int width, int height, guchar *destination, int destination_stride);
+static guint    viewer_mapped_read16     (const guchar *data);
+static guint32  viewer_mapped_read32     (const guchar *data);
+static gboolean viewer_mapped_read_token (const guchar *data, gsize length, gsize *position, gint64 *value);
+
+/*******************************************************************************
+画素の範囲がファイルに収まるかを確かめ、画素の位置を設定します。
+行の間隔は掛け算が桁あふれしないように、先にファイルの残りを行の数で割った値と比べます。
+bottom_up が TRUE の場合は、最後の行から順に並んでいるものとします。
+*/
+static gboolean
+viewer_mapped_check (ViewerMapped *self, guint64 offset, gint64 width, gint64 height, gint64 stride, int n_channels, gboolean bottom_up)
+{
+	const guchar *data;
+	guint64 length;
+	gboolean result;
+	data = (const guchar *) g_mapped_file_get_contents (self->file);
+	length = g_mapped_file_get_length (self->file);
+	result = (width > 0) && (height > 0) && (width <= MAPPED_MAX_SIZE) && (height <= MAPPED_MAX_SIZE) && (stride >= width * n_channels) && (offset <= length)
+	&& ((height == 1) || ((guint64) stride <= (length - offset) / (guint64) (height - 1)))
+	&& ((guint64) (height - 1) * stride + width * n_channels <= length - offset);
+
+	if (result)
+	{
+		self->width = width;
+		self->height = height;
+		self->n_channels = n_channels;
+		self->pixels = data + offset;
+		self->stride = stride;
+
+		if (bottom_up)
+		{
+			self->pixels += (gsize) (height - 1) * stride;
+			self->stride = -stride;
+		}
+	}
+
+	return result;
+}
+
+/*******************************************************************************
+1 行の画素を ARGB32 へ変換します。
+*/
+static void
+viewer_mapped_convert (ViewerMapped *self, const guchar *source, guchar *destination, int width)
+{
+	guint32 *pixels;
+	int x;
+	pixels = (guint32 *) destination;
+
+	switch (self->format)
+	{
+	case VIEWER_MAPPED_GRAY:
+		for (x = 0; x < width; x++)
+		{
+			pixels [x] = MAPPED_ALPHA | (source [x] * 0x010101U);
+		}
+		break;
+	case VIEWER_MAPPED_BGR:
+	case VIEWER_MAPPED_BGRX:
+		for (x = 0; x < width; x++, source += self->n_channels)
+		{
+			pixels [x] = MAPPED_ALPHA | ((guint32) source [2] << 16) | ((guint32) source [1] << 8) | source [0];
+		}
+		break;
+	default:
+		viewer_convert_pixels (source, 0, self->n_channels, destination, 0, width, 1);
+		break;
+	}
+}
+
+/*******************************************************************************
+メモリへの割り当てを解除します。
+*/
+static void
+viewer_mapped_free (ViewerMapped *self)
+{
+	g_mapped_file_unref (self->file);
+	g_free (self);
+}
+
+/*******************************************************************************
+非圧縮の画像ファイルをメモリへ割り当てて開きます。任意のスレッドから呼び出せます。
+対応する形式は 24 / 32 ビットの BMP、最大値 255 の PGM / PPM、
+および同じ名前に .hdr を付けた鍵ファイルで大きさを示した生の画素です。
+画素は区画を表示するときにファイルから直接変換します。
+16 ビットと浮動小数点数の生の画素は、精度を保ったまま表示範囲に合わせて変換します。
+対応しない形式の場合は NULL を返します。
+*/
+ViewerImage *
+viewer_mapped_open (GFile *file)
+{
+	ViewerMapped *self;
+	ViewerImage *image;
+	GMappedFile *mapped;
+	GBytes *bytes;
+	char *path;
+	gint64 begin;
+	begin = viewer_trace_begin ();
+	path = g_file_get_path (file);
+	mapped = path ? g_mapped_file_new (path, FALSE, NULL) : NULL;
+	image = NULL;
+
+	if (mapped)
+	{
+		self = g_new0 (ViewerMapped, 1);
+		self->file = mapped;
+
+		if (!(viewer_mapped_parse_bmp (self) || viewer_mapped_parse_pnm (self) || viewer_mapped_parse_raw (self, path)))
+		{
+			viewer_mapped_free (self);
+		}
+		else if (self->depth)
+		{
+			bytes = g_mapped_file_get_bytes (mapped);
+			image = viewer_deep_new (bytes, self->pixels - (const guchar *) g_mapped_file_get_contents (mapped), self->deep_format, self->width, self->height, self->stride);
+			g_bytes_unref (bytes);
+			viewer_mapped_free (self);
+		}
+		else
+		{
+			image = viewer_image_new_lazy (self->width, self->height, viewer_mapped_read, self, 0, (GDestroyNotify) viewer_mapped_free);
+		}
+	}
+
+	g_free (path);
+	viewer_trace_end (TRACE_MAP, begin, image ? (gint64) viewer_image_get_width (image) * viewer_image_get_height (image) : 0);
+	return image;
+}
+
+/*******************************************************************************
+BMP ファイルのヘッダーを解析します。
+*/
+static gboolean
+viewer_mapped_parse_bmp (ViewerMapped *self)
+{
+	const guchar *data;
+	gsize length;
+	gint64 width, height;
+	guint compression, depth;
+	gboolean result;
+	data = (const guchar *) g_mapped_file_get_contents (self->file);
+	length = g_mapped_file_get_length (self->file);
+	result = (length >= BMP_HEADER_SIZE) && !memcmp (data, BMP_MAGIC, 2) && (viewer_mapped_read32 (data + 14) >= BMP_INFO_SIZE) && (viewer_mapped_read16 (data + 26) == 1);
+
+	if (result)
+	{
+		width = (gint32) viewer_mapped_read32 (data + 18);
+		height = (gint32) viewer_mapped_read32 (data + 22);
+		depth = viewer_mapped_read16 (data + 28);
+		compression = viewer_mapped_read32 (data + 30);
+
+		if (compression == BMP_BITFIELDS)
+		{
+			result = (depth == 32) && (length >= BMP_HEADER_SIZE + BMP_MASK_SIZE) && (viewer_mapped_read32 (data + 54) == 0x00FF0000U) && (viewer_mapped_read32 (data + 58) == 0x0000FF00U) && (viewer_mapped_read32 (data + 62) == 0x000000FFU);
+		}
+		else
+		{
+			result = (compression == BMP_RGB) && ((depth == 24) || (depth == 32));
+		}
+
+		self->format = (depth == 24) ? VIEWER_MAPPED_BGR : VIEWER_MAPPED_BGRX;
+		result = result && viewer_mapped_check (self, viewer_mapped_read32 (data + 10), width, ABS (height), (width * depth + 31) / 32 * 4, depth / 8, height > 0);
+	}
+
+	return result;
+}
+
+/*******************************************************************************
+PGM / PPM ファイルのヘッダーを解析します。
+*/
+static gboolean
+viewer_mapped_parse_pnm (ViewerMapped *self)
+{
+	const guchar *data;
+	gsize length, position;
+	gint64 width, height, maxval;
+	int n_channels;
+	data = (const guchar *) g_mapped_file_get_contents (self->file);
+	length = g_mapped_file_get_length (self->file);
+	position = 2;
+	n_channels = 0;
+
+	if ((length >= 2) && !memcmp (data, PNM_RGB, 2))
+	{
+		self->format = VIEWER_MAPPED_RGB;
+		n_channels = 3;
+	}
+	else if ((length >= 2) && !memcmp (data, PNM_GRAY, 2))
+	{
+		self->format = VIEWER_MAPPED_GRAY;
+		n_channels = 1;
+	}
+
+	return n_channels && viewer_mapped_read_token (data, length, &position, &width) && viewer_mapped_read_token (data, length, &position, &height) && viewer_mapped_read_token (data, length, &position, &maxval) && (maxval == PNM_MAXVAL) && (position < length) && g_ascii_isspace (data [position]) && viewer_mapped_check (self, position + 1, width, height, width * n_channels, n_channels, FALSE);
+}
+
+/*******************************************************************************
+生の画素の大きさを示す鍵ファイルを解析します。
+鍵ファイルは [Raw] グループに Width、Height、Channels (1、3、4)、
+および省略可能な Stride、Offset、Depth (8、16、32) を持ちます。
+Depth が 16 の場合は符号なし整数、32 の場合は浮動小数点数をこの計算機のバイト順で並べたものとし、
+Channels は 1 か 4 に限ります。
+*/
+static gboolean
+viewer_mapped_parse_raw (ViewerMapped *self, const char *path)
+{
+	GKeyFile *keys;
+	char *name;
+	gint64 width, height, stride, offset;
+	int n_channels, depth, size;
+	gboolean result;
+	keys = g_key_file_new ();
+	name = g_strconcat (path, RAW_SUFFIX, NULL);
+	result = g_key_file_load_from_file (keys, name, G_KEY_FILE_NONE, NULL);
+
+	if (result)
+	{
+		width = g_key_file_get_int64 (keys, RAW_GROUP, RAW_WIDTH, NULL);
+		height = g_key_file_get_int64 (keys, RAW_GROUP, RAW_HEIGHT, NULL);
+		n_channels = g_key_file_get_integer (keys, RAW_GROUP, RAW_CHANNELS, NULL);
+		depth = g_key_file_has_key (keys, RAW_GROUP, RAW_DEPTH, NULL) ? g_key_file_get_integer (keys, RAW_GROUP, RAW_DEPTH, NULL) : 8;
+		size = n_channels * (depth / 8);
+		stride = g_key_file_has_key (keys, RAW_GROUP, RAW_STRIDE, NULL) ? g_key_file_get_int64 (keys, RAW_GROUP, RAW_STRIDE, NULL) : width * size;
+		offset = g_key_file_get_int64 (keys, RAW_GROUP, RAW_OFFSET, NULL);
+
+		switch ((depth << 8) | n_channels)
+		{
+		case (8 << 8) | 1:
+			self->format = VIEWER_MAPPED_GRAY;
+			break;
+		case (8 << 8) | 3:
+			self->format = VIEWER_MAPPED_RGB;
+			break;
+		case (8 << 8) | 4:
+			self->format = VIEWER_MAPPED_RGBA;
+			break;
+		case (16 << 8) | 1:
+			self->deep_format = VIEWER_DEEP_GRAY16;
+			break;
+		case (16 << 8) | 4:
+			self->deep_format = VIEWER_DEEP_RGBA16;
+			break;
+		case (32 << 8) | 1:
+			self->deep_format = VIEWER_DEEP_GRAY_FLOAT;
+			break;
+		case (32 << 8) | 4:
+			self->deep_format = VIEWER_DEEP_RGBA_FLOAT;
+			break;
+		default:
+			result = FALSE;
+			break;
+		}
+
+		self->depth = (depth > 8) ? depth : 0;
+		result = result && (offset >= 0) && !(offset % (depth / 8)) && !(stride % (depth / 8)) && viewer_mapped_check (self, offset, width, height, stride, size, FALSE);
+	}
+
+	g_free (name);
+	g_key_file_free (keys);
+	return result;
+}
+
+/*******************************************************************************
+区画の範囲の画素を変換します。縮小画像の画素は元の画像の画素をそのまま使用します。
+*/
+static void
+viewer_mapped_read (gpointer data, int level, int x, int y, int width, int height, guchar *destination, int destination_stride)
+{
+	ViewerMapped *self;
+	const guchar *row;
+	guchar *buffer;
+	gint64 begin;
+	int column, line, n_channels;
+	begin = viewer_trace_begin ();
+	self = data;
+	n_channels = self->n_channels;
+
+	if (!level && ((self->format == VIEWER_MAPPED_RGB) || (self->format == VIEWER_MAPPED_RGBA)))
+	{
+		viewer_convert_pixels (self->pixels + y * self->stride + (gsize) x * n_channels, self->stride, n_channels, destination, destination_stride, width, height);
+	}
+	else
+	{
+		buffer = level ? g_malloc ((gsize) width * n_channels) : NULL;
+
+		for (line = 0; line < height; line++)
+		{
+			row = self->pixels + MIN ((gint64) (y + line) << level, self->height - 1) * self->stride;
+
+			if (buffer)
+			{
+				for (column = 0; column < width; column++)
+				{
+					memcpy (buffer + column * n_channels, row + MIN ((gint64) (x + column) << level, self->width - 1) * n_channels, n_channels);
+				}
+
+				viewer_mapped_convert (self, buffer, destination + (gsize) line * destination_stride, width);
+			}
+			else
+			{
+				viewer_mapped_convert (self, row + (gsize) x * n_channels, destination + (gsize) line * destination_stride, width);
+			}
+		}
+
+		g_free (buffer);
+	}
+
+	viewer_trace_end (TRACE_CONVERT, begin, (gint64) width * height);
+}
+
+/*******************************************************************************
+リトル エンディアンの 16 ビット整数を読み取ります。
+*/
+static guint
+viewer_mapped_read16 (const guchar *data)
+{
+	return data [0] | (data [1] << 8);
+}
+
+/*******************************************************************************
+リトル エンディアンの 32 ビット整数を読み取ります。
+*/
+static guint32
+viewer_mapped_read32 (const guchar *data)
+{
+	return data [0] | (data [1] << 8) | (data [2] << 16) | ((guint32) data [3] << 24);
+}
+
+/*******************************************************************************
+空白と注釈を読み飛ばして 10 進数を読み取ります。
+*/
+static gboolean
+viewer_mapped_read_token (const guchar *data, gsize length, gsize *position, gint64 *value)
+{
+	gsize index;
+	gboolean result;
+	index = *position;
+	*value = 0;
+
+	while ((index < length) && (g_ascii_isspace (data [index]) || (data [index] == '#')))
+	{
+		if (data [index] == '#')
+		{
+			while ((index < length) && (data [index] != '\n'))
+			{
+				index++;
+			}
+		}
+		else
+		{
+			index++;
+		}
+	}
+
+	result = (index < length) && g_ascii_isdigit (data [index]);
+
+	while ((index < length) && g_ascii_isdigit (data [index]) && (*value <= MAPPED_MAX_SIZE))
+	{
+		*value = *value * 10 + g_ascii_digit_value (data [index++]);
+	}
+
+	*position = index;
+	return result;
+}
@@ -0,0 +1,276 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include "viewer.h"
+#define PLAYER_CACHE_SIZE    (32 * 1024 * 1024)
+#define PLAYER_DEFAULT_DELAY 100
+#define PLAYER_LOCK          "viewer-player-lock"
+#define PLAYER_MAX_FRAMES    64
+#define PLAYER_MIN_DELAY     20
+#define PLAYER_MIN_FRAMES    2
+#define PLAYER_THREAD        "viewer-player"
+#define TRACE_FRAME          "frame"
+
+typedef struct _ViewerPlayerFrame ViewerPlayerFrame;
+
+/* 合成済みのコマ */
+struct _ViewerPlayerFrame
+{
+	GdkTexture *texture;
+	int         delay;
+};
+
+/* 動画像の再生 */
+struct _ViewerPlayer
+{
+	GdkPixbufAnimation *animation;
+	GMutex             *lock;
+	GThread            *thread;
+	GMutex              mutex;
+	GCond               cond;
+	GQueue              frames;
+	GdkTexture         *texture;
+	gint64              due;
+	guint               capacity;
+	gboolean            stopping;
+};
+
+static ViewerPlayerFrame *viewer_player_create_frame (GdkPixbufAnimationIter *iter);
+static void               viewer_player_free_frame   (ViewerPlayerFrame *frame);
+static void               viewer_player_free_lock    (GMutex *lock);
+static GMutex            *viewer_player_get_lock     (GdkPixbufAnimation *animation);
+static gpointer           viewer_player_run          (gpointer data);
+
+/*******************************************************************************
+表示時刻になったコマへ進めます。メイン スレッドから呼び出します。
+time はフレーム クロックの時刻 (マイクロ秒) です。
+表示するコマが変わった場合は TRUE を返します。先読みが間に合わない場合は今のコマを表示し続けます。
+1 コマ以上遅れた場合は、遅れを取り戻そうとせずに今の時刻から数え直します。
+*/
+gboolean
+viewer_player_advance (ViewerPlayer *self, gint64 time)
+{
+	ViewerPlayerFrame *frame;
+	gint64 delay;
+	gboolean result;
+	result = FALSE;
+
+	if (time >= self->due)
+	{
+		g_mutex_lock (&self->mutex);
+		frame = g_queue_pop_head (&self->frames);
+		g_cond_signal (&self->cond);
+		g_mutex_unlock (&self->mutex);
+
+		if (frame)
+		{
+			g_set_object (&self->texture, frame->texture);
+			delay = frame->delay * G_TIME_SPAN_MILLISECOND;
+
+			if (delay < 0)
+			{
+				self->due = G_MAXINT64;
+			}
+			else if (self->due && (self->due + delay > time))
+			{
+				self->due += delay;
+			}
+			else
+			{
+				self->due = time + delay;
+			}
+
+			viewer_player_free_frame (frame);
+			result = TRUE;
+		}
+	}
+
+	return result;
+}
+
+/*******************************************************************************
+反復子が指しているコマを複製してテクスチャにします。
+反復子の画素は次のコマへ進むときに書き換えられるため、必ず複製します。
+表示時間が 20 ミリ秒未満のコマは、表示する時間だけを 100 ミリ秒にします。
+*/
+static ViewerPlayerFrame *
+viewer_player_create_frame (GdkPixbufAnimationIter *iter)
+{
+	ViewerPlayerFrame *frame;
+	GdkPixbuf *pixbuf;
+	GBytes *bytes;
+	int width, height, stride;
+	gint64 begin;
+	begin = viewer_trace_begin ();
+	pixbuf = gdk_pixbuf_animation_iter_get_pixbuf (iter);
+	width = gdk_pixbuf_get_width (pixbuf);
+	height = gdk_pixbuf_get_height (pixbuf);
+	stride = gdk_pixbuf_get_rowstride (pixbuf);
+	bytes = g_bytes_new (gdk_pixbuf_read_pixels (pixbuf), (gsize) (height - 1) * stride + (gsize) width * gdk_pixbuf_get_n_channels (pixbuf));
+	frame = g_new (ViewerPlayerFrame, 1);
+	frame->texture = gdk_memory_texture_new (width, height, gdk_pixbuf_get_has_alpha (pixbuf) ? GDK_MEMORY_R8G8B8A8 : GDK_MEMORY_R8G8B8, bytes, stride);
+	frame->delay = gdk_pixbuf_animation_iter_get_delay_time (iter);
+
+	if ((frame->delay >= 0) && (frame->delay < PLAYER_MIN_DELAY))
+	{
+		frame->delay = PLAYER_DEFAULT_DELAY;
+	}
+
+	g_bytes_unref (bytes);
+	viewer_trace_end (TRACE_FRAME, begin, (gint64) width * height);
+	return frame;
+}
+
+/*******************************************************************************
+再生を止めて破棄します。メイン スレッドから呼び出します。
+*/
+void
+viewer_player_free (ViewerPlayer *self)
+{
+	g_mutex_lock (&self->mutex);
+	self->stopping = TRUE;
+	g_cond_signal (&self->cond);
+	g_mutex_unlock (&self->mutex);
+	g_thread_join (self->thread);
+	g_queue_clear_full (&self->frames, (GDestroyNotify) viewer_player_free_frame);
+	g_clear_object (&self->texture);
+	g_object_unref (self->animation);
+	g_mutex_clear (&self->mutex);
+	g_cond_clear (&self->cond);
+	g_free (self);
+}
+
+/*******************************************************************************
+コマを破棄します。
+*/
+static void
+viewer_player_free_frame (ViewerPlayerFrame *frame)
+{
+	g_object_unref (frame->texture);
+	g_free (frame);
+}
+
+/*******************************************************************************
+動画像の排他制御を破棄します。
+*/
+static void
+viewer_player_free_lock (GMutex *lock)
+{
+	g_mutex_clear (lock);
+	g_free (lock);
+}
+
+/*******************************************************************************
+動画像の排他制御を取得します。初めての場合は作成して動画像に持たせます。
+キャッシュの同じ動画像を複数の窓で再生する場合、反復子は動画像の合成用の画素を共有して書き換えるため、
+動画像ごとに一つの排他制御で反復子の操作を直列にします。メイン スレッドから呼び出します。
+*/
+static GMutex *
+viewer_player_get_lock (GdkPixbufAnimation *animation)
+{
+	GMutex *lock;
+	lock = g_object_get_data (G_OBJECT (animation), PLAYER_LOCK);
+
+	if (!lock)
+	{
+		lock = g_new (GMutex, 1);
+		g_mutex_init (lock);
+		g_object_set_data_full (G_OBJECT (animation), PLAYER_LOCK, lock, (GDestroyNotify) viewer_player_free_lock);
+	}
+
+	return lock;
+}
+
+/*******************************************************************************
+表示するコマのテクスチャを取得します。最初のコマを合成するまでは NULL を返します。
+*/
+GdkTexture *
+viewer_player_get_texture (ViewerPlayer *self)
+{
+	return self->texture;
+}
+
+/*******************************************************************************
+動画像の再生を開始します。コマは専用のスレッドで合成して先読みします。
+先読みするコマの数は、合成済みの画素が一定の大きさに収まるように決めます。
+*/
+ViewerPlayer *
+viewer_player_new (GdkPixbufAnimation *animation)
+{
+	ViewerPlayer *self;
+	gsize size;
+	self = g_new0 (ViewerPlayer, 1);
+	self->animation = g_object_ref (animation);
+	self->lock = viewer_player_get_lock (animation);
+	size = MAX ((gsize) gdk_pixbuf_animation_get_width (animation) * gdk_pixbuf_animation_get_height (animation) * 4, 1);
+	self->capacity = CLAMP (PLAYER_CACHE_SIZE / size, PLAYER_MIN_FRAMES, PLAYER_MAX_FRAMES);
+	g_mutex_init (&self->mutex);
+	g_cond_init (&self->cond);
+	g_queue_init (&self->frames);
+	self->thread = g_thread_new (PLAYER_THREAD, viewer_player_run, self);
+	return self;
+}
+
+/*******************************************************************************
+コマを順に合成して先読みします。先読みしたコマが上限に達したら、表示して空きができるまで待ちます。
+時刻は実際の時刻ではなく各コマの表示時間を足し合わせて進めるので、合成が遅れてもコマを飛ばしません。
+反復子は経過時間からコマを選ぶので、表示時間を延ばした短いコマでも、反復子は元の表示時間だけ進めます。
+反復子の作成、合成、進行、破棄は動画像の排他制御を取得して行います。
+最後のコマの表示時間が無限の場合は、そのコマを渡して終了します。
+*/
+static gpointer
+viewer_player_run (gpointer data)
+{
+	ViewerPlayer *self;
+	ViewerPlayerFrame *frame;
+	GdkPixbufAnimationIter *iter;
+	GTimeVal time = { 0 };
+	gboolean stopping;
+	int delay;
+	self = data;
+	G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+	g_mutex_lock (self->lock);
+	iter = gdk_pixbuf_animation_get_iter (self->animation, &time);
+	g_mutex_unlock (self->lock);
+
+	do
+	{
+		g_mutex_lock (self->lock);
+		frame = viewer_player_create_frame (iter);
+		delay = gdk_pixbuf_animation_iter_get_delay_time (iter);
+		g_mutex_unlock (self->lock);
+		g_mutex_lock (&self->mutex);
+
+		while (!self->stopping && (self->frames.length >= self->capacity))
+		{
+			g_cond_wait (&self->cond, &self->mutex);
+		}
+
+		stopping = self->stopping || (delay < 0);
+
+		if (self->stopping)
+		{
+			viewer_player_free_frame (frame);
+		}
+		else
+		{
+			g_queue_push_tail (&self->frames, frame);
+		}
+
+		g_mutex_unlock (&self->mutex);
+
+		if (!stopping)
+		{
+			g_time_val_add (&time, delay * 1000L);
+			g_mutex_lock (self->lock);
+			gdk_pixbuf_animation_iter_advance (iter, &time);
+			g_mutex_unlock (self->lock);
+		}
+	}
+	while (!stopping);
+
+	G_GNUC_END_IGNORE_DEPRECATIONS
+	g_mutex_lock (self->lock);
+	g_object_unref (iter);
+	g_mutex_unlock (self->lock);
+	return NULL;
+}
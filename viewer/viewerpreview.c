@@ -0,0 +1,303 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include <string.h>
+#include "viewer.h"
+#define EXIF_HEADER             "Exif\0\0"
+#define EXIF_HEADER_SIZE        6
+#define EXIF_TAG_OFFSET         0x0201
+#define EXIF_TAG_SIZE           0x0202
+#define JPEG_APP1               0xE1
+#define JPEG_DAC                0xCC
+#define JPEG_DHT                0xC4
+#define JPEG_EOI                0xD9
+#define JPEG_JPG                0xC8
+#define JPEG_MARKER             0xFF
+#define JPEG_RST0               0xD0
+#define JPEG_RST7               0xD7
+#define JPEG_SOF0               0xC0
+#define JPEG_SOF15              0xCF
+#define JPEG_SOI                0xD8
+#define JPEG_SOS                0xDA
+#define JPEG_TEM                0x01
+#define PREVIEW_BUFFER_SIZE     (64 * 1024)
+#define PREVIEW_HEAD_SIZE       (128 * 1024)
+#define PREVIEW_MAX_DENOMINATOR 8
+#define TIFF_BIG_ENDIAN         "MM"
+#define TIFF_LITTLE_ENDIAN      "II"
+#define TIFF_MAGIC              42
+#define TRACE_PREVIEW           "preview"
+
+typedef struct _ViewerPreviewJpeg ViewerPreviewJpeg;
+
+/* JPEG ファイルの先頭から読み取った情報 */
+struct _ViewerPreviewJpeg
+{
+	gsize thumbnail_offset;
+	gsize thumbnail_size;
+	int   width;
+	int   height;
+};
+
+static GdkPixbuf *viewer_preview_decode_memory (const guchar *data, gsize length);
+static GdkPixbuf *viewer_preview_decode_scaled (GFile *file, const ViewerPreviewJpeg *jpeg, int width, int height, GCancellable *cancellable);
+static void       viewer_preview_parse_exif    (const guchar *data, gsize length, gsize base, ViewerPreviewJpeg *jpeg);
+static gboolean   viewer_preview_parse_jpeg    (const guchar *data, gsize length, ViewerPreviewJpeg *jpeg);
+static gsize      viewer_preview_read_head     (GFile *file, guchar *buffer, GCancellable *cancellable);
+static guint      viewer_preview_read16        (const guchar *data, gboolean big_endian);
+static guint32    viewer_preview_read32        (const guchar *data, gboolean big_endian);
+
+/*******************************************************************************
+表示領域の大きさに合わせた下見用の画像を作成します。任意のスレッドから呼び出せます。
+JPEG ファイルに埋め込まれた縮小画像を使用し、ない場合は 1/2、1/4、1/8 に縮小して展開します。
+作成できない場合は NULL を返します。
+*/
+ViewerImage *
+viewer_preview_create (GFile *file, int width, int height, GCancellable *cancellable)
+{
+	ViewerPreviewJpeg jpeg;
+	ViewerImage *image;
+	GdkPixbuf *pixbuf;
+	guchar *head;
+	gsize length;
+	gint64 begin;
+	begin = viewer_trace_begin ();
+	head = g_malloc (PREVIEW_HEAD_SIZE);
+	length = viewer_preview_read_head (file, head, cancellable);
+	image = NULL;
+
+	if (viewer_preview_parse_jpeg (head, length, &jpeg))
+	{
+		pixbuf = jpeg.thumbnail_size ? viewer_preview_decode_memory (head + jpeg.thumbnail_offset, jpeg.thumbnail_size) : NULL;
+
+		if (!pixbuf)
+		{
+			pixbuf = viewer_preview_decode_scaled (file, &jpeg, width, height, cancellable);
+		}
+		if (pixbuf)
+		{
+			image = viewer_image_new_scaled (jpeg.width, jpeg.height, gdk_pixbuf_get_width (pixbuf), gdk_pixbuf_get_height (pixbuf));
+			viewer_image_write (image, gdk_pixbuf_read_pixels (pixbuf), gdk_pixbuf_get_rowstride (pixbuf), gdk_pixbuf_get_n_channels (pixbuf), 0, 0, gdk_pixbuf_get_width (pixbuf), gdk_pixbuf_get_height (pixbuf));
+			g_object_unref (pixbuf);
+		}
+	}
+
+	g_free (head);
+	viewer_trace_end (TRACE_PREVIEW, begin, image ? (gint64) viewer_image_get_width (image) * viewer_image_get_height (image) : 0);
+	return image;
+}
+
+/*******************************************************************************
+メモリ上の画像を展開します。
+*/
+static GdkPixbuf *
+viewer_preview_decode_memory (const guchar *data, gsize length)
+{
+	GdkPixbufLoader *loader;
+	GdkPixbuf *pixbuf;
+	loader = gdk_pixbuf_loader_new ();
+
+	if (gdk_pixbuf_loader_write (loader, data, length, NULL) && gdk_pixbuf_loader_close (loader, NULL))
+	{
+		pixbuf = g_object_ref (gdk_pixbuf_loader_get_pixbuf (loader));
+	}
+	else
+	{
+		gdk_pixbuf_loader_close (loader, NULL);
+		pixbuf = NULL;
+	}
+
+	g_object_unref (loader);
+	return pixbuf;
+}
+
+/*******************************************************************************
+表示領域を覆う大きさを保つ範囲で、JPEG ファイルを最も小さく縮小して展開します。
+JPEG の展開器は DCT の段階で 1/2、1/4、1/8 に縮小します。縮小できない場合は NULL を返します。
+*/
+static GdkPixbuf *
+viewer_preview_decode_scaled (GFile *file, const ViewerPreviewJpeg *jpeg, int width, int height, GCancellable *cancellable)
+{
+	GdkPixbufLoader *loader;
+	GFileInputStream *input;
+	GdkPixbuf *pixbuf;
+	guchar *buffer;
+	gssize length;
+	int denominator;
+	denominator = PREVIEW_MAX_DENOMINATOR;
+
+	while ((denominator > 1) && (((jpeg->width + denominator - 1) / denominator < width) || ((jpeg->height + denominator - 1) / denominator < height)))
+	{
+		denominator /= 2;
+	}
+
+	pixbuf = NULL;
+
+	if ((denominator > 1) && (input = g_file_read (file, cancellable, NULL)))
+	{
+		loader = gdk_pixbuf_loader_new ();
+		gdk_pixbuf_loader_set_size (loader, (jpeg->width + denominator - 1) / denominator, (jpeg->height + denominator - 1) / denominator);
+		buffer = g_malloc (PREVIEW_BUFFER_SIZE);
+
+		do
+		{
+			length = g_input_stream_read (G_INPUT_STREAM (input), buffer, PREVIEW_BUFFER_SIZE, cancellable, NULL);
+		}
+		while ((length > 0) && gdk_pixbuf_loader_write (loader, buffer, length, NULL));
+
+		if (gdk_pixbuf_loader_close (loader, NULL) && !length)
+		{
+			pixbuf = g_object_ref (gdk_pixbuf_loader_get_pixbuf (loader));
+		}
+
+		g_free (buffer);
+		g_object_unref (loader);
+		g_object_unref (input);
+	}
+
+	return pixbuf;
+}
+
+/*******************************************************************************
+Exif の 2 番目の IFD から、埋め込まれた縮小画像の位置を読み取ります。
+base はファイル先頭から data までのバイト数です。
+*/
+static void
+viewer_preview_parse_exif (const guchar *data, gsize length, gsize base, ViewerPreviewJpeg *jpeg)
+{
+	const guchar *tiff, *entry;
+	gboolean big_endian;
+	gsize ifd, count, offset, size, n;
+
+	if ((length >= EXIF_HEADER_SIZE + 8) && !memcmp (data, EXIF_HEADER, EXIF_HEADER_SIZE))
+	{
+		tiff = data + EXIF_HEADER_SIZE;
+		length -= EXIF_HEADER_SIZE;
+		big_endian = !memcmp (tiff, TIFF_BIG_ENDIAN, 2);
+
+		if ((big_endian || !memcmp (tiff, TIFF_LITTLE_ENDIAN, 2)) && (viewer_preview_read16 (tiff + 2, big_endian) == TIFF_MAGIC))
+		{
+			ifd = viewer_preview_read32 (tiff + 4, big_endian);
+
+			if ((ifd <= length - 2) && ((count = viewer_preview_read16 (tiff + ifd, big_endian)) * 12 + 6 <= length - ifd))
+			{
+				ifd = viewer_preview_read32 (tiff + ifd + 2 + count * 12, big_endian);
+
+				if (ifd && (ifd <= length - 2) && ((count = viewer_preview_read16 (tiff + ifd, big_endian)) * 12 + 2 <= length - ifd))
+				{
+					offset = 0;
+					size = 0;
+
+					for (n = 0; n < count; n++)
+					{
+						entry = tiff + ifd + 2 + n * 12;
+
+						switch (viewer_preview_read16 (entry, big_endian))
+						{
+						case EXIF_TAG_OFFSET:
+							offset = viewer_preview_read32 (entry + 8, big_endian);
+							break;
+						case EXIF_TAG_SIZE:
+							size = viewer_preview_read32 (entry + 8, big_endian);
+							break;
+						}
+					}
+					if (offset && size && (offset <= length) && (size <= length - offset))
+					{
+						jpeg->thumbnail_offset = base + EXIF_HEADER_SIZE + offset;
+						jpeg->thumbnail_size = size;
+					}
+				}
+			}
+		}
+	}
+}
+
+/*******************************************************************************
+JPEG ファイルの先頭を読み取り、画像の大きさと埋め込まれた縮小画像の位置を取得します。
+画像の大きさが分からない場合は FALSE を返します。
+*/
+static gboolean
+viewer_preview_parse_jpeg (const guchar *data, gsize length, ViewerPreviewJpeg *jpeg)
+{
+	gsize offset, size;
+	guint marker;
+	memset (jpeg, 0, sizeof (ViewerPreviewJpeg));
+	offset = 2;
+
+	if ((length >= 2) && (data [0] == JPEG_MARKER) && (data [1] == JPEG_SOI))
+	{
+		while (!jpeg->width && (offset + 4 <= length) && (data [offset] == JPEG_MARKER))
+		{
+			marker = data [offset + 1];
+
+			if (marker == JPEG_MARKER)
+			{
+				offset++;
+			}
+			else if ((marker == JPEG_TEM) || (marker == JPEG_SOI) || ((marker >= JPEG_RST0) && (marker <= JPEG_RST7)))
+			{
+				offset += 2;
+			}
+			else if ((marker == JPEG_EOI) || (marker == JPEG_SOS) || ((size = viewer_preview_read16 (data + offset + 2, TRUE)) < 2))
+			{
+				break;
+			}
+			else
+			{
+				if ((marker == JPEG_APP1) && !jpeg->thumbnail_size && (size - 2 <= length - offset - 4))
+				{
+					viewer_preview_parse_exif (data + offset + 4, size - 2, offset + 4, jpeg);
+				}
+				else if ((marker >= JPEG_SOF0) && (marker <= JPEG_SOF15) && (marker != JPEG_DHT) && (marker != JPEG_JPG) && (marker != JPEG_DAC) && (size >= 7) && (offset + 9 <= length))
+				{
+					jpeg->height = viewer_preview_read16 (data + offset + 5, TRUE);
+					jpeg->width = viewer_preview_read16 (data + offset + 7, TRUE);
+				}
+
+				offset += 2 + size;
+			}
+		}
+	}
+
+	return (jpeg->width > 0) && (jpeg->height > 0);
+}
+
+/*******************************************************************************
+ファイルの先頭を読み取ります。読み取ったバイト数を返します。
+*/
+static gsize
+viewer_preview_read_head (GFile *file, guchar *buffer, GCancellable *cancellable)
+{
+	GFileInputStream *input;
+	gsize length;
+	length = 0;
+	input = g_file_read (file, cancellable, NULL);
+
+	if (input)
+	{
+		g_input_stream_read_all (G_INPUT_STREAM (input), buffer, PREVIEW_HEAD_SIZE, &length, cancellable, NULL);
+		g_object_unref (input);
+	}
+
+	return length;
+}
+
+/*******************************************************************************
+16 ビットの整数を読み取ります。
+*/
+static guint
+viewer_preview_read16 (const guchar *data, gboolean big_endian)
+{
+	return big_endian ? (data [0] << 8 | data [1]) : (data [1] << 8 | data [0]);
+}
+
+/*******************************************************************************
+32 ビットの整数を読み取ります。
+*/
+static guint32
+viewer_preview_read32 (const guchar *data, gboolean big_endian)
+{
+	return big_endian ?
+		((guint32) data [0] << 24 | (guint32) data [1] << 16 | (guint32) data [2] << 8 | data [3]) :
+		((guint32) data [3] << 24 | (guint32) data [2] << 16 | (guint32) data [1] << 8 | data [0]);
+}
@@ -0,0 +1,392 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#include "viewer.h"
+#define STORE_ALIGN         4096
+#define STORE_CAPACITY      (256 * 1024 * 1024)
+#define STORE_DIRECTORY     "com.github.mi19a009.PictureViewer"
+#define STORE_EDGE          1024
+#define STORE_MAGIC         "VWSTORE1"
+#define STORE_MAGIC_SIZE    8
+#define STORE_MAX_LEVELS    8
+#define STORE_PIXEL         4
+#define STORE_PRUNE_TARGET  (STORE_CAPACITY / 4 * 3)
+#define STORE_SUBDIRECTORY  "pyramids"
+#define STORE_TILE_SIZE     256
+#define TRACE_STORE_HIT     "store-hit"
+#define TRACE_STORE_MISS    "store-miss"
+#define TRACE_STORE_SAVE    "store-save"
+
+typedef struct _ViewerStore       ViewerStore;
+typedef struct _ViewerStoreEntry  ViewerStoreEntry;
+typedef struct _ViewerStoreHeader ViewerStoreHeader;
+
+/* 保存した縮小画像の配置 */
+struct _ViewerStore
+{
+	GMappedFile  *mapped;
+	const guchar *data;
+	gsize         offsets [STORE_MAX_LEVELS];
+	int           widths [STORE_MAX_LEVELS];
+	int           heights [STORE_MAX_LEVELS];
+	int           n_levels;
+	int           width;
+	int           height;
+};
+
+/* キャッシュ ディレクトリーのファイル */
+struct _ViewerStoreEntry
+{
+	char  *path;
+	gint64 time;
+	gint64 size;
+};
+
+/* 縮小画像ファイルの先頭 */
+struct _ViewerStoreHeader
+{
+	char    magic [STORE_MAGIC_SIZE];
+	guint32 width;
+	guint32 height;
+	guint32 pixel_width;
+	guint32 pixel_height;
+	guint32 n_levels;
+	guint32 key_length;
+};
+
+static int      viewer_store_compare    (gconstpointer a, gconstpointer b);
+static void     viewer_store_free       (ViewerStore *store);
+static void     viewer_store_free_entry (ViewerStoreEntry *entry);
+static char    *viewer_store_get_path   (const char *key);
+static gsize    viewer_store_measure    (ViewerStore *store, int pixel_width, int pixel_height, gsize key_length);
+static void     viewer_store_prune      (const char *directory);
+static void     viewer_store_read       (gpointer data, int level, int x, int y, int width, int height, guchar *destination, int destination_stride);
+static void     viewer_store_write      (const ViewerStore *store, int level, const guchar *source, int source_stride, guchar *destination);
+
+/*******************************************************************************
+ファイルを更新日時の古い順に並べます。
+*/
+static int
+viewer_store_compare (gconstpointer a, gconstpointer b)
+{
+	const ViewerStoreEntry *entry1, *entry2;
+	entry1 = *(ViewerStoreEntry * const *) a;
+	entry2 = *(ViewerStoreEntry * const *) b;
+	return (entry1->time > entry2->time) - (entry1->time < entry2->time);
+}
+
+/*******************************************************************************
+縮小画像ファイルの割り当てを解除します。
+*/
+static void
+viewer_store_free (ViewerStore *store)
+{
+	g_clear_pointer (&store->mapped, g_mapped_file_unref);
+	g_free (store);
+}
+
+/*******************************************************************************
+ファイルの情報を破棄します。
+*/
+static void
+viewer_store_free_entry (ViewerStoreEntry *entry)
+{
+	g_free (entry->path);
+	g_free (entry);
+}
+
+/*******************************************************************************
+キーに対応する縮小画像ファイルのパスを作成します。ファイル名はキーのハッシュ値です。
+*/
+static char *
+viewer_store_get_path (const char *key)
+{
+	char *name, *path;
+	name = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+	path = g_build_filename (g_get_user_cache_dir (), STORE_DIRECTORY, STORE_SUBDIRECTORY, name, NULL);
+	g_free (name);
+	return path;
+}
+
+/*******************************************************************************
+以前に保存した縮小画像を開きます。任意のスレッドから呼び出せます。
+ファイルのパス、更新日時、大きさ、inode がすべて保存したときと同じ場合だけ使用します。
+縮小画像ファイルはメモリへ割り当て、区画は表示するときに読み取ります。
+作成した画像は元の画像の大きさを持ち、保存した画素数で表示します。保存していない場合は NULL を返します。
+*/
+ViewerImage *
+viewer_store_lookup (GFile *file)
+{
+	const ViewerStoreHeader *header;
+	ViewerStore *store;
+	ViewerImage *image;
+	GMappedFile *mapped;
+	char *key, *path;
+	gsize length;
+	image = NULL;
+	key = viewer_cache_get_key (file, NULL, NULL);
+	path = key ? viewer_store_get_path (key) : NULL;
+	mapped = path ? g_mapped_file_new (path, FALSE, NULL) : NULL;
+
+	if (mapped)
+	{
+		header = (const ViewerStoreHeader *) g_mapped_file_get_contents (mapped);
+		length = g_mapped_file_get_length (mapped);
+		store = g_new0 (ViewerStore, 1);
+
+		if ((length >= sizeof (ViewerStoreHeader))
+		&& !memcmp (header->magic, STORE_MAGIC, STORE_MAGIC_SIZE)
+		&& (header->key_length == strlen (key))
+		&& (length >= sizeof (ViewerStoreHeader) + header->key_length)
+		&& !memcmp (header + 1, key, header->key_length)
+		&& (header->pixel_width > 0) && (header->pixel_width <= STORE_EDGE)
+		&& (header->pixel_height > 0) && (header->pixel_height <= STORE_EDGE)
+		&& (header->width >= header->pixel_width) && (header->width <= G_MAXINT)
+		&& (header->height >= header->pixel_height) && (header->height <= G_MAXINT)
+		&& (viewer_store_measure (store, header->pixel_width, header->pixel_height, header->key_length) == length)
+		&& (header->n_levels == (guint32) store->n_levels))
+		{
+			store->mapped = mapped;
+			store->data = (const guchar *) header;
+			image = viewer_image_new_scaled (header->width, header->height, header->pixel_width, header->pixel_height);
+			viewer_image_set_reader (image, viewer_store_read, store, (GDestroyNotify) viewer_store_free);
+			g_utime (path, NULL);
+		}
+		else
+		{
+			g_mapped_file_unref (mapped);
+			g_free (store);
+		}
+	}
+
+	viewer_trace_count (image ? TRACE_STORE_HIT : TRACE_STORE_MISS, 1);
+	g_free (path);
+	g_free (key);
+	return image;
+}
+
+/*******************************************************************************
+縮小画像の各段階の大きさと、ファイル内の位置を求めます。返り値はファイル全体の大きさです。
+段階は画像の区画と同じ規則で、区画が 1 つになるまで縦横を半分にします。
+画素は段階ごとに、区画ごとに連続して並べるので、1 つの区画は連続した領域から読み取れます。
+*/
+static gsize
+viewer_store_measure (ViewerStore *store, int pixel_width, int pixel_height, gsize key_length)
+{
+	gsize offset;
+	int level;
+	offset = (sizeof (ViewerStoreHeader) + key_length + STORE_ALIGN - 1) / STORE_ALIGN * STORE_ALIGN;
+	store->width = pixel_width;
+	store->height = pixel_height;
+
+	for (level = 0; level < STORE_MAX_LEVELS; level++)
+	{
+		store->offsets [level] = offset;
+		store->widths [level] = pixel_width;
+		store->heights [level] = pixel_height;
+		store->n_levels = level + 1;
+		offset += (gsize) pixel_width * pixel_height * STORE_PIXEL;
+
+		if (MAX (pixel_width, pixel_height) <= STORE_TILE_SIZE)
+		{
+			break;
+		}
+
+		pixel_width = (pixel_width + 1) / 2;
+		pixel_height = (pixel_height + 1) / 2;
+	}
+
+	return offset;
+}
+
+/*******************************************************************************
+キャッシュ ディレクトリーの合計が上限を超えた場合は、最も長く使用していないファイルから削除します。
+何度も続けて削除しないように、上限より少し小さくなるまで削除します。
+*/
+static void
+viewer_store_prune (const char *directory)
+{
+	ViewerStoreEntry *entry;
+	GPtrArray *entries;
+	GStatBuf status;
+	GDir *dir;
+	const char *name;
+	gint64 total;
+	guint n;
+	dir = g_dir_open (directory, 0, NULL);
+
+	if (dir)
+	{
+		entries = g_ptr_array_new_with_free_func ((GDestroyNotify) viewer_store_free_entry);
+		total = 0;
+
+		while ((name = g_dir_read_name (dir)))
+		{
+			entry = g_new (ViewerStoreEntry, 1);
+			entry->path = g_build_filename (directory, name, NULL);
+
+			if (!g_stat (entry->path, &status))
+			{
+				entry->time = status.st_mtime;
+				entry->size = status.st_size;
+				total += entry->size;
+				g_ptr_array_add (entries, entry);
+			}
+			else
+			{
+				viewer_store_free_entry (entry);
+			}
+		}
+		if (total > STORE_CAPACITY)
+		{
+			g_ptr_array_sort (entries, viewer_store_compare);
+
+			for (n = 0; (n < entries->len) && (total > STORE_PRUNE_TARGET); n++)
+			{
+				entry = g_ptr_array_index (entries, n);
+
+				if (!g_remove (entry->path))
+				{
+					total -= entry->size;
+				}
+			}
+		}
+
+		g_ptr_array_unref (entries);
+		g_dir_close (dir);
+	}
+}
+
+/*******************************************************************************
+割り当てた縮小画像ファイルから区画の画素を読み取ります。
+画像は区画ごとに呼び出すので、要求される範囲は常に 1 つの区画に収まります。
+*/
+static void
+viewer_store_read (gpointer data, int level, int x, int y, int width, int height, guchar *destination, int destination_stride)
+{
+	ViewerStore *store;
+	const guchar *source;
+	int tile_width, tile_height, line;
+	store = data;
+	tile_width = MIN (STORE_TILE_SIZE, store->widths [level] - x / STORE_TILE_SIZE * STORE_TILE_SIZE);
+	tile_height = MIN (STORE_TILE_SIZE, store->heights [level] - y / STORE_TILE_SIZE * STORE_TILE_SIZE);
+	source = store->data + store->offsets [level]
+		+ (gsize) (y / STORE_TILE_SIZE) * STORE_TILE_SIZE * store->widths [level] * STORE_PIXEL
+		+ (gsize) (x / STORE_TILE_SIZE) * STORE_TILE_SIZE * tile_height * STORE_PIXEL
+		+ (gsize) (y % STORE_TILE_SIZE) * tile_width * STORE_PIXEL
+		+ (gsize) (x % STORE_TILE_SIZE) * STORE_PIXEL;
+
+	for (line = 0; line < height; line++)
+	{
+		memcpy (destination + (gsize) line * destination_stride, source + (gsize) line * tile_width * STORE_PIXEL, (gsize) width * STORE_PIXEL);
+	}
+}
+
+/*******************************************************************************
+大きな画像の縮小画像をキャッシュ ディレクトリーへ保存します。任意のスレッドから呼び出せます。
+長辺が一定の大きさになるように面積平均で縮小し、さらに半分ずつ縮小した段階と合わせて書き込みます。
+小さな画像はすぐに展開できるので保存しません。保存した後は、合計が上限を超えないように古いファイルを削除します。
+*/
+void
+viewer_store_save (GFile *file, ViewerImage *image)
+{
+	static GMutex mutex;
+	ViewerStoreHeader *header;
+	ViewerStore store;
+	GdkTexture *texture;
+	guchar *buffer, *level_pixels, *next_pixels;
+	char *key, *path, *directory;
+	double zoom;
+	gsize length, key_length;
+	gint64 begin;
+	int width, height, level;
+	width = viewer_image_get_width (image);
+	height = viewer_image_get_height (image);
+
+	if (MAX (width, height) > STORE_EDGE)
+	{
+		begin = viewer_trace_begin ();
+		key = viewer_cache_get_key (file, NULL, NULL);
+		zoom = (double) STORE_EDGE / MAX (width, height);
+		width = CLAMP ((int) (zoom * width), 1, STORE_EDGE);
+		height = CLAMP ((int) (zoom * height), 1, STORE_EDGE);
+		texture = key ? viewer_image_render (image, zoom, width, height) : NULL;
+
+		if (texture)
+		{
+			key_length = strlen (key);
+			length = viewer_store_measure (&store, width, height, key_length);
+			buffer = g_malloc0 (length);
+			header = (ViewerStoreHeader *) buffer;
+			memcpy (header->magic, STORE_MAGIC, STORE_MAGIC_SIZE);
+			header->width = viewer_image_get_width (image);
+			header->height = viewer_image_get_height (image);
+			header->pixel_width = width;
+			header->pixel_height = height;
+			header->n_levels = store.n_levels;
+			header->key_length = key_length;
+			memcpy (header + 1, key, key_length);
+			level_pixels = g_malloc ((gsize) width * height * STORE_PIXEL);
+			next_pixels = g_malloc ((gsize) ((width + 1) / 2) * ((height + 1) / 2) * STORE_PIXEL);
+			gdk_texture_download (texture, level_pixels, (gsize) width * STORE_PIXEL);
+
+			for (level = 0; level < store.n_levels; level++)
+			{
+				viewer_store_write (&store, level, level_pixels, store.widths [level] * STORE_PIXEL, buffer);
+
+				if (level + 1 < store.n_levels)
+				{
+					viewer_convert_halve (level_pixels, store.widths [level] * STORE_PIXEL, store.widths [level], store.heights [level], next_pixels, store.widths [level + 1] * STORE_PIXEL);
+					memcpy (level_pixels, next_pixels, (gsize) store.widths [level + 1] * store.heights [level + 1] * STORE_PIXEL);
+				}
+			}
+
+			path = viewer_store_get_path (key);
+			directory = g_path_get_dirname (path);
+			g_mutex_lock (&mutex);
+
+			if (!g_mkdir_with_parents (directory, 0700) && g_file_set_contents (path, (const char *) buffer, length, NULL))
+			{
+				viewer_store_prune (directory);
+			}
+
+			g_mutex_unlock (&mutex);
+			g_free (directory);
+			g_free (path);
+			g_free (next_pixels);
+			g_free (level_pixels);
+			g_free (buffer);
+			g_object_unref (texture);
+		}
+
+		g_free (key);
+		viewer_trace_end (TRACE_STORE_SAVE, begin, (gint64) width * height);
+	}
+}
+
+/*******************************************************************************
+1 つの段階の画素を区画ごとに並べ替えて、縮小画像ファイルの領域へ書き込みます。
+*/
+static void
+viewer_store_write (const ViewerStore *store, int level, const guchar *source, int source_stride, guchar *destination)
+{
+	int x, y, tile_width, tile_height, line;
+	destination += store->offsets [level];
+
+	for (y = 0; y < store->heights [level]; y += STORE_TILE_SIZE)
+	{
+		tile_height = MIN (STORE_TILE_SIZE, store->heights [level] - y);
+
+		for (x = 0; x < store->widths [level]; x += STORE_TILE_SIZE)
+		{
+			tile_width = MIN (STORE_TILE_SIZE, store->widths [level] - x);
+
+			for (line = 0; line < tile_height; line++)
+			{
+				memcpy (destination, source + (gsize) (y + line) * source_stride + (gsize) x * STORE_PIXEL, (gsize) tile_width * STORE_PIXEL);
+				destination += (gsize) tile_width * STORE_PIXEL;
+			}
+		}
+	}
+}
@@ -0,0 +1,399 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include <string.h>
+#include "viewer.h"
+#define JPEG_DAC             0xCC
+#define JPEG_DHT             0xC4
+#define JPEG_DRI             0xDD
+#define JPEG_EOI             0xD9
+#define JPEG_JPG             0xC8
+#define JPEG_MARKER          0xFF
+#define JPEG_RST0            0xD0
+#define JPEG_RST7            0xD7
+#define JPEG_SOF0            0xC0
+#define JPEG_SOF1            0xC1
+#define JPEG_SOF15           0xCF
+#define JPEG_SOI             0xD8
+#define JPEG_SOS             0xDA
+#define JPEG_STUFF           0x00
+#define JPEG_TEM             0x01
+#define STRIP_MAX_COMPONENTS 4
+#define STRIP_MIN_PIXELS     (4 * 1024 * 1024)
+#define STRIP_PER_THREAD     4
+#define TRACE_STRIP          "strip"
+#define TRACE_STRIPS         "strips"
+
+typedef struct _ViewerStrip        ViewerStrip;
+typedef struct _ViewerStripJob     ViewerStripJob;
+typedef struct _ViewerStripSegment ViewerStripSegment;
+
+/* 分割して展開する JPEG ファイル */
+struct _ViewerStrip
+{
+	const guchar *data;
+	GArray       *segments;
+	GCancellable *cancellable;
+	GMutex        mutex;
+	GCond         cond;
+	gsize         header_length;
+	gsize         height_offset;
+	int           width;
+	int           height;
+	int           mcu_width;
+	int           mcu_height;
+	int           interval;
+	int           pending;
+	gint          failed;
+};
+
+/* 1 つの帯の展開 */
+struct _ViewerStripJob
+{
+	ViewerStrip *strip;
+	ViewerImage *image;
+	int          first;
+	int          last;
+	int          top;
+	int          bottom;
+	int          y;
+	int          height;
+};
+
+/* リスタート マーカーで区切られた圧縮データ */
+struct _ViewerStripSegment
+{
+	gsize start;
+	gsize end;
+};
+
+static GBytes      *viewer_strip_assemble    (const ViewerStrip *strip, int first, int last, int height);
+static gpointer     viewer_strip_create_pool (gpointer data);
+static void         viewer_strip_decode      (gpointer data, gpointer user_data);
+static GThreadPool *viewer_strip_get_pool    (void);
+static gboolean     viewer_strip_parse       (ViewerStrip *strip, const guchar *data, gsize length);
+static gboolean     viewer_strip_scan        (ViewerStrip *strip, gsize start, gsize length);
+
+/*******************************************************************************
+リスタート区間 first から last の直前までを、単独で展開できる JPEG ファイルに組み立てます。
+ヘッダーは元のファイルのものを使い、画像の高さを帯の高さに書き換えます。
+リスタート区間の間のマーカーは、展開器が順番を確かめるので RST0 から番号を振り直します。
+*/
+static GBytes *
+viewer_strip_assemble (const ViewerStrip *strip, int first, int last, int height)
+{
+	const ViewerStripSegment *segment;
+	GByteArray *array;
+	guchar marker [2];
+	int n;
+	array = g_byte_array_sized_new (strip->header_length + g_array_index (strip->segments, ViewerStripSegment, last - 1).end - g_array_index (strip->segments, ViewerStripSegment, first).start + 2 * (last - first));
+	g_byte_array_append (array, strip->data, strip->header_length);
+	array->data [strip->height_offset] = (guchar) (height >> 8);
+	array->data [strip->height_offset + 1] = (guchar) height;
+	marker [0] = JPEG_MARKER;
+
+	for (n = first; n < last; n++)
+	{
+		segment = &g_array_index (strip->segments, ViewerStripSegment, n);
+		g_byte_array_append (array, strip->data + segment->start, segment->end - segment->start);
+		marker [1] = (n + 1 < last) ? JPEG_RST0 + (n - first) % 8 : JPEG_EOI;
+		g_byte_array_append (array, marker, 2);
+	}
+
+	return g_byte_array_free_to_bytes (array);
+}
+
+/*******************************************************************************
+帯を展開するスレッド プールを作成します。
+*/
+static gpointer
+viewer_strip_create_pool (gpointer data)
+{
+	return g_thread_pool_new (viewer_strip_decode, NULL, g_get_num_processors (), FALSE, NULL);
+}
+
+/*******************************************************************************
+スレッド プールで 1 つの帯を展開し、画像の担当する行へ書き込みます。
+帯の前後に余分に展開した行は書き込みません。帯ごとに書き込む行は重ならないので、他の帯と同時に書き込めます。
+他の帯の展開に失敗した場合と、読み込みが取り消された場合は展開しません。
+*/
+static void
+viewer_strip_decode (gpointer data, gpointer user_data)
+{
+	ViewerStripJob *job;
+	ViewerStrip *strip;
+	GdkPixbufLoader *loader;
+	GdkPixbuf *pixbuf;
+	GBytes *bytes;
+	gint64 begin;
+	job = data;
+	strip = job->strip;
+	begin = viewer_trace_begin ();
+
+	if (!g_atomic_int_get (&strip->failed) && !g_cancellable_is_cancelled (strip->cancellable))
+	{
+		bytes = viewer_strip_assemble (job->strip, job->first, job->last, job->bottom - job->top);
+		loader = gdk_pixbuf_loader_new ();
+
+		if (gdk_pixbuf_loader_write_bytes (loader, bytes, NULL) && gdk_pixbuf_loader_close (loader, NULL)
+		&& (pixbuf = gdk_pixbuf_loader_get_pixbuf (loader))
+		&& (gdk_pixbuf_get_width (pixbuf) == job->strip->width) && (gdk_pixbuf_get_height (pixbuf) == job->bottom - job->top))
+		{
+			viewer_image_write (job->image, gdk_pixbuf_read_pixels (pixbuf) + (gsize) (job->y - job->top) * gdk_pixbuf_get_rowstride (pixbuf), gdk_pixbuf_get_rowstride (pixbuf), gdk_pixbuf_get_n_channels (pixbuf), 0, job->y, job->strip->width, job->height);
+		}
+		else
+		{
+			gdk_pixbuf_loader_close (loader, NULL);
+			g_atomic_int_set (&strip->failed, TRUE);
+		}
+
+		g_object_unref (loader);
+		g_bytes_unref (bytes);
+	}
+
+	viewer_trace_end (TRACE_STRIP, begin, (gint64) strip->width * job->height);
+	g_mutex_lock (&strip->mutex);
+
+	if (!--strip->pending)
+	{
+		g_cond_signal (&strip->cond);
+	}
+
+	g_mutex_unlock (&strip->mutex);
+}
+
+/*******************************************************************************
+帯を展開するスレッド プールを取得します。全ての読み込みで 1 つのスレッド プールを共有します。
+*/
+static GThreadPool *
+viewer_strip_get_pool (void)
+{
+	static GOnce once = G_ONCE_INIT;
+	return g_once (&once, viewer_strip_create_pool, NULL);
+}
+
+/*******************************************************************************
+リスタート マーカーを持つ JPEG ファイルを、行の範囲ごとの帯に分けて全てのプロセッサーで並列に展開します。
+リスタート区間ごとに DC 成分の予測が初期化されるので、MCU の行の先頭と区間の先頭が一致する位置で分ければ、
+それぞれの帯を独立した JPEG ファイルとして展開できます。
+色差成分を縦に間引いた画像は、帯の境目で上下の行から補間するので、前後の区間も合わせて展開して境目の画素を一致させます。
+帯は全ての読み込みで共有するスレッド プールで展開します。任意のスレッドから呼び出せます。
+分割できない場合や、小さくて分割する必要がない場合、cancellable が取り消された場合は NULL を返します。
+*/
+ViewerImage *
+viewer_strip_open (GFile *file, GCancellable *cancellable)
+{
+	ViewerStripJob *jobs;
+	ViewerStrip strip;
+	ViewerImage *image;
+	GMappedFile *mapped;
+	char *path;
+	gint64 begin;
+	int mcus_per_row, mcu_rows, rows_per_unit, n_units, units_per_strip, n_strips, context, n, a, b, top, bottom;
+	begin = viewer_trace_begin ();
+	path = g_file_get_path (file);
+	mapped = (path && !g_cancellable_is_cancelled (cancellable)) ? g_mapped_file_new (path, FALSE, NULL) : NULL;
+	strip.segments = g_array_new (FALSE, FALSE, sizeof (ViewerStripSegment));
+	image = NULL;
+
+	if (mapped && viewer_strip_parse (&strip, (const guchar *) g_mapped_file_get_contents (mapped), g_mapped_file_get_length (mapped)))
+	{
+		mcus_per_row = (strip.width + strip.mcu_width - 1) / strip.mcu_width;
+		mcu_rows = (strip.height + strip.mcu_height - 1) / strip.mcu_height;
+		a = mcus_per_row;
+		b = strip.interval;
+
+		while (b)
+		{
+			n = a % b;
+			a = b;
+			b = n;
+		}
+
+		rows_per_unit = strip.interval / a;
+		context = (strip.mcu_height > 8) ? rows_per_unit : 0;
+		n_units = (mcu_rows + rows_per_unit - 1) / rows_per_unit;
+		n_strips = MIN (n_units, (int) g_get_num_processors () * STRIP_PER_THREAD);
+
+		if ((n_strips > 1) && ((gint64) strip.width * strip.height >= STRIP_MIN_PIXELS) && (strip.segments->len == ((guint64) mcus_per_row * mcu_rows + strip.interval - 1) / strip.interval))
+		{
+			units_per_strip = (n_units + n_strips - 1) / n_strips;
+			n_strips = (n_units + units_per_strip - 1) / units_per_strip;
+			jobs = g_new (ViewerStripJob, n_strips);
+			image = viewer_image_new (strip.width, strip.height);
+			strip.cancellable = cancellable;
+			strip.pending = n_strips;
+			strip.failed = FALSE;
+			g_mutex_init (&strip.mutex);
+			g_cond_init (&strip.cond);
+
+			for (n = 0; n < n_strips; n++)
+			{
+				a = n * units_per_strip * rows_per_unit;
+				b = MIN ((n + 1) * units_per_strip * rows_per_unit, mcu_rows);
+				top = MAX (a - context, 0);
+				bottom = MIN (b + context, mcu_rows);
+				jobs [n].strip = &strip;
+				jobs [n].image = image;
+				jobs [n].first = (int) ((gint64) top * mcus_per_row / strip.interval);
+				jobs [n].last = MIN ((int) (((gint64) bottom * mcus_per_row + strip.interval - 1) / strip.interval), (int) strip.segments->len);
+				jobs [n].top = top * strip.mcu_height;
+				jobs [n].bottom = MIN (bottom * strip.mcu_height, strip.height);
+				jobs [n].y = a * strip.mcu_height;
+				jobs [n].height = MIN (b * strip.mcu_height, strip.height) - jobs [n].y;
+				g_thread_pool_push (viewer_strip_get_pool (), &jobs [n], NULL);
+			}
+
+			g_mutex_lock (&strip.mutex);
+
+			while (strip.pending)
+			{
+				g_cond_wait (&strip.cond, &strip.mutex);
+			}
+
+			g_mutex_unlock (&strip.mutex);
+			g_mutex_clear (&strip.mutex);
+			g_cond_clear (&strip.cond);
+			g_free (jobs);
+
+			if (strip.failed || g_cancellable_is_cancelled (cancellable))
+			{
+				g_clear_object (&image);
+			}
+		}
+	}
+
+	g_array_unref (strip.segments);
+	g_clear_pointer (&mapped, g_mapped_file_unref);
+	g_free (path);
+	viewer_trace_end (TRACE_STRIPS, begin, image ? (gint64) strip.width * strip.height : 0);
+	return image;
+}
+
+/*******************************************************************************
+JPEG ファイルのヘッダーを解析します。
+分割できるのは、リスタート間隔を持ち、全ての成分を 1 回の走査で符号化した逐次方式の画像です。
+*/
+static gboolean
+viewer_strip_parse (ViewerStrip *strip, const guchar *data, gsize length)
+{
+	gsize offset, size;
+	int marker, n, n_components, max_h, max_v;
+	gboolean result, done;
+	result = (length >= 4) && (data [0] == JPEG_MARKER) && (data [1] == JPEG_SOI);
+	done = FALSE;
+	offset = 2;
+	n_components = 0;
+	strip->data = data;
+	strip->interval = 0;
+	strip->width = 0;
+
+	while (result && !done)
+	{
+		while ((offset < length) && (data [offset] == JPEG_MARKER))
+		{
+			offset++;
+		}
+
+		marker = (offset < length) ? data [offset++] : JPEG_EOI;
+		size = (offset + 2 <= length) ? (gsize) (data [offset] << 8 | data [offset + 1]) : 0;
+		result = (marker != JPEG_EOI) && (marker != JPEG_TEM) && !((marker >= JPEG_RST0) && (marker <= JPEG_RST7)) && (size >= 2) && (offset + size <= length);
+
+		if (!result)
+		{
+			done = TRUE;
+		}
+		else if ((marker >= JPEG_SOF0) && (marker <= JPEG_SOF15) && (marker != JPEG_DHT) && (marker != JPEG_JPG) && (marker != JPEG_DAC))
+		{
+			n_components = (size >= 8) ? data [offset + 7] : 0;
+			result = ((marker == JPEG_SOF0) || (marker == JPEG_SOF1)) && (data [offset + 2] == 8) && (n_components >= 1) && (n_components <= STRIP_MAX_COMPONENTS) && (size == 8 + 3 * (gsize) n_components);
+			max_h = max_v = 1;
+
+			for (n = 0; result && (n < n_components); n++)
+			{
+				max_h = MAX (max_h, data [offset + 9 + 3 * n] >> 4);
+				max_v = MAX (max_v, data [offset + 9 + 3 * n] & 0x0F);
+			}
+			if (result)
+			{
+				strip->height_offset = offset + 3;
+				strip->height = data [offset + 3] << 8 | data [offset + 4];
+				strip->width = data [offset + 5] << 8 | data [offset + 6];
+				strip->mcu_width = 8 * max_h;
+				strip->mcu_height = 8 * max_v;
+				result = strip->width && strip->height;
+			}
+		}
+		else if (marker == JPEG_DRI)
+		{
+			strip->interval = (size >= 4) ? data [offset + 2] << 8 | data [offset + 3] : 0;
+		}
+		else if (marker == JPEG_SOS)
+		{
+			result = strip->width && strip->interval && (size >= 3) && (data [offset + 2] == n_components);
+			strip->header_length = offset + size;
+			done = TRUE;
+		}
+
+		offset += size;
+	}
+
+	return result && viewer_strip_scan (strip, strip->header_length, length);
+}
+
+/*******************************************************************************
+圧縮データをリスタート マーカーの位置で区切ります。
+0xFF の後に 0x00 が続く場合は圧縮データの一部です。EOI で終わらない場合は FALSE を返します。
+*/
+static gboolean
+viewer_strip_scan (ViewerStrip *strip, gsize start, gsize length)
+{
+	ViewerStripSegment segment;
+	const guchar *found;
+	gsize offset;
+	int marker;
+	gboolean result, done;
+	segment.start = start;
+	offset = start;
+	result = TRUE;
+	done = FALSE;
+
+	while (result && !done)
+	{
+		found = (offset < length) ? memchr (strip->data + offset, JPEG_MARKER, length - offset) : NULL;
+		result = found && ((gsize) (found - strip->data) + 1 < length);
+
+		if (result)
+		{
+			offset = found - strip->data;
+			marker = strip->data [offset + 1];
+
+			if ((marker >= JPEG_RST0) && (marker <= JPEG_RST7))
+			{
+				segment.end = offset;
+				g_array_append_val (strip->segments, segment);
+				segment.start = offset + 2;
+				offset += 2;
+			}
+			else if (marker == JPEG_EOI)
+			{
+				segment.end = offset;
+				g_array_append_val (strip->segments, segment);
+				done = TRUE;
+			}
+			else if (marker == JPEG_STUFF)
+			{
+				offset += 2;
+			}
+			else if (marker == JPEG_MARKER)
+			{
+				offset++;
+			}
+			else
+			{
+				result = FALSE;
+			}
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,320 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include <stdio.h>
+#include <string.h>
+#include "viewer.h"
+#define THUMB_EXTENSION ".png"
+#define THUMB_SIZE      256
+#define THUMB_THREAD    "viewer-thumb"
+#define THUMB_USEC      1000000.0
+#define TRACE_THUMB     "thumbnail"
+
+typedef struct _ViewerThumbBatch ViewerThumbBatch;
+
+/* 作成する縮小画像の一覧 */
+struct _ViewerThumbBatch
+{
+	char **paths;
+	char **names;
+	int    n_paths;
+	int    n_tasks;
+	gint   next;
+	gint   succeeded;
+	gint   failed;
+	gsize  bytes;
+};
+
+static gboolean    viewer_thumb_create    (const char *path, GBytes **png, GError **error);
+static char      **viewer_thumb_get_names (char **paths);
+static char      **viewer_thumb_read_list (const char *path, char **arguments, GError **error);
+static GdkTexture *viewer_thumb_render    (ViewerImage *image, int size, gboolean preview);
+static gpointer    viewer_thumb_run       (gpointer data);
+static gboolean    viewer_thumb_write     (const char *name, GBytes *png, GError **error);
+
+/* コマンド ライン引数 */
+static char    *thumb_list      = NULL;
+static char    *thumb_output    = NULL;
+static int      thumb_jobs      = 0;
+static int      thumb_repeat    = 1;
+static int      thumb_size      = THUMB_SIZE;
+static gboolean thumb_benchmark = FALSE;
+static const GOptionEntry THUMB_OPTIONS [] =
+{
+	{ "benchmark",  'b', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE,     &thumb_benchmark, "Encode without writing files and report throughput as JSON", NULL },
+	{ "files-from", 'f', G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, &thumb_list,      "Read input file names, one per line, from FILE", "FILE" },
+	{ "jobs",       'j', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT,      &thumb_jobs,      "Number of worker threads (default: number of processors)", "N" },
+	{ "output",     'o', G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, &thumb_output,    "Directory to write thumbnails to (default: current directory)", "DIR" },
+	{ "repeat",     'r', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT,      &thumb_repeat,    "Process the whole list N times", "N" },
+	{ "size",       's', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT,      &thumb_size,      "Fit thumbnails inside an N by N box", "N" },
+	G_OPTION_ENTRY_NULL
+};
+
+/*******************************************************************************
+縮小画像を一括作成するメイン エントリ ポイントです。
+入力ファイルを全てのプロセッサーで並列に展開、縮小し、作成した順に PNG ファイルへ書き込みます。
+*/
+int
+main (int argc, char *argv [])
+{
+	ViewerThumbBatch batch = { 0 };
+	GOptionContext *context;
+	GThread **threads;
+	GError *error;
+	gint64 begin, elapsed;
+	int n;
+	error = NULL;
+	context = g_option_context_new ("[FILE...]");
+	g_option_context_add_main_entries (context, THUMB_OPTIONS, NULL);
+
+	if (!g_option_context_parse (context, &argc, &argv, &error) || !(batch.paths = viewer_thumb_read_list (thumb_list, argv + 1, &error)))
+	{
+		g_printerr ("%s\n", error->message);
+		g_error_free (error);
+		g_option_context_free (context);
+		return 1;
+	}
+
+	viewer_trace_init ();
+	thumb_jobs = (thumb_jobs > 0) ? thumb_jobs : (int) g_get_num_processors ();
+	thumb_size = MAX (thumb_size, 1);
+	batch.n_paths = g_strv_length (batch.paths);
+	batch.names = viewer_thumb_get_names (batch.paths);
+	batch.n_tasks = batch.n_paths * MAX (thumb_repeat, 1);
+	threads = g_new (GThread *, thumb_jobs);
+	begin = g_get_monotonic_time ();
+
+	for (n = 0; n < thumb_jobs; n++)
+	{
+		threads [n] = g_thread_new (THUMB_THREAD, viewer_thumb_run, &batch);
+	}
+	for (n = 0; n < thumb_jobs; n++)
+	{
+		g_thread_join (threads [n]);
+	}
+
+	elapsed = MAX (g_get_monotonic_time () - begin, 1);
+
+	if (thumb_benchmark)
+	{
+		printf ("{\n  \"jobs\": %d,\n  \"size\": %d,\n  \"images\": %d,\n  \"failed\": %d,\n  \"seconds\": %.3f,\n  \"images_per_second\": %.1f,\n  \"png_bytes\": %" G_GSIZE_FORMAT "\n}\n",
+			thumb_jobs, thumb_size, batch.succeeded, batch.failed, elapsed / THUMB_USEC, batch.succeeded * THUMB_USEC / elapsed, batch.bytes);
+	}
+
+	viewer_trace_stop ();
+	g_free (threads);
+	g_strfreev (batch.names);
+	g_strfreev (batch.paths);
+	g_option_context_free (context);
+	return batch.failed ? 1 : 0;
+}
+
+/*******************************************************************************
+画像ファイルを開き、縮小して PNG 形式に符号化します。
+JPEG ファイルは先に縮小して展開した下見用の画像を使い、それでは画素が足りない場合だけ全体を展開します。
+*/
+static gboolean
+viewer_thumb_create (const char *path, GBytes **png, GError **error)
+{
+	ViewerImage *image;
+	GdkTexture *texture;
+	GFile *file;
+	gint64 begin;
+	begin = viewer_trace_begin ();
+	file = g_file_new_for_path (path);
+	image = viewer_preview_create (file, thumb_size, thumb_size, NULL);
+	texture = image ? viewer_thumb_render (image, thumb_size, TRUE) : NULL;
+
+	if (!texture)
+	{
+		g_clear_object (&image);
+		image = viewer_create_image_from_file (file, NULL, error);
+		texture = image ? viewer_thumb_render (image, thumb_size, FALSE) : NULL;
+	}
+	if (texture)
+	{
+		*png = gdk_texture_save_to_png_bytes (texture);
+		g_object_unref (texture);
+	}
+	else if (image)
+	{
+		g_set_error (error, G_FILE_ERROR, G_FILE_ERROR_NOMEM, "%s: cannot render thumbnail", path);
+	}
+
+	g_clear_object (&image);
+	g_object_unref (file);
+	viewer_trace_end (TRACE_THUMB, begin, 0);
+	return texture != NULL;
+}
+
+/*******************************************************************************
+各入力ファイルの縮小画像のファイル名を、入力ファイルの拡張子を .png に替えて作成します。
+別のディレクトリの同じ名前のファイルや拡張子だけが異なるファイルは、後のものに -2 から順に番号を付けて区別します。
+同じパスが複数回現れる場合は同じファイル名になります。
+*/
+static char **
+viewer_thumb_get_names (char **paths)
+{
+	GStrvBuilder *builder;
+	GHashTable *names, *used;
+	char **path, **result, *base, *dot, *name;
+	int n;
+	builder = g_strv_builder_new ();
+	names = g_hash_table_new (g_str_hash, g_str_equal);
+	used = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+	for (path = paths; *path; path++)
+	{
+		name = g_hash_table_lookup (names, *path);
+
+		if (!name)
+		{
+			base = g_path_get_basename (*path);
+			dot = strrchr (base, '.');
+
+			if (dot && (dot != base))
+			{
+				*dot = '\0';
+			}
+
+			name = g_strconcat (base, THUMB_EXTENSION, NULL);
+
+			for (n = 2; g_hash_table_contains (used, name); n++)
+			{
+				g_free (name);
+				name = g_strdup_printf ("%s-%d%s", base, n, THUMB_EXTENSION);
+			}
+
+			g_hash_table_add (used, name);
+			g_hash_table_insert (names, *path, name);
+			g_free (base);
+		}
+
+		g_strv_builder_add (builder, name);
+	}
+
+	result = g_strv_builder_end (builder);
+	g_strv_builder_unref (builder);
+	g_hash_table_unref (names);
+	g_hash_table_unref (used);
+	return result;
+}
+
+/*******************************************************************************
+入力ファイルの一覧を作成します。path が NULL でない場合は、そのファイルの各行を追加します。
+*/
+static char **
+viewer_thumb_read_list (const char *path, char **arguments, GError **error)
+{
+	GStrvBuilder *builder;
+	char **lines, **line, *contents;
+	gboolean result;
+	builder = g_strv_builder_new ();
+	g_strv_builder_addv (builder, (const char **) arguments);
+	result = TRUE;
+
+	if (path)
+	{
+		result = g_file_get_contents (path, &contents, NULL, error);
+
+		if (result)
+		{
+			lines = g_strsplit (contents, "\n", -1);
+
+			for (line = lines; *line; line++)
+			{
+				g_strstrip (*line);
+
+				if (**line)
+				{
+					g_strv_builder_add (builder, *line);
+				}
+			}
+
+			g_strfreev (lines);
+			g_free (contents);
+		}
+	}
+
+	lines = g_strv_builder_end (builder);
+	g_strv_builder_unref (builder);
+
+	if (result && !*lines)
+	{
+		g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED, "No input files");
+		result = FALSE;
+	}
+	if (!result)
+	{
+		g_clear_pointer (&lines, g_strfreev);
+	}
+
+	return lines;
+}
+
+/*******************************************************************************
+size の正方形に収まるように、画像を面積平均で縮小したテクスチャを作成します。
+画像が正方形より小さい場合は等倍で描画します。作成できない場合は NULL を返します。
+preview が TRUE の場合は、下見用の画像の画素が足りずに縮小できないときも NULL を返します。
+*/
+static GdkTexture *
+viewer_thumb_render (ViewerImage *image, int size, gboolean preview)
+{
+	double zoom;
+	int width, height;
+	zoom = MIN (1.0, MIN ((double) size / viewer_image_get_width (image), (double) size / viewer_image_get_height (image)));
+	width = MAX ((int) (zoom * viewer_image_get_width (image)), 1);
+	height = MAX ((int) (zoom * viewer_image_get_height (image)), 1);
+	return preview ? viewer_image_resample (image, zoom, 0, 0, width, height, NULL) : viewer_image_render (image, zoom, width, height);
+}
+
+/*******************************************************************************
+作業スレッドです。一覧の次の要素を原子的に取り出して処理し、一覧が尽きたら終了します。
+要素ごとに取り出すので、処理時間が画像ごとに大きく異なっても空いたスレッドから順に次の画像を受け持ちます。
+*/
+static gpointer
+viewer_thumb_run (gpointer data)
+{
+	ViewerThumbBatch *batch;
+	GBytes *png;
+	GError *error;
+	const char *path;
+	int index;
+	batch = data;
+
+	while ((index = g_atomic_int_add (&batch->next, 1)) < batch->n_tasks)
+	{
+		path = batch->paths [index % batch->n_paths];
+		png = NULL;
+		error = NULL;
+
+		if (viewer_thumb_create (path, &png, &error) && (thumb_benchmark || viewer_thumb_write (batch->names [index % batch->n_paths], png, &error)))
+		{
+			g_atomic_int_inc (&batch->succeeded);
+			g_atomic_pointer_add (&batch->bytes, g_bytes_get_size (png));
+		}
+		else
+		{
+			g_printerr ("%s\n", error->message);
+			g_error_free (error);
+			g_atomic_int_inc (&batch->failed);
+		}
+
+		g_clear_pointer (&png, g_bytes_unref);
+	}
+
+	return NULL;
+}
+
+/*******************************************************************************
+縮小画像を出力先のディレクトリへ、viewer_thumb_get_names で決めた名前で書き込みます。
+*/
+static gboolean
+viewer_thumb_write (const char *name, GBytes *png, GError **error)
+{
+	gboolean result;
+	char *output;
+	output = g_build_filename (thumb_output ? thumb_output : ".", name, NULL);
+	result = g_file_set_contents (output, g_bytes_get_data (png, NULL), g_bytes_get_size (png), error);
+	g_free (output);
+	return result;
+}
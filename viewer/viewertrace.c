@@ -0,0 +1,357 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include <string.h>
+#include "viewer.h"
+#define TRACE_CAPACITY         65536
+#define TRACE_ENVIRONMENT      "VIEWER_TRACE"
+#define TRACE_FORMAT_COMPLETE  "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%" G_GINT64_FORMAT ",\"dur\":%" G_GINT64_FORMAT ",\"pid\":1,\"tid\":%d,\"args\":{\"value\":%" G_GINT64_FORMAT "}}"
+#define TRACE_FORMAT_COUNTER   "{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%" G_GINT64_FORMAT ",\"pid\":1,\"tid\":%d,\"args\":{\"%s\":%" G_GINT64_FORMAT "}}"
+#define TRACE_FORMAT_SUMMARY   "trace: %-8s %6" G_GINT64_FORMAT " %8.3f ms avg %8.3f ms max %12" G_GINT64_FORMAT "\n"
+#define TRACE_N_NAMES          16
+#define TRACE_NAME_STALL       "stall"
+#define TRACE_STALL_INTERVAL   10
+#define TRACE_STALL_THRESHOLD  (16 * 1000)
+#define TRACE_SUMMARY          "summary"
+#define TRACE_SUMMARY_INTERVAL 1
+#define TRACE_TEMPLATE         "viewer-trace-XXXXXX.json"
+
+typedef enum   _ViewerTraceKind  ViewerTraceKind;
+typedef struct _ViewerTrace      ViewerTrace;
+typedef struct _ViewerTraceEvent ViewerTraceEvent;
+typedef struct _ViewerTraceTotal ViewerTraceTotal;
+
+/* 記録の種類 */
+enum _ViewerTraceKind
+{
+	VIEWER_TRACE_KIND_COMPLETE,
+	VIEWER_TRACE_KIND_COUNTER,
+};
+
+/* 記録 */
+struct _ViewerTraceEvent
+{
+	const char     *name;
+	gint64          time;
+	gint64          duration;
+	gint64          value;
+	int             thread;
+	ViewerTraceKind kind;
+};
+
+/* 名前ごとの集計 */
+struct _ViewerTraceTotal
+{
+	const char *name;
+	gint64      count;
+	gint64      duration;
+	gint64      maximum;
+	gint64      value;
+};
+
+/* 計測の状態 */
+struct _ViewerTrace
+{
+	GMutex            mutex;
+	GPrivate          thread;
+	ViewerTraceEvent *events;
+	char             *path;
+	guint64           head;
+	guint64           summarized;
+	gint64            tick;
+	guint             stall_source;
+	guint             summary_source;
+	gint              enabled;
+	gint              n_threads;
+};
+
+static gboolean          viewer_trace_dump       (const char *path, GError **error);
+static int               viewer_trace_get_thread (void);
+static void              viewer_trace_push       (ViewerTraceKind kind, const char *name, gint64 time, gint64 duration, gint64 value);
+static gboolean          viewer_trace_stall      (gpointer user_data);
+static gboolean          viewer_trace_summarize  (gpointer user_data);
+static ViewerTraceTotal *viewer_trace_total      (ViewerTraceTotal *totals, const ViewerTraceEvent *event);
+
+/* 計測の状態 */
+static ViewerTrace viewer_trace;
+
+/*******************************************************************************
+計測を開始します。計測していない場合は 0 を返します。任意のスレッドから呼び出せます。
+*/
+gint64
+viewer_trace_begin (void)
+{
+	return G_UNLIKELY (g_atomic_int_get (&viewer_trace.enabled)) ? g_get_monotonic_time () : 0;
+}
+
+/*******************************************************************************
+回数を記録します。任意のスレッドから呼び出せます。
+*/
+void
+viewer_trace_count (const char *name, gint64 value)
+{
+	if (G_UNLIKELY (g_atomic_int_get (&viewer_trace.enabled)))
+	{
+		viewer_trace_push (VIEWER_TRACE_KIND_COUNTER, name, g_get_monotonic_time (), 0, value);
+	}
+}
+
+/*******************************************************************************
+リング バッファーに残っている記録を Chrome のトレース イベント形式で書き込みます。
+呼び出し元はロックを保持します。
+*/
+static gboolean
+viewer_trace_dump (const char *path, GError **error)
+{
+	ViewerTraceTotal totals [TRACE_N_NAMES];
+	const ViewerTraceEvent *event;
+	ViewerTraceTotal *total;
+	GString *string;
+	guint64 n;
+	gboolean result;
+	memset (totals, 0, sizeof (totals));
+	string = g_string_new ("{\"traceEvents\":[");
+
+	for (n = MAX (viewer_trace.head, TRACE_CAPACITY) - TRACE_CAPACITY; n < viewer_trace.head; n++)
+	{
+		event = &viewer_trace.events [n % TRACE_CAPACITY];
+		g_string_append (string, (string->str [string->len - 1] == '[') ? "\n" : ",\n");
+
+		if (event->kind == VIEWER_TRACE_KIND_COUNTER)
+		{
+			total = viewer_trace_total (totals, event);
+			g_string_append_printf (string, TRACE_FORMAT_COUNTER, event->name, event->time, event->thread, event->name, total ? total->value : event->value);
+		}
+		else
+		{
+			g_string_append_printf (string, TRACE_FORMAT_COMPLETE, event->name, event->time, event->duration, event->thread, event->value);
+		}
+	}
+
+	g_string_append (string, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	result = g_file_set_contents (path, string->str, string->len, error);
+	g_string_free (string, TRUE);
+	return result;
+}
+
+/*******************************************************************************
+計測を終了して記録します。begin が 0 の場合は何もしません。任意のスレッドから呼び出せます。
+*/
+void
+viewer_trace_end (const char *name, gint64 begin, gint64 value)
+{
+	if (G_UNLIKELY (begin))
+	{
+		viewer_trace_push (VIEWER_TRACE_KIND_COMPLETE, name, begin, g_get_monotonic_time () - begin, value);
+	}
+}
+
+/*******************************************************************************
+計測しているかどうかを取得します。
+*/
+gboolean
+viewer_trace_get_enabled (void)
+{
+	return g_atomic_int_get (&viewer_trace.enabled);
+}
+
+/*******************************************************************************
+呼び出し元のスレッドの番号を取得します。
+*/
+static int
+viewer_trace_get_thread (void)
+{
+	int thread;
+	thread = GPOINTER_TO_INT (g_private_get (&viewer_trace.thread));
+
+	if (!thread)
+	{
+		thread = g_atomic_int_add (&viewer_trace.n_threads, 1) + 1;
+		g_private_set (&viewer_trace.thread, GINT_TO_POINTER (thread));
+	}
+
+	return thread;
+}
+
+/*******************************************************************************
+環境変数 VIEWER_TRACE が設定されている場合は計測を開始します。
+値が summary の場合は集計を標準エラーへ定期的に出力し、それ以外の場合は終了時に記録を書き込むファイルとみなします。
+*/
+void
+viewer_trace_init (void)
+{
+	const char *value;
+	value = g_getenv (TRACE_ENVIRONMENT);
+
+	if (value && *value)
+	{
+		if (strcmp (value, TRACE_SUMMARY))
+		{
+			viewer_trace_start (value, FALSE);
+		}
+		else
+		{
+			viewer_trace_start (NULL, TRUE);
+		}
+	}
+}
+
+/*******************************************************************************
+リング バッファーへ記録を追加します。最も古い記録を上書きします。
+*/
+static void
+viewer_trace_push (ViewerTraceKind kind, const char *name, gint64 time, gint64 duration, gint64 value)
+{
+	ViewerTraceEvent *event;
+	int thread;
+	thread = viewer_trace_get_thread ();
+	g_mutex_lock (&viewer_trace.mutex);
+
+	if (viewer_trace.events)
+	{
+		event = &viewer_trace.events [viewer_trace.head++ % TRACE_CAPACITY];
+		event->name = name;
+		event->time = time;
+		event->duration = duration;
+		event->value = value;
+		event->thread = thread;
+		event->kind = kind;
+	}
+
+	g_mutex_unlock (&viewer_trace.mutex);
+}
+
+/*******************************************************************************
+メイン ループが一定の間隔で呼び出されなかった時間を停滞として記録します。
+*/
+static gboolean
+viewer_trace_stall (gpointer user_data)
+{
+	gint64 now, lateness;
+	now = g_get_monotonic_time ();
+	lateness = now - viewer_trace.tick - TRACE_STALL_INTERVAL * G_TIME_SPAN_MILLISECOND;
+
+	if (lateness > TRACE_STALL_THRESHOLD)
+	{
+		viewer_trace_push (VIEWER_TRACE_KIND_COMPLETE, TRACE_NAME_STALL, now - lateness, lateness, 0);
+	}
+
+	viewer_trace.tick = now;
+	return G_SOURCE_CONTINUE;
+}
+
+/*******************************************************************************
+計測を開始します。メイン スレッドから呼び出します。
+path は計測の終了時に記録を書き込むファイルで、NULL の場合は一時ファイルを作成します。
+summary が TRUE の場合は集計を標準エラーへ定期的に出力します。
+*/
+void
+viewer_trace_start (const char *path, gboolean summary)
+{
+	if (!viewer_trace_get_enabled ())
+	{
+		g_mutex_lock (&viewer_trace.mutex);
+		viewer_trace.events = g_new (ViewerTraceEvent, TRACE_CAPACITY);
+		viewer_trace.path = g_strdup (path);
+		viewer_trace.head = 0;
+		viewer_trace.summarized = 0;
+		g_mutex_unlock (&viewer_trace.mutex);
+		viewer_trace.tick = g_get_monotonic_time ();
+		viewer_trace.stall_source = g_timeout_add (TRACE_STALL_INTERVAL, viewer_trace_stall, NULL);
+		viewer_trace.summary_source = summary ? g_timeout_add_seconds (TRACE_SUMMARY_INTERVAL, viewer_trace_summarize, NULL) : 0;
+		g_atomic_int_set (&viewer_trace.enabled, TRUE);
+	}
+}
+
+/*******************************************************************************
+計測を終了し、記録をファイルへ書き込みます。メイン スレッドから呼び出します。
+*/
+void
+viewer_trace_stop (void)
+{
+	GError *error;
+	char *path;
+	int fd;
+
+	if (viewer_trace_get_enabled ())
+	{
+		g_atomic_int_set (&viewer_trace.enabled, FALSE);
+		g_clear_handle_id (&viewer_trace.stall_source, g_source_remove);
+		g_clear_handle_id (&viewer_trace.summary_source, g_source_remove);
+		g_mutex_lock (&viewer_trace.mutex);
+		error = NULL;
+		path = viewer_trace.path;
+		viewer_trace.path = NULL;
+
+		if (!path && ((fd = g_file_open_tmp (TRACE_TEMPLATE, &path, &error)) >= 0))
+		{
+			g_close (fd, NULL);
+		}
+		if (path && viewer_trace_dump (path, &error))
+		{
+			g_printerr ("trace: %s\n", path);
+		}
+		if (error)
+		{
+			g_printerr ("trace: %s\n", error->message);
+			g_error_free (error);
+		}
+
+		g_clear_pointer (&viewer_trace.events, g_free);
+		g_mutex_unlock (&viewer_trace.mutex);
+		g_free (path);
+	}
+}
+
+/*******************************************************************************
+前回の出力以降の記録を名前ごとに集計し、標準エラーへ出力します。
+*/
+static gboolean
+viewer_trace_summarize (gpointer user_data)
+{
+	ViewerTraceTotal totals [TRACE_N_NAMES];
+	ViewerTraceTotal *total;
+	guint64 n;
+	memset (totals, 0, sizeof (totals));
+	g_mutex_lock (&viewer_trace.mutex);
+
+	for (n = MAX (viewer_trace.summarized + TRACE_CAPACITY, viewer_trace.head) - TRACE_CAPACITY; n < viewer_trace.head; n++)
+	{
+		viewer_trace_total (totals, &viewer_trace.events [n % TRACE_CAPACITY]);
+	}
+
+	viewer_trace.summarized = viewer_trace.head;
+	g_mutex_unlock (&viewer_trace.mutex);
+
+	for (total = totals; (total < totals + TRACE_N_NAMES) && total->name; total++)
+	{
+		g_printerr (TRACE_FORMAT_SUMMARY, total->name, total->count, total->duration / (1000.0 * total->count), total->maximum / 1000.0, total->value);
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+/*******************************************************************************
+記録を名前ごとの集計へ加え、その集計を返します。集計できる名前の数を超えた記録は無視して NULL を返します。
+*/
+static ViewerTraceTotal *
+viewer_trace_total (ViewerTraceTotal *totals, const ViewerTraceEvent *event)
+{
+	ViewerTraceTotal *total;
+
+	for (total = totals; (total < totals + TRACE_N_NAMES) && total->name && strcmp (total->name, event->name); total++);
+
+	if (total < totals + TRACE_N_NAMES)
+	{
+		total->name = event->name;
+		total->count++;
+		total->duration += event->duration;
+		total->maximum = MAX (total->maximum, event->duration);
+		total->value += event->value;
+	}
+	else
+	{
+		total = NULL;
+	}
+
+	return total;
+}
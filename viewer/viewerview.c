@@ -0,0 +1,443 @@
+/* Copyright (C) 2025 Taichi Murakami. */
+#include <gtk/gtk.h>
+#include <math.h>
+#include "viewer.h"
+#define SIGNAL_RESIZE   "resize"
+#define TRACE_DRAW      "draw"
+#define TRACE_RESAMPLE  "resample"
+#define VIEW_IDLE_DELAY 150
+#define VIEW_MARGIN     256
+#define VIEW_NEAREST    4.0
+
+typedef struct _ViewerViewResample ViewerViewResample;
+
+/* Viewer View クラスのインスタンス */
+struct _ViewerView
+{
+	GtkWidget      parent_instance;
+	ViewerImage   *image;
+	GskRenderNode *node;
+	GdkTexture    *texture;
+	GCancellable  *resampling;
+	ViewerPlayer  *player;
+	GdkRGBA        background;
+	double         zoom;
+	double         x;
+	double         y;
+	guint          idle_source;
+	guint          tick;
+	int            node_x;
+	int            node_y;
+	int            node_width;
+	int            node_height;
+	int            texture_width;
+	int            texture_height;
+	gboolean       interactive;
+};
+
+/* 高画質な縮小の要求 */
+struct _ViewerViewResample
+{
+	ViewerImage *image;
+	double       zoom;
+	int          x;
+	int          y;
+	int          width;
+	int          height;
+};
+
+static void     viewer_view_class_init       (ViewerViewClass *this_class);
+static void     viewer_view_dispose          (GObject *self);
+static void     viewer_view_free_resample    (ViewerViewResample *resample);
+static gboolean viewer_view_idle             (gpointer user_data);
+static void     viewer_view_init             (ViewerView *self);
+static void     viewer_view_render           (ViewerView *self, int x, int y, int width, int height);
+static void     viewer_view_resample         (ViewerView *self);
+static void     viewer_view_respond_resample (GObject *self, GAsyncResult *result, gpointer user_data);
+static void     viewer_view_restart          (ViewerView *self);
+static void     viewer_view_run_resample     (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable);
+static void     viewer_view_size_allocate    (GtkWidget *self, int width, int height, int baseline);
+static void     viewer_view_snapshot         (GtkWidget *self, GtkSnapshot *snapshot);
+static void     viewer_view_stop             (ViewerView *self);
+static gboolean viewer_view_tick             (GtkWidget *self, GdkFrameClock *clock, gpointer user_data);
+
+/* Viewer View クラス */
+G_DEFINE_TYPE (ViewerView, viewer_view, GTK_TYPE_WIDGET);
+
+/*******************************************************************************
+クラスを初期化します。
+大きさが変わったときは、GtkDrawingArea と同じ形式の resize シグナルを発行します。
+*/
+static void
+viewer_view_class_init (ViewerViewClass *this_class)
+{
+	G_OBJECT_CLASS (this_class)->dispose = viewer_view_dispose;
+	GTK_WIDGET_CLASS (this_class)->size_allocate = viewer_view_size_allocate;
+	GTK_WIDGET_CLASS (this_class)->snapshot = viewer_view_snapshot;
+	g_signal_new (SIGNAL_RESIZE, G_TYPE_FROM_CLASS (this_class), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 2, G_TYPE_INT, G_TYPE_INT);
+}
+
+/*******************************************************************************
+クラスのインスタンスを破棄します。
+*/
+static void
+viewer_view_dispose (GObject *self)
+{
+	ViewerView *properties;
+	properties = VIEWER_VIEW (self);
+	viewer_view_restart (properties);
+	g_clear_handle_id (&properties->idle_source, g_source_remove);
+	viewer_view_stop (properties);
+	g_clear_pointer (&properties->node, gsk_render_node_unref);
+	g_clear_object (&properties->image);
+	G_OBJECT_CLASS (viewer_view_parent_class)->dispose (self);
+}
+
+/*******************************************************************************
+高画質な縮小の要求を破棄します。
+*/
+static void
+viewer_view_free_resample (ViewerViewResample *resample)
+{
+	g_object_unref (resample->image);
+	g_free (resample);
+}
+
+/*******************************************************************************
+操作が止まってから一定の時間が経ったときに、操作中の描画を終えて高画質な縮小を開始します。
+*/
+static gboolean
+viewer_view_idle (gpointer user_data)
+{
+	ViewerView *self;
+	self = VIEWER_VIEW (user_data);
+	self->idle_source = 0;
+
+	if (self->interactive)
+	{
+		self->interactive = FALSE;
+		g_clear_pointer (&self->node, gsk_render_node_unref);
+		gtk_widget_queue_draw (GTK_WIDGET (self));
+	}
+
+	viewer_view_resample (self);
+	return G_SOURCE_REMOVE;
+}
+
+/*******************************************************************************
+クラスのインスタンスを初期化します。
+*/
+static void
+viewer_view_init (ViewerView *self)
+{
+	self->zoom = 1.0;
+	self->background.alpha = 1.0F;
+}
+
+/*******************************************************************************
+クラスのインスタンスを作成します。
+*/
+GtkWidget *
+viewer_view_new (void)
+{
+	return g_object_new (VIEWER_TYPE_VIEW, NULL);
+}
+
+/*******************************************************************************
+表示領域と周囲の余白にある画像の区画を 1 つの描画ノードにまとめます。
+(x, y) は拡大後の座標で、描画ノードの原点になります。
+*/
+static void
+viewer_view_render (ViewerView *self, int x, int y, int width, int height)
+{
+	GtkSnapshot *snapshot;
+	g_clear_pointer (&self->node, gsk_render_node_unref);
+	snapshot = gtk_snapshot_new ();
+	viewer_image_snapshot (self->image, snapshot, self->zoom, x, y, width, height, self->interactive);
+	self->node = gtk_snapshot_free_to_node (snapshot);
+	self->node_x = x;
+	self->node_y = y;
+	self->node_width = width;
+	self->node_height = height;
+}
+
+/*******************************************************************************
+表示領域のうち画像が見えている範囲を、別のスレッドで面積平均により縮小します。
+画面の 1 画素に 1 画素が対応するように、拡大率に画面の倍率を掛けて縮小します。
+動画像の再生中は、縮小しても表示しないので何もしません。
+*/
+static void
+viewer_view_resample (ViewerView *self)
+{
+	ViewerViewResample *resample;
+	GTask *task;
+	int scale, x, y;
+
+	if (self->image && !self->player)
+	{
+		scale = gtk_widget_get_scale_factor (GTK_WIDGET (self));
+		x = (int) round (self->x);
+		y = (int) round (self->y);
+		self->texture_width = MIN (gtk_widget_get_width (GTK_WIDGET (self)), (int) floor (self->zoom * viewer_image_get_width (self->image)) - x);
+		self->texture_height = MIN (gtk_widget_get_height (GTK_WIDGET (self)), (int) floor (self->zoom * viewer_image_get_height (self->image)) - y);
+
+		if ((self->texture_width > 0) && (self->texture_height > 0))
+		{
+			resample = g_new (ViewerViewResample, 1);
+			resample->image = g_object_ref (self->image);
+			resample->zoom = self->zoom * scale;
+			resample->x = x * scale;
+			resample->y = y * scale;
+			resample->width = self->texture_width * scale;
+			resample->height = self->texture_height * scale;
+			self->resampling = g_cancellable_new ();
+			task = g_task_new (self, self->resampling, viewer_view_respond_resample, NULL);
+			g_task_set_source_tag (task, viewer_view_resample);
+			g_task_set_priority (task, G_PRIORITY_LOW);
+			g_task_set_task_data (task, resample, (GDestroyNotify) viewer_view_free_resample);
+			g_task_run_in_thread (task, viewer_view_run_resample);
+			g_object_unref (task);
+		}
+	}
+}
+
+/*******************************************************************************
+高画質に縮小したテクスチャを受け取り、描画し直します。
+取り消された要求の結果は破棄します。
+*/
+static void
+viewer_view_respond_resample (GObject *self, GAsyncResult *result, gpointer user_data)
+{
+	ViewerView *properties;
+	GdkTexture *texture;
+	properties = VIEWER_VIEW (self);
+	texture = g_task_propagate_pointer (G_TASK (result), NULL);
+
+	if (texture && (g_task_get_cancellable (G_TASK (result)) == properties->resampling))
+	{
+		g_clear_object (&properties->texture);
+		properties->texture = texture;
+		gtk_widget_queue_draw (GTK_WIDGET (self));
+	}
+	else if (texture)
+	{
+		g_object_unref (texture);
+	}
+}
+
+/*******************************************************************************
+表示内容が変わったときに、高画質な縮小を取り消して待ち時間を数え直します。
+*/
+static void
+viewer_view_restart (ViewerView *self)
+{
+	if (self->resampling)
+	{
+		g_cancellable_cancel (self->resampling);
+		g_clear_object (&self->resampling);
+	}
+
+	g_clear_object (&self->texture);
+
+	if (self->idle_source)
+	{
+		g_source_remove (self->idle_source);
+	}
+
+	self->idle_source = g_timeout_add (VIEW_IDLE_DELAY, viewer_view_idle, self);
+}
+
+/*******************************************************************************
+スレッド プールで高画質に縮小します。
+*/
+static void
+viewer_view_run_resample (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+	ViewerViewResample *resample;
+	GdkTexture *texture;
+	gint64 begin;
+	resample = task_data;
+	begin = viewer_trace_begin ();
+	texture = viewer_image_resample (resample->image, resample->zoom, resample->x, resample->y, resample->width, resample->height, cancellable);
+	viewer_trace_end (TRACE_RESAMPLE, begin, (gint64) resample->width * resample->height);
+
+	if (!g_task_return_error_if_cancelled (task))
+	{
+		g_task_return_pointer (task, texture, g_object_unref);
+	}
+	else if (texture)
+	{
+		g_object_unref (texture);
+	}
+}
+
+/*******************************************************************************
+背景色を設定します。
+*/
+void
+viewer_view_set_background (ViewerView *self, const GdkRGBA *color)
+{
+	if (!gdk_rgba_equal (&self->background, color))
+	{
+		self->background = *color;
+		gtk_widget_queue_draw (GTK_WIDGET (self));
+	}
+}
+
+/*******************************************************************************
+表示する画像を設定します。NULL の場合は背景だけを描画します。
+動画像の場合は、フレーム クロックに合わせてコマを進めながら再生します。
+*/
+void
+viewer_view_set_image (ViewerView *self, ViewerImage *image)
+{
+	GdkPixbufAnimation *animation;
+
+	if (self->image != image)
+	{
+		viewer_view_stop (self);
+		g_clear_object (&self->image);
+		self->image = image ? g_object_ref (image) : NULL;
+		animation = image ? viewer_image_get_animation (image) : NULL;
+
+		if (animation)
+		{
+			self->player = viewer_player_new (animation);
+			self->tick = gtk_widget_add_tick_callback (GTK_WIDGET (self), viewer_view_tick, NULL, NULL);
+		}
+
+		viewer_view_update (self);
+	}
+}
+
+/*******************************************************************************
+拡大率と表示開始位置を設定します。(x, y) は拡大後の座標です。
+操作が止まるまでは最近傍で描画し、止まってから高画質に描画し直します。
+*/
+void
+viewer_view_set_position (ViewerView *self, double zoom, double x, double y)
+{
+	if ((self->zoom != zoom) || (self->x != x) || (self->y != y))
+	{
+		if ((self->zoom != zoom) || !self->interactive)
+		{
+			g_clear_pointer (&self->node, gsk_render_node_unref);
+		}
+
+		self->zoom = zoom;
+		self->x = x;
+		self->y = y;
+		self->interactive = TRUE;
+		viewer_view_restart (self);
+		gtk_widget_queue_draw (GTK_WIDGET (self));
+	}
+}
+
+/*******************************************************************************
+大きさを変更します。
+*/
+static void
+viewer_view_size_allocate (GtkWidget *self, int width, int height, int baseline)
+{
+	GTK_WIDGET_CLASS (viewer_view_parent_class)->size_allocate (self, width, height, baseline);
+	viewer_view_restart (VIEWER_VIEW (self));
+	g_signal_emit_by_name (self, SIGNAL_RESIZE, width, height);
+}
+
+/*******************************************************************************
+背景と画像の区画をテクスチャとして描画します。
+画像は区画ごとに一度だけテクスチャにするので、スクロールと拡大では画素を描き直しません。
+区画をまとめた描画ノードは表示領域より 1 区画分広く作成し、スクロールでは新しく見える範囲が
+余白からはみ出すまで移動するだけで使い回します。
+高画質に縮小したテクスチャがある場合は、区画の代わりにそれを描画します。
+動画像の再生中は、区画の代わりに表示中のコマを描画します。
+*/
+static void
+viewer_view_snapshot (GtkWidget *self, GtkSnapshot *snapshot)
+{
+	ViewerView *properties;
+	GdkTexture *frame;
+	gint64 begin, painted;
+	int width, height, x, y;
+	properties = VIEWER_VIEW (self);
+	begin = viewer_trace_begin ();
+	width = gtk_widget_get_width (self);
+	height = gtk_widget_get_height (self);
+	painted = 0;
+	gtk_snapshot_append_color (snapshot, &properties->background, &GRAPHENE_RECT_INIT (0, 0, width, height));
+
+	if (properties->image)
+	{
+		x = (int) round (properties->x);
+		y = (int) round (properties->y);
+		frame = properties->player ? viewer_player_get_texture (properties->player) : NULL;
+
+		if (frame)
+		{
+			gtk_snapshot_push_clip (snapshot, &GRAPHENE_RECT_INIT (0, 0, width, height));
+			gtk_snapshot_append_scaled_texture (snapshot, frame, (properties->interactive || (properties->zoom == 1.0) || (properties->zoom >= VIEW_NEAREST)) ? GSK_SCALING_FILTER_NEAREST : GSK_SCALING_FILTER_LINEAR, &GRAPHENE_RECT_INIT (-x, -y, properties->zoom * gdk_texture_get_width (frame), properties->zoom * gdk_texture_get_height (frame)));
+			gtk_snapshot_pop (snapshot);
+		}
+		else if (properties->texture)
+		{
+			gtk_snapshot_append_scaled_texture (snapshot, properties->texture, GSK_SCALING_FILTER_LINEAR, &GRAPHENE_RECT_INIT (0, 0, properties->texture_width, properties->texture_height));
+		}
+		else
+		{
+			if (!properties->node || (x < properties->node_x) || (y < properties->node_y) || (x + width > properties->node_x + properties->node_width) || (y + height > properties->node_y + properties->node_height))
+			{
+				viewer_view_render (properties, x - VIEW_MARGIN, y - VIEW_MARGIN, width + 2 * VIEW_MARGIN, height + 2 * VIEW_MARGIN);
+				painted = (gint64) properties->node_width * properties->node_height;
+			}
+			if (properties->node)
+			{
+				gtk_snapshot_push_clip (snapshot, &GRAPHENE_RECT_INIT (0, 0, width, height));
+				gtk_snapshot_translate (snapshot, &GRAPHENE_POINT_INIT (properties->node_x - x, properties->node_y - y));
+				gtk_snapshot_append_node (snapshot, properties->node);
+				gtk_snapshot_pop (snapshot);
+			}
+		}
+	}
+
+	viewer_trace_end (TRACE_DRAW, begin, painted);
+}
+
+/*******************************************************************************
+動画像の再生を止めます。
+*/
+static void
+viewer_view_stop (ViewerView *self)
+{
+	if (self->player)
+	{
+		gtk_widget_remove_tick_callback (GTK_WIDGET (self), self->tick);
+		g_clear_pointer (&self->player, viewer_player_free);
+		self->tick = 0;
+	}
+}
+
+/*******************************************************************************
+フレーム クロックの時刻に合わせて動画像のコマを進め、コマが変わった場合は描画し直します。
+コマの合成は別のスレッドで先に済ませているので、ここではテクスチャを差し替えるだけです。
+*/
+static gboolean
+viewer_view_tick (GtkWidget *self, GdkFrameClock *clock, gpointer user_data)
+{
+	if (viewer_player_advance (VIEWER_VIEW (self)->player, gdk_frame_clock_get_frame_time (clock)))
+	{
+		gtk_widget_queue_draw (self);
+	}
+
+	return G_SOURCE_CONTINUE;
+}
+
+/*******************************************************************************
+画像の画素が変わったことを通知します。まとめた描画ノードを破棄して描画し直します。
+*/
+void
+viewer_view_update (ViewerView *self)
+{
+	g_clear_pointer (&self->node, gsk_render_node_unref);
+	viewer_view_restart (self);
+	gtk_widget_queue_draw (GTK_WIDGET (self));
+}